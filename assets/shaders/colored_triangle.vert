@@ -20,7 +20,8 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer{
 //push constants block
 layout( push_constant ) uniform constants
 {	
-	mat4 render_matrix;
+	mat4 view_projection; // camera at the origin
+	vec4 offset_scale; // camera-relative position and uniform scale of this draw
 	VertexBuffer vertexBuffer;
 } PushConstants;
 
@@ -30,7 +31,8 @@ void main()
 	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
 
 	//output data
-	gl_Position = PushConstants.render_matrix *vec4(v.position, 1.0f);
+	vec3 position = v.position * PushConstants.offset_scale.w + PushConstants.offset_scale.xyz;
+	gl_Position = PushConstants.view_projection * vec4(position, 1.0f);
 	outColor = v.color.xyz;
 	outUV.x = v.uv_x;
 	outUV.y = v.uv_y;
@@ -0,0 +1,15 @@
+#version 450
+
+//shader input
+layout (location = 0) in vec3 inColor;
+
+//output write
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	// soft round sprite, a one pixel point samples the centre
+	vec2 offset = gl_PointCoord * 2.0 - 1.0;
+	float falloff = max(1.0 - dot(offset, offset), 0.0);
+	outFragColor = vec4(inColor * falloff, 1.0);
+}
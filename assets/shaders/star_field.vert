@@ -0,0 +1,54 @@
+#version 450
+
+layout (location = 0) out vec3 outColor;
+
+struct Star {
+	vec3 direction;
+	uint magnitudeColor;
+};
+
+// the bindless storage buffer array, the catalogue is one entry in it
+layout(set = 0, binding = 0, std430) readonly buffer StarBuffer {
+	Star stars[];
+} starBuffers[];
+
+//push constants block
+layout( push_constant ) uniform constants
+{
+	mat4 view_projection;
+	uint star_buffer;
+	float magnitude_limit;
+	float max_point_size;
+} PushConstants;
+
+// rough blackbody tint from the B-V colour index, blue-white through to orange-red
+vec3 StarColor(float bv)
+{
+	float t = clamp((bv + 0.4) / 2.4, 0.0, 1.0);
+	vec3 blue = vec3(0.62, 0.72, 1.0);
+	vec3 white = vec3(1.0, 0.97, 0.92);
+	vec3 red = vec3(1.0, 0.62, 0.35);
+	return t < 0.3 ? mix(blue, white, t / 0.3) : mix(white, red, (t - 0.3) / 0.7);
+}
+
+void main()
+{
+	Star star = starBuffers[PushConstants.star_buffer].stars[gl_VertexIndex];
+	vec2 magnitudeColor = unpackHalf2x16(star.magnitudeColor);
+	gl_PointSize = 1.0;
+	// the draw count only trims to a catalogue bin, stars past the exact limit are pushed outside the clip volume
+	if (magnitudeColor.x > PushConstants.magnitude_limit) {
+		gl_Position = vec4(0.0, 0.0, -1.0, 1.0);
+		outColor = vec3(0.0);
+		return;
+	}
+	// w = 0 puts the star at infinity, which is depth 0 with the reverse-Z projection
+	gl_Position = PushConstants.view_projection * vec4(star.direction, 0.0);
+	gl_Position.z = 0.0;
+	// flux relative to the faintest visible star, five magnitudes is a factor of 100
+	float flux = pow(10.0, 0.4 * (PushConstants.magnitude_limit - magnitudeColor.x));
+	float size = clamp(sqrt(flux), 1.0, PushConstants.max_point_size);
+	gl_PointSize = size;
+	// whatever the sprite size cannot absorb goes into intensity, so faint stars fade out instead of popping
+	outColor = StarColor(magnitudeColor.y) * clamp(0.15 * flux / (size * size), 0.0, 8.0);
+}
@@ -7,10 +7,88 @@ print(spice.bodvrd("10", "RADII", 3))
 
 from astropy.table import Table
 from astroquery.jplhorizons import Horizons
+import csv
+import struct
+import sys
+import numpy as np
+
 # BaryCenters
 def GetOrbitWithRespectToBody(body_string, location_string):
-    
-obj = Horizons(id='1', location='SSB', epochs={'start':'2200-01-01', 'stop':'2300-01-01', 'step':'5d'})
-e = obj.elements()
-e.remove_columns(['targetname', 'datetime_jd', 'datetime_str'])
-e.write('1-0.hdf5', path='output', overwrite=True, serialize_meta=False, compressed=True)
+    obj = Horizons(id=body_string, location=location_string, epochs={'start':'2200-01-01', 'stop':'2300-01-01', 'step':'5d'})
+    e = obj.elements()
+    e.remove_columns(['targetname', 'datetime_jd', 'datetime_str'])
+    return e
+
+# Reference states for steorra_bench --accuracy, written in the ephemeris export layout (see dynamics_export.h):
+# heliocentric J2000 ecliptic positions in metres on a fixed date grid, one block holding every sample.
+#
+#   python get_data.py reference ../assets/data/HorizonsReference.bin
+METRES_PER_AU = 149597870700.0
+EPHEMERIS_VERSION = 1
+EPHEMERIS_NAME_LENGTH = 32
+REFERENCE_EPOCHS = {'start':'1990-01-01', 'stop':'2030-01-01', 'step':'30d'}
+PLANET_IDS = {
+    'Mercury': '199', 'Venus': '299', 'Earth': '399', 'Mars': '499',
+    'Jupiter': '599', 'Saturn': '699', 'Uranus': '799', 'Neptune': '899',
+}
+SMALL_BODY_IDS = {
+    'Halley': 'DES=1P;CAP',
+    "'Oumuamua": 'DES=A/2017 U1',
+}
+
+def GetReferenceBodies():
+    # the satellites carry their NAIF code in the orbit table
+    bodies = dict(PLANET_IDS)
+    with open('../assets/data/SatelliteOrbits.csv', newline='') as table:
+        rows = list(csv.reader(table))
+    for row in rows[2:]:
+        if len(row) > 2 and row[1].strip() and row[2].strip():
+            bodies[row[1].strip()] = row[2].strip()
+    bodies.update(SMALL_BODY_IDS)
+    return bodies
+
+def GetHeliocentricPositions(horizons_id):
+    small_body = horizons_id.startswith('DES=')
+    obj = Horizons(id=horizons_id, location='@10', epochs=REFERENCE_EPOCHS, id_type='smallbody' if small_body else None)
+    v = obj.vectors(refplane='ecliptic')
+    times = np.asarray(v['datetime_jd'], dtype=np.float64)
+    positions = np.stack([np.asarray(v[c], dtype=np.float64) for c in ('x', 'y', 'z')], axis=1) * METRES_PER_AU
+    return times, positions
+
+def WriteReference(path):
+    names, columns, times = [], [], None
+    for name, horizons_id in GetReferenceBodies().items():
+        try:
+            body_times, positions = GetHeliocentricPositions(horizons_id)
+        except Exception as error:
+            print(f'skipping {name} ({horizons_id}): {error}')
+            continue
+        if times is None:
+            times = body_times
+        elif len(body_times) != len(times) or not np.allclose(body_times, times):
+            print(f'skipping {name}: date grid differs')
+            continue
+        names.append(name)
+        columns.append(positions)
+        print(f'{name}: {len(body_times)} states')
+    if times is None:
+        sys.exit('no reference states fetched, nothing written')
+    sample_count = len(times)
+    column_count = 1 + 3 * len(names)
+    with open(path, 'wb') as out:
+        out.write(struct.pack('<4sIIIQIIdd', b'SEPH', EPHEMERIS_VERSION, len(names), 0, sample_count, sample_count,
+            column_count, times[0], times[1] - times[0] if sample_count > 1 else 0.0))
+        for name in names:
+            out.write(name.encode('utf-8')[:EPHEMERIS_NAME_LENGTH - 1].ljust(EPHEMERIS_NAME_LENGTH, b'\0'))
+        out.write(struct.pack('<QII', 0, sample_count, 0))
+        out.write(times.astype('<f8').tobytes())
+        for positions in columns:
+            for c in range(3):
+                out.write(positions[:, c].astype('<f8').tobytes())
+    print(f'wrote {len(names)} bodies x {sample_count} samples to {path}')
+
+if len(sys.argv) > 2 and sys.argv[1] == 'reference':
+    WriteReference(sys.argv[2])
+else:
+    e = GetOrbitWithRespectToBody('1', 'SSB')
+    e.write('1-0.hdf5', path='output', overwrite=True, serialize_meta=False, compressed=True)
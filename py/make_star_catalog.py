@@ -0,0 +1,78 @@
+# Builds assets/data/stars.bin for the star field renderer.
+#
+#   python make_star_catalog.py hygdata_v41.csv ../assets/data/stars.bin
+#   python make_star_catalog.py --synthetic 2000000 ../assets/data/stars.bin
+#
+# The input is any CSV with ra (hours), dec (degrees), mag and ci (B-V) columns, such as the HYG database.
+# Layout (little endian): "STAR", version, star count, bin count, first bin magnitude, bin width,
+# bin count cumulative star counts, then per star 3 x f32 unit direction (J2000 ecliptic) and
+# 2 x f16 (magnitude, colour index). Stars are sorted brightest first.
+import argparse
+import numpy as np
+import pandas as pd
+
+VERSION = 1
+FIRST_BIN_MAGNITUDE = -2.0
+BIN_WIDTH = 0.1
+BIN_COUNT = 240 # up to magnitude 22
+OBLIQUITY = np.radians(23.4392911) # J2000 mean obliquity of the ecliptic
+
+def equatorial_to_ecliptic(ra, dec):
+    x = np.cos(dec) * np.cos(ra)
+    y = np.cos(dec) * np.sin(ra)
+    z = np.sin(dec)
+    c, s = np.cos(OBLIQUITY), np.sin(OBLIQUITY)
+    return np.stack([x, c * y + s * z, -s * y + c * z], axis=1)
+
+def load_csv(path):
+    table = pd.read_csv(path, usecols=['ra', 'dec', 'mag', 'ci'], low_memory=False)
+    table = table.dropna(subset=['ra', 'dec', 'mag'])
+    # the sun is row 0 of HYG and sits at distance 0
+    table = table[table['mag'] > -20.0]
+    ra = np.radians(table['ra'].to_numpy(dtype=np.float64) * 15.0)
+    dec = np.radians(table['dec'].to_numpy(dtype=np.float64))
+    colour = table['ci'].fillna(0.65).to_numpy(dtype=np.float64)
+    return equatorial_to_ecliptic(ra, dec), table['mag'].to_numpy(dtype=np.float64), colour
+
+def synthetic(count, seed=1):
+    # uniform on the sphere, magnitudes following the roughly 10^(0.35 m) growth of star counts
+    rng = np.random.default_rng(seed)
+    direction = rng.normal(size=(count, 3))
+    direction /= np.linalg.norm(direction, axis=1, keepdims=True)
+    low, high = 10.0 ** (0.35 * -1.5), 10.0 ** (0.35 * 16.0)
+    magnitude = np.log10(rng.uniform(low, high, count)) / 0.35
+    colour = np.clip(rng.normal(0.65, 0.45, count), -0.4, 2.0)
+    return direction, magnitude, colour
+
+def write(path, direction, magnitude, colour):
+    order = np.argsort(magnitude, kind='stable')
+    direction, magnitude, colour = direction[order], magnitude[order], colour[order]
+    edges = FIRST_BIN_MAGNITUDE + BIN_WIDTH * np.arange(1, BIN_COUNT + 1)
+    # stars brighter than or equal to each bin's upper edge
+    bins = np.searchsorted(magnitude, edges, side='right').astype('<u4')
+
+    records = np.zeros(len(magnitude), dtype=[('direction', '<f4', 3), ('magnitude', '<f2'), ('colour', '<f2')])
+    records['direction'] = direction
+    records['magnitude'] = magnitude
+    records['colour'] = colour
+
+    header = np.array([(b'STAR', VERSION, len(records), BIN_COUNT, FIRST_BIN_MAGNITUDE, BIN_WIDTH)],
+        dtype=[('magic', 'S4'), ('version', '<u4'), ('count', '<u4'), ('bins', '<u4'), ('first', '<f4'), ('width', '<f4')])
+    with open(path, 'wb') as file:
+        file.write(header.tobytes())
+        file.write(bins.tobytes())
+        file.write(records.tobytes())
+    print(f'Wrote {len(records)} stars to {path}')
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Build the binary star catalogue')
+    parser.add_argument('input', nargs='?', help='star CSV with ra, dec, mag and ci columns')
+    parser.add_argument('output', help='output stars.bin')
+    parser.add_argument('--synthetic', type=int, metavar='N', help='generate N random stars instead of reading a CSV')
+    args = parser.parse_args()
+    if args.synthetic:
+        write(args.output, *synthetic(args.synthetic))
+    elif args.input:
+        write(args.output, *load_csv(args.input))
+    else:
+        parser.error('give an input CSV or --synthetic N')
@@ -0,0 +1,243 @@
+#include "dynamics_export.h"
+#include "util/util_block_writer.h"
+#include "util/util_jobs.h"
+#include <glm/vec3.hpp>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	// half the central difference interval, a minute keeps the truncation error far below the orbit models' own
+	constexpr double kVelocityStep = 1.0 / 1440.0;
+	constexpr double kSecondsPerDay = 86400.0;
+	// CSV rows evaluated together before they are formatted in order
+	constexpr uint64_t kCsvBatch = 1024;
+	constexpr size_t kSampleGrain = 16;
+
+	struct Sample {
+		glm::dvec3 position;
+		glm::dvec3 velocity;
+	};
+
+	Sample Evaluate(const SolarBody& body, double time, bool velocities) {
+		Sample sample{ body.GetPositionAtTime(time), glm::dvec3(0.0) };
+		if (velocities) {
+			const glm::dvec3 ahead = body.GetPositionAtTime(time + kVelocityStep);
+			const glm::dvec3 behind = body.GetPositionAtTime(time - kVelocityStep);
+			sample.velocity = (ahead - behind) / (2.0 * kVelocityStep * kSecondsPerDay);
+		}
+		return sample;
+	}
+
+	template<typename F>
+	void ForEachSample(JobSystem* jobs, size_t count, F&& function) {
+		if (jobs) {
+			jobs->ParallelFor(0, count, kSampleGrain, [&](size_t first, size_t last) {
+				for (size_t s = first; s < last; s++) {
+					function(s);
+				}
+			});
+		} else {
+			for (size_t s = 0; s < count; s++) {
+				function(s);
+			}
+		}
+	}
+
+	void WriteBinary(BlockWriter& writer, const std::vector<const SolarBody*>& bodies, const EphemerisExportOptions& options, uint64_t sampleCount, JobSystem* jobs) {
+		const uint32_t components = options.velocities ? 6 : 3;
+		const uint32_t columnCount = 1 + components * (uint32_t)bodies.size();
+		// one block fills one writer buffer
+		const uint32_t samplesPerBlock = (uint32_t)std::max<size_t>(1, (writer.GetBufferSize() - sizeof(EphemerisBlockHeader)) / (columnCount * sizeof(double)));
+		EphemerisFileHeader header{
+			.version = kEphemerisVersion,
+			.bodyCount = (uint32_t)bodies.size(),
+			.flags = options.velocities ? kEphemerisVelocities : 0u,
+			.sampleCount = sampleCount,
+			.samplesPerBlock = samplesPerBlock,
+			.columnCount = columnCount,
+			.startTime = options.startTime,
+			.step = options.step,
+		};
+		std::memcpy(header.magic, kEphemerisMagic, sizeof(header.magic));
+		writer.Write(&header, sizeof(header));
+		for (const SolarBody* body : bodies) {
+			char name[kEphemerisNameLength] = {};
+			std::memcpy(name, body->GetName().data(), std::min<size_t>(body->GetName().size(), kEphemerisNameLength - 1));
+			writer.Write(name, sizeof(name));
+		}
+		for (uint64_t first = 0; first < sampleCount; first += samplesPerBlock) {
+			const uint32_t count = (uint32_t)std::min<uint64_t>(samplesPerBlock, sampleCount - first);
+			const size_t blockSize = sizeof(EphemerisBlockHeader) + size_t(count) * columnCount * sizeof(double);
+			uint8_t* block = writer.Reserve(blockSize);
+			EphemerisBlockHeader blockHeader{ .firstSample = first, .sampleCount = count };
+			std::memcpy(block, &blockHeader, sizeof(blockHeader));
+			double* columns = reinterpret_cast<double*>(block + sizeof(blockHeader));
+			// samples write disjoint rows of every column, so they fill the block in any order
+			ForEachSample(jobs, count, [&](size_t s) {
+				const double time = options.startTime + double(first + s) * options.step;
+				columns[s] = time;
+				for (size_t b = 0; b < bodies.size(); b++) {
+					const Sample sample = Evaluate(*bodies[b], time, options.velocities);
+					double* bodyColumns = columns + (1 + b * components) * count;
+					for (int c = 0; c < 3; c++) {
+						bodyColumns[c * count + s] = sample.position[c];
+					}
+					if (options.velocities) {
+						for (int c = 0; c < 3; c++) {
+							bodyColumns[(3 + c) * count + s] = sample.velocity[c];
+						}
+					}
+				}
+			});
+			writer.Commit(blockSize);
+		}
+	}
+
+	void WriteCsv(BlockWriter& writer, const std::vector<const SolarBody*>& bodies, const EphemerisExportOptions& options, uint64_t sampleCount, JobSystem* jobs) {
+		std::string header = "jd";
+		for (const SolarBody* body : bodies) {
+			for (const char* suffix : { "_x", "_y", "_z" }) {
+				header += "," + body->GetName() + suffix;
+			}
+			if (options.velocities) {
+				for (const char* suffix : { "_vx", "_vy", "_vz" }) {
+					header += "," + body->GetName() + suffix;
+				}
+			}
+		}
+		header += "\n";
+		writer.Write(header.data(), header.size());
+		// shortest round trip form of a double is at most 24 characters, plus the separator
+		const size_t maxRowSize = 25 * (1 + bodies.size() * (options.velocities ? 6 : 3));
+		std::vector<Sample> samples(std::min(kCsvBatch, sampleCount) * bodies.size());
+		for (uint64_t first = 0; first < sampleCount; first += kCsvBatch) {
+			const size_t count = (size_t)std::min(kCsvBatch, sampleCount - first);
+			ForEachSample(jobs, count, [&](size_t s) {
+				const double time = options.startTime + double(first + s) * options.step;
+				for (size_t b = 0; b < bodies.size(); b++) {
+					samples[s * bodies.size() + b] = Evaluate(*bodies[b], time, options.velocities);
+				}
+			});
+			for (size_t s = 0; s < count; s++) {
+				const double time = options.startTime + double(first + s) * options.step;
+				char* row = reinterpret_cast<char*>(writer.Reserve(maxRowSize));
+				char* end = row + maxRowSize;
+				char* cursor = std::to_chars(row, end, time).ptr;
+				auto put = [&](double value) {
+					*cursor++ = ',';
+					cursor = std::to_chars(cursor, end, value).ptr;
+				};
+				for (size_t b = 0; b < bodies.size(); b++) {
+					const Sample& sample = samples[s * bodies.size() + b];
+					put(sample.position.x);
+					put(sample.position.y);
+					put(sample.position.z);
+					if (options.velocities) {
+						put(sample.velocity.x);
+						put(sample.velocity.y);
+						put(sample.velocity.z);
+					}
+				}
+				*cursor++ = '\n';
+				writer.Commit(cursor - row);
+			}
+		}
+	}
+}
+
+bool ExportEphemeris(SolarSystem& system, const EphemerisExportOptions& options, JobSystem* jobs) {
+	std::vector<const SolarBody*> bodies;
+	if (options.bodies.empty()) {
+		for (const auto& body : system.bodies) {
+			bodies.push_back(body.get());
+		}
+	}
+	for (const std::string& name : options.bodies) {
+		const SolarBody* body = system.GetBody(name);
+		if (!body) {
+			std::cerr << "Unknown body: " << name << "\n";
+			return false;
+		}
+		bodies.push_back(body);
+	}
+	if (options.step <= 0.0 || options.endTime < options.startTime) {
+		std::cerr << "Export needs a positive step and an end time after the start\n";
+		return false;
+	}
+	// the end is inclusive when it lands on a step, give or take rounding
+	const uint64_t sampleCount = uint64_t(std::floor((options.endTime - options.startTime) / options.step + 1e-9)) + 1;
+
+	const auto start = std::chrono::steady_clock::now();
+	BlockWriter writer(options.outputPath);
+	if (!writer.IsOpen()) {
+		std::cerr << "Could not open export output: " << options.outputPath << "\n";
+		return false;
+	}
+	if (options.format == EphemerisFormat::Binary) {
+		WriteBinary(writer, bodies, options, sampleCount, jobs);
+	} else {
+		WriteCsv(writer, bodies, options, sampleCount, jobs);
+	}
+	if (!writer.Close()) {
+		std::cerr << "Failed writing export output: " << options.outputPath << "\n";
+		return false;
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const double megabytes = writer.GetBytesWritten() / (1024.0 * 1024.0);
+	std::cout << "Exported " << sampleCount << " samples of " << bodies.size() << " bodies to " << options.outputPath
+		<< " (" << megabytes << " MiB in " << seconds << " s, " << megabytes / seconds << " MiB/s)" << std::endl;
+	return true;
+}
+
+bool ReadEphemeris(const std::filesystem::path& path, EphemerisData& data) {
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream) {
+		std::cerr << "Could not open ephemeris: " << path << "\n";
+		return false;
+	}
+	EphemerisFileHeader header;
+	if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, kEphemerisMagic, sizeof(header.magic)) != 0) {
+		std::cerr << "Not an ephemeris file: " << path << "\n";
+		return false;
+	}
+	const uint32_t components = (header.flags & kEphemerisVelocities) ? 6 : 3;
+	if (header.version != kEphemerisVersion || header.columnCount != 1 + components * header.bodyCount || header.samplesPerBlock == 0) {
+		std::cerr << "Unsupported ephemeris layout: " << path << "\n";
+		return false;
+	}
+	data.bodies.clear();
+	for (uint32_t b = 0; b < header.bodyCount; b++) {
+		char name[kEphemerisNameLength];
+		if (!stream.read(name, sizeof(name))) {
+			std::cerr << "Truncated ephemeris: " << path << "\n";
+			return false;
+		}
+		data.bodies.emplace_back(name, strnlen(name, sizeof(name)));
+	}
+	data.times.assign(header.sampleCount, 0.0);
+	data.positions.assign(header.sampleCount * header.bodyCount, glm::dvec3(0.0));
+	std::vector<double> columns;
+	for (uint64_t first = 0; first < header.sampleCount; first += header.samplesPerBlock) {
+		EphemerisBlockHeader blockHeader;
+		const uint32_t count = (uint32_t)std::min<uint64_t>(header.samplesPerBlock, header.sampleCount - first);
+		columns.resize(size_t(count) * header.columnCount);
+		if (!stream.read(reinterpret_cast<char*>(&blockHeader), sizeof(blockHeader)) || blockHeader.firstSample != first || blockHeader.sampleCount != count
+			|| !stream.read(reinterpret_cast<char*>(columns.data()), columns.size() * sizeof(double))) {
+			std::cerr << "Truncated ephemeris: " << path << "\n";
+			return false;
+		}
+		for (uint32_t s = 0; s < count; s++) {
+			data.times[first + s] = columns[s];
+			for (uint32_t b = 0; b < header.bodyCount; b++) {
+				const double* bodyColumns = columns.data() + (1 + b * components) * count;
+				data.positions[b * header.sampleCount + first + s] = glm::dvec3(bodyColumns[s], bodyColumns[count + s], bodyColumns[2 * count + s]);
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "dynamics_orbits.h"
+
+class JobSystem;
+
+enum class EphemerisFormat {
+	Binary,
+	Csv, // slower, for spreadsheets and quick checks
+};
+
+// Binary layout, host endianness:
+//	EphemerisFileHeader
+//	bodyCount names, kEphemerisNameLength bytes each, zero padded
+//	blocks until sampleCount samples are covered, each an EphemerisBlockHeader followed by columnCount columns of
+//	sampleCount doubles: time (Julian date), then per body x, y, z (metres) and vx, vy, vz (metres per second)
+// All blocks but the last hold samplesPerBlock samples.
+constexpr char kEphemerisMagic[4] = { 'S', 'E', 'P', 'H' };
+constexpr uint32_t kEphemerisVersion = 1;
+constexpr uint32_t kEphemerisNameLength = 32;
+constexpr uint32_t kEphemerisVelocities = 1 << 0;
+
+struct EphemerisFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t bodyCount;
+	uint32_t flags;
+	uint64_t sampleCount;
+	uint32_t samplesPerBlock;
+	uint32_t columnCount;
+	double startTime;
+	double step; // days
+};
+
+struct EphemerisBlockHeader {
+	uint64_t firstSample;
+	uint32_t sampleCount;
+	uint32_t padding;
+};
+
+struct EphemerisExportOptions {
+	std::vector<std::string> bodies; // empty for every body
+	double startTime = 2451545.0;
+	double endTime = 2451545.0 + 365.25;
+	double step = 1.0 / 24.0; // days
+	bool velocities = false;
+	std::filesystem::path outputPath;
+	EphemerisFormat format = EphemerisFormat::Binary;
+};
+
+// An ephemeris file read back whole, positions only. Also the layout of the Horizons reference states written by
+// py/get_data.py.
+struct EphemerisData {
+	std::vector<std::string> bodies;
+	std::vector<double> times;
+	std::vector<glm::dvec3> positions; // sample major per body, positions[body * times.size() + sample]
+	const glm::dvec3& GetPosition(size_t body, size_t sample) const { return positions[body * times.size() + sample]; }
+};
+
+bool ReadEphemeris(const std::filesystem::path& path, EphemerisData& data);
+
+// Samples heliocentric positions (and central difference velocities) over a time range and streams them to a file.
+// With a job system the samples are evaluated in parallel, the output is the same either way.
+bool ExportEphemeris(SolarSystem& system, const EphemerisExportOptions& options, JobSystem* jobs = nullptr);
@@ -1,65 +1,17 @@
 #include "dynamics_orbits.h"
+#include "dynamics_universal.h"
+#include "dynamics_tables.h"
+#include "dynamics_planets.h"
+#include "util/util_allocations.h"
+#include "util/util_jobs.h"
 #include <glm/gtc/constants.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <iostream>
+#include <algorithm>
 #include <optional>
 #include <charconv>
-#include <filesystem>
-#include <fstream>
-
-static std::string_view StripSpaces(std::string_view view) {
-	size_t first = view.find_first_not_of(' ');
-	size_t last = view.find_last_not_of(' ') + 1;
-	return view.substr(first, last - first);
-}
-
-class TableView {
-public:
-	TableView(std::string_view tablePath) {
-		// Get File
-		std::ifstream ifs(std::filesystem::current_path() / "assets" / "data" / tablePath);
-		std::string data((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
-		// Get lines
-		size_t lineStart{ 0 };
-		for (size_t lineEnd = 0; lineEnd <= data.size(); lineEnd++) {
-			if (lineEnd == data.size() || data.at(lineEnd) == '\n') {
-				int lineLength = lineEnd - lineStart;
-				auto line = std::string_view(data).substr(lineStart, lineLength);
-				// Get cells
-				std::vector<std::string> lineCells;
-				size_t cellStart{ 0 };
-				for (size_t cellEnd = 0; cellEnd < line.size(); cellEnd++) {
-					if (line.at(cellEnd) == ',') {
-						int cellLength = cellEnd - cellStart;
-						lineCells.push_back(std::string(line.substr(cellStart, cellLength)));
-						cellStart = cellEnd + 1;
-					}
-				}
-				if (!lineCells.empty()) {
-					_cells.push_back(lineCells);
-				}
-				lineStart = lineEnd + 1;
-			}
-		}
-	}
-	std::string_view GetCell(size_t column, size_t row) const {
-		return GetRow(row).at(column);
-	}
-	float GetCellValue(size_t column, size_t row) const {
-		std::string_view view = StripSpaces(GetCell(column, row));
-		double value{ NAN };
-		std::from_chars(view.data(), view.data() + view.size(), value);
-		return value;
-	}
-	const std::vector<std::string>& GetRow(size_t row) const {
-		return _cells.at(row);
-	}
-	size_t GetRowCount() const {
-		return _cells.size();
-	}
-private:
-	std::vector<std::vector<std::string>> _cells;
-};
+#include <cmath>
+#include <cstring>
 
 static double WrapToRange(double val, double min, double max) {
 	assert(max > min);
@@ -76,48 +28,94 @@ double VaryingElement::GetValueAtTime(double time) const {
 }
 
 const double METRES_PER_AU = 149597870700;
+const double SECONDS_PER_DAY = 86400.0;
 
-static double GetEccentricAnomaly(double eccentricity, double meanAnomaly) {
+// "2000-01-01.5" style calendar dates (TDB), Meeus' algorithm for the Gregorian calendar
+static double ParseEpoch(std::string_view view) {
+	view = StripSpaces(view);
+	int year{ 0 }, month{ 0 };
+	double day{ NAN };
+	const char* end = view.data() + view.size();
+	auto result = std::from_chars(view.data(), end, year);
+	if (result.ec != std::errc() || result.ptr == end || *result.ptr != '-') {
+		return J2000;
+	}
+	result = std::from_chars(result.ptr + 1, end, month);
+	if (result.ec != std::errc() || result.ptr == end || *result.ptr != '-') {
+		return J2000;
+	}
+	result = std::from_chars(result.ptr + 1, end, day);
+	if (result.ec != std::errc()) {
+		return J2000;
+	}
+	if (month <= 2) {
+		year -= 1;
+		month += 12;
+	}
+	const int century = year / 100;
+	const int leapCorrection = 2 - century + century / 4;
+	return floor(365.25 * (year + 4716)) + floor(30.6001 * (month + 1)) + day + leapCorrection - 1524.5;
+}
+
+double GetEccentricAnomaly(double eccentricity, double meanAnomaly) {
 	double E = meanAnomaly + eccentricity * sin(meanAnomaly);
 	int i = 0;
 	for (; i < 1000; i++) {// Cap iterations
 		const double dM = E - eccentricity * sin(E) - meanAnomaly;
 		const double dE = dM / (1.0 - eccentricity * cos(E));
 		E -= dE;
-		if (abs(dE) <= 1e-8) {// Error is small enough to stop
+		if (std::abs(dE) <= 1e-8) {// Error is small enough to stop
 			break;
 		}
 	}
 	return E;
 }
 
-KeplerOrbit::KeplerOrbit(SolarBody* parentBody, double a, double e, double w, double M, double I, double ln) : parentBody(parentBody), a(a), e(e), w(w), M(M), I(I), ln(ln) {
+KeplerOrbit::KeplerOrbit(SolarBody* parentBody, double a, double e, double w, double M, double I, double ln, double epoch, double n) : parentBody(parentBody), a(a), e(e), w(w), M(M), I(I), ln(ln), epoch(epoch), n(n) {
+	const double cosW = cos(w), sinW = sin(w);
+	const double cosN = cos(ln), sinN = sin(ln);
+	const double cosI = cos(I), sinI = sin(I);
+	_p = { cosW * cosN - sinW * sinN * cosI, cosW * sinN + sinW * cosN * cosI, sinW * sinI };
+	_q = { -sinW * cosN - cosW * sinN * cosI, -sinW * sinN + cosW * cosN * cosI, cosW * sinI };
+	_b = a * sqrt(1.0 - e * e);
 }
 
 glm::dvec3 KeplerOrbit::GetPositionAtTime(double time) const {
-	const double E = GetEccentricAnomaly(e, M);
-	// Planets position in its own orbital plane
-	glm::dvec3 pos{ 
-		a * (cos(E) - e),
-		a * sqrt(1.0 - e * e) * sin(E),
-		0.0 
-	};
-	// get coordinates in J2000 ecliptic plane
-	pos = {
-		(cos(w) * cos(ln) - sin(w) * sin(ln) * cos(I)) * pos.x + (-sin(w) * cos(ln) - cos(w) * sin(ln) * cos(I)) * pos.y,
-		(cos(w) * sin(ln) + sin(w) * cos(ln) * cos(I)) * pos.x + (-sin(w) * sin(ln) + cos(w) * cos(ln) * cos(I)) * pos.y,
-		(sin(w) * sin(I)) * pos.x + (cos(w) * sin(I)) * pos.y,
-	};
+	glm::dvec3 pos = GetRelativePositionAtTime(time);
 	if (parentBody) {
 		pos += parentBody->GetPositionAtTime(time);
 	}
 	return pos;
 }
 
+double KeplerOrbit::GetMaxDistance() const {
+	return a * (1.0 + e);
+}
+
+glm::dvec3 KeplerOrbit::GetRelativePositionAtTime(double time) const {
+	const double meanAnomaly = n == 0.0 ? M : WrapToRange(M + n * (time - epoch), -glm::pi<double>(), glm::pi<double>());
+	const double E = GetEccentricAnomaly(e, meanAnomaly);
+	// position in the orbital plane, taken into the J2000 ecliptic plane
+	return _p * (a * (cos(E) - e)) + _q * (_b * sin(E));
+}
+
 VaryingKeplerOrbit::VaryingKeplerOrbit(SolarBody* parentBody, VaryingElement a_wr, VaryingElement e_wr, VaryingElement I_wr, VaryingElement L_wr, VaryingElement lp_wr, VaryingElement ln_wr) : parentBody(parentBody), a_wr(a_wr), e_wr(e_wr), I_wr(I_wr), L_wr(L_wr), lp_wr(lp_wr), ln_wr(ln_wr) {
 }
 
 glm::dvec3 VaryingKeplerOrbit::GetPositionAtTime(double time) const {
+	glm::dvec3 pos = GetRelativePositionAtTime(time);
+	if (parentBody) {
+		pos += parentBody->GetPositionAtTime(time);
+	}
+	return pos;
+}
+
+double VaryingKeplerOrbit::GetMaxDistance() const {
+	// the elements drift by well under a percent a century, the margin keeps the bound valid for millennia around J2000
+	return a_wr.value * (1.0 + e_wr.value) * METRES_PER_AU * 1.01;
+}
+
+glm::dvec3 VaryingKeplerOrbit::GetRelativePositionAtTime(double time) const {
 	const double lp = glm::radians(lp_wr.GetValueAtTime(time));
 	const double L = glm::radians(L_wr.GetValueAtTime(time));
 	const double ln = glm::radians(ln_wr.GetValueAtTime(time));
@@ -125,19 +123,31 @@ glm::dvec3 VaryingKeplerOrbit::GetPositionAtTime(double time) const {
 	const double w = lp - ln; // Argument of Perihelion
 	const double M = WrapToRange(L - lp, -glm::pi<double>(), glm::pi<double>()); // Mean Anomaly
 	KeplerOrbit orbit(parentBody, a_wr.GetValueAtTime(time) * METRES_PER_AU, e_wr.GetValueAtTime(time), w, M, I, ln);
-	return orbit.GetPositionAtTime(time);
+	return orbit.GetRelativePositionAtTime(time);
 }
 
-SolarBody::SolarBody(std::string_view name, double radius, SolarBodyDriver* driver) : _name(name), _radius(radius), _driver(driver) {}
+SolarBody::SolarBody(std::string_view name, double radius, SolarBodyDriver* driver, double gm) : _name(name), _index(0), _radius(radius), _gm(gm), _driver(driver), _parent(nullptr), _subsystemExtent(0.0), _subsystemBodyRadius(radius) {}
 
 const std::string& SolarBody::GetName() const {
 	return _name;
 }
 
+uint32_t SolarBody::GetIndex() const {
+	return _index;
+}
+
 double SolarBody::GetRadius() const {
 	return _radius;
 }
 
+double SolarBody::GetGravitationalParameter() const {
+	return _gm;
+}
+
+const SolarBodyDriver* SolarBody::GetDriver() const {
+	return _driver.get();
+}
+
 glm::dvec3 SolarBody::GetPositionAtTime(double time) const {
 	if (_driver) {
 		return _driver->GetPositionAtTime(time);
@@ -145,45 +155,100 @@ glm::dvec3 SolarBody::GetPositionAtTime(double time) const {
 	return glm::dvec3(0.0);
 }
 
-SolarSystem::SolarSystem() {
-	// Radius: https://ssd.jpl.nasa.gov/bodies/phys_par.html
-	TableView planetOrbits("PlanetOrbits.csv");
-	sun = AddBody(new SolarBody("Sun", 695'508'000));
-	auto PlanetFromTable = [&](size_t row, double radius) -> SolarBody* {
-		SolarBody* planet = new SolarBody(StripSpaces(planetOrbits.GetCell(0, row)), radius, new VaryingKeplerOrbit(
-			sun,
-			{planetOrbits.GetCellValue(1, row), planetOrbits.GetCellValue(1, row + 1)},
-			{planetOrbits.GetCellValue(2, row), planetOrbits.GetCellValue(2, row + 1)},
-			{planetOrbits.GetCellValue(3, row), planetOrbits.GetCellValue(3, row + 1)},
-			{planetOrbits.GetCellValue(4, row), planetOrbits.GetCellValue(4, row + 1)},
-			{planetOrbits.GetCellValue(5, row), planetOrbits.GetCellValue(5, row + 1)},
-			{planetOrbits.GetCellValue(6, row), planetOrbits.GetCellValue(6, row + 1)}
-		));
-		return planet;
-	};
-	mercury = AddBody(PlanetFromTable(2, 2'439'400));
-	venus = AddBody(PlanetFromTable(4, 6'051'800));
-	earth = AddBody(PlanetFromTable(6, 6'371'008));
-	mars = AddBody(PlanetFromTable(8, 3'389'500));
-	jupiter = AddBody(PlanetFromTable(10, 69'911'000));
-	saturn = AddBody(PlanetFromTable(12, 58'232'000));
-	uranus = AddBody(PlanetFromTable(14, 25'362'000));
-	neptune = AddBody(PlanetFromTable(16, 24'622'000));
-	TableView satOrbits("SatelliteOrbits.csv");
-	TableView satConstants("SatelliteConstants.csv");
-	auto SatelliteFromTable = [&](SolarBody* parent, size_t row, double radius) -> SolarBody* {
+glm::dvec3 SolarBody::GetRelativePositionAtTime(double time) const {
+	if (_driver) {
+		return _driver->GetRelativePositionAtTime(time);
+	}
+	return glm::dvec3(0.0);
+}
+
+SolarBody* SolarBody::GetParent() const {
+	return _parent;
+}
+
+const std::vector<SolarBody*>& SolarBody::GetSatellites() const {
+	return _satellites;
+}
+
+double SolarBody::GetSubsystemExtent() const {
+	return _subsystemExtent;
+}
+
+double SolarBody::GetSubsystemBodyRadius() const {
+	return _subsystemBodyRadius;
+}
+
+void SolarBody::AddSatellite(SolarBody* satellite) {
+	satellite->_parent = this;
+	_satellites.push_back(satellite);
+}
+
+void SolarBody::UpdateSubsystemBounds() {
+	_subsystemExtent = 0.0;
+	_subsystemBodyRadius = _radius;
+	for (SolarBody* satellite : _satellites) {
+		satellite->UpdateSubsystemBounds();
+		const double distance = satellite->_driver ? satellite->_driver->GetMaxDistance() : 0.0;
+		_subsystemExtent = std::max(_subsystemExtent, distance + satellite->_subsystemExtent);
+		_subsystemBodyRadius = std::max(_subsystemBodyRadius, satellite->_subsystemBodyRadius);
+	}
+}
+
+SolarSystem::SolarSystem(JobSystem* jobs) {
+	AllocationScope allocationScope(AllocationTag::Dynamics);
+	// the satellite tables are independent, so they parse at the same time
+	std::optional<TableView> satelliteTable, constantTable;
+	auto loadSatellites = [&] { satelliteTable.emplace("SatelliteOrbits.csv"); };
+	auto loadConstants = [&] { constantTable.emplace("SatelliteConstants.csv"); };
+	if (jobs) {
+		Job* tables = jobs->Create([] {});
+		jobs->Run(loadSatellites, tables);
+		jobs->Run(loadConstants, tables);
+		jobs->Submit(tables);
+		jobs->Wait(tables);
+	} else {
+		loadSatellites();
+		loadConstants();
+	}
+	// the sun and planets are compiled in, generated from PlanetOrbits.csv and PlanetConstants.csv
+	sun = AddBody(new SolarBody(kCentralBody.name, kCentralBody.radius, nullptr, kCentralBody.gm));
+	for (const PlanetElements& planet : kPlanetElements) {
+		AddBody(new SolarBody(planet.name, planet.radius, new VaryingKeplerOrbit(sun, planet.a, planet.e, planet.I, planet.L, planet.lp, planet.ln), planet.gm), sun);
+	}
+	// Elements: https://ssd.jpl.nasa.gov/tools/sbdb_lookup.html
+	AddBody(new SolarBody("Halley", 5'500, new UniversalOrbit(sun, {
+		0.58598 * METRES_PER_AU, 0.96714, glm::radians(111.332), glm::radians(162.262), glm::radians(59.396), 2446470.959
+	})), sun);
+	AddBody(new SolarBody("'Oumuamua", 100, new UniversalOrbit(sun, {
+		0.25534 * METRES_PER_AU, 1.20113, glm::radians(241.811), glm::radians(122.742), glm::radians(24.597), 2458006.007
+	})), sun);
+	const TableView& satOrbits = *satelliteTable;
+	const TableView& satConstants = *constantTable;
+	const TableIndex constantsByName(satConstants, 1, 2);
+	auto SatelliteFromTable = [&](SolarBody* parent, size_t row, double radius, double gm) -> SolarBody* {
+		const double a = satOrbits.GetCellValue(5, row) * 1000.0;
+		// mean motion from the sidereal period, or from the two body problem when the table has none
+		const double period = satOrbits.GetCellValue(11, row);
+		double n = 0.0;
+		if (period > 0.0) {
+			n = glm::two_pi<double>() / period;
+		} else if (parent->GetGravitationalParameter() > 0.0) {
+			n = sqrt((parent->GetGravitationalParameter() + gm) / (a * a * a)) * SECONDS_PER_DAY;
+		}
 		SolarBody* satellite = new SolarBody(StripSpaces(satOrbits.GetCell(1, row)), radius, new KeplerOrbit(
 			parent,
-			satOrbits.GetCellValue(5, row) * 1000.0,
+			a,
 			satOrbits.GetCellValue(6, row),
 			glm::radians(satOrbits.GetCellValue(7, row)),
 			glm::radians(satOrbits.GetCellValue(8, row)),
 			glm::radians(satOrbits.GetCellValue(9, row)),
-			glm::radians(satOrbits.GetCellValue(10, row))
-		));
+			glm::radians(satOrbits.GetCellValue(10, row)),
+			ParseEpoch(satOrbits.GetCell(4, row)),
+			n
+		), gm);
 		return satellite;
 	};
-	for (int row = 2; row < satOrbits.GetRowCount(); row++) {
+	for (size_t row = 2; row < satOrbits.GetRowCount(); row++) {
 		// Check it is ecliptic
 		//if (StripSpaces(satOrbits.GetCell(3, row)) != "ecliptic") {
 		//	continue;
@@ -194,31 +259,161 @@ SolarSystem::SolarSystem() {
 		if (!parent) {
 			continue;
 		}
-		// Find radius
-		auto satName = satOrbits.GetCell(1, row);
-		double radius = 0.0f;
-		for (int crow = 2; crow < satConstants.GetRowCount(); crow++) {
-			if (satConstants.GetCell(1, crow) == satName) {
-				radius = satConstants.GetCellValue(4, crow) * 1000.0;
-			}
+		// Find radius and GM
+		const size_t crow = constantsByName.Find(satOrbits.GetCell(1, row));
+		if (crow == TableIndex::kNotFound) {
+			continue;
 		}
-		if (radius == 0.0f) {
+		const double radius = satConstants.GetCellValue(4, crow) * 1000.0;
+		const double gm = satConstants.GetCellValue(3, crow) * 1e9;
+		if (!(radius > 0.0)) {
 			continue;
 		}
-		AddBody(SatelliteFromTable(parent, row, radius));
+		AddBody(SatelliteFromTable(parent, row, radius, std::isnan(gm) ? 0.0 : gm), parent);
 	}
+	Finish();
 }
 
-SolarBody* SolarSystem::GetBody(std::string_view bodyName) {
-	for (auto& body : bodies) {
-		if (body->GetName() == bodyName) {
-			return body.get();
+SolarSystem::SolarSystem(std::span<const BodyRecord> records) {
+	AllocationScope allocationScope(AllocationTag::Dynamics);
+	bodies.reserve(records.size());
+	for (const BodyRecord& record : records) {
+		const std::string_view name(record.name, strnlen(record.name, sizeof(record.name)));
+		if (record.parent >= (int32_t)bodies.size() || (record.parent < 0 && !bodies.empty())) {
+			std::cerr << "Body record " << name << " does not follow its parent" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		SolarBody* parent = record.parent < 0 ? nullptr : bodies[record.parent].get();
+		const double* el = record.elements;
+		SolarBodyDriver* driver = nullptr;
+		switch (record.driver) {
+		case DriverKind::VaryingKepler:
+			driver = new VaryingKeplerOrbit(parent, { el[0], el[1] }, { el[2], el[3] }, { el[4], el[5] }, { el[6], el[7] }, { el[8], el[9] }, { el[10], el[11] });
+			break;
+		case DriverKind::Kepler:
+			driver = new KeplerOrbit(parent, el[0], el[1], el[2], el[3], el[4], el[5], el[6], el[7]);
+			break;
+		case DriverKind::Universal:
+			driver = new UniversalOrbit(parent, { el[0], el[1], el[2], el[3], el[4], el[5] });
+			break;
+		default:
+			break;
 		}
+		AddBody(new SolarBody(name, record.radius, driver, record.gm), parent);
 	}
-	return nullptr;
+	if (bodies.empty()) {
+		std::cerr << "No body records" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	Finish();
 }
 
-SolarBody* SolarSystem::AddBody(SolarBody* newSolarBody) {
-	std::cout << "Added body [" << newSolarBody->GetName() << "]" << std::endl;
+void SolarSystem::Finish() {
+	sun = bodies[0].get();
+	mercury = GetBody("Mercury");
+	venus = GetBody("Venus");
+	earth = GetBody("Earth");
+	mars = GetBody("Mars");
+	jupiter = GetBody("Jupiter");
+	saturn = GetBody("Saturn");
+	uranus = GetBody("Uranus");
+	neptune = GetBody("Neptune");
+	sun->UpdateSubsystemBounds();
+	std::cout << "Loaded " << bodies.size() << " bodies" << std::endl;
+	_batched.assign(bodies.size(), false);
+	for (const auto& body : bodies) {
+		const auto* orbit = dynamic_cast<const KeplerOrbit*>(body->GetDriver());
+		if (orbit && body->GetParent() != sun && SatelliteBatch::Supports(*orbit)) {
+			_satelliteBatch.Add(body->GetIndex(), *orbit);
+			_batched[body->GetIndex()] = true;
+		}
+	}
+	// the planets skip the virtual drivers when they are exactly the ones the generated table describes
+	_constantPlanets = bodies.size() >= kFirstPlanet + kPlanetCount;
+	for (size_t i = 0; i < kPlanetCount && _constantPlanets; i++) {
+		const SolarBody& body = *bodies[kFirstPlanet + i];
+		const auto* orbit = dynamic_cast<const VaryingKeplerOrbit*>(body.GetDriver());
+		_constantPlanets = orbit && body.GetParent() == sun && HasPlanetElements(*orbit, kPlanetElements[i]);
+	}
+}
+
+void SolarSystem::GetRelativePositions(double time, std::vector<glm::dvec3>& positions, bool mixedPrecision, JobSystem* jobs) const {
+	positions.resize(bodies.size());
+	auto evaluate = [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) {
+			const bool constantPlanet = _constantPlanets && i >= kFirstPlanet && i < kFirstPlanet + kPlanetCount;
+			if ((!mixedPrecision || !_batched[i]) && !constantPlanet) {
+				positions[i] = bodies[i]->GetRelativePositionAtTime(time);
+			}
+		}
+	};
+	if (jobs) {
+		jobs->ParallelFor(0, bodies.size(), 64, evaluate);
+	} else {
+		evaluate(0, bodies.size());
+	}
+	if (_constantPlanets) {
+		GetConstantPlanetPositions(time, positions.data() + kFirstPlanet);
+	}
+	if (mixedPrecision) {
+		_satelliteBatch.Evaluate(time, positions.data());
+	}
+}
+
+std::vector<BodyRecord> SolarSystem::GetRecords() const {
+	std::vector<BodyRecord> records(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++) {
+		const SolarBody& body = *bodies[i];
+		BodyRecord& record = records[i];
+		record = {};
+		body.GetName().copy(record.name, sizeof(record.name) - 1);
+		record.parent = body.GetParent() ? (int32_t)body.GetParent()->GetIndex() : -1;
+		record.radius = body.GetRadius();
+		record.gm = body.GetGravitationalParameter();
+		double* el = record.elements;
+		const SolarBodyDriver* driver = body.GetDriver();
+		if (const auto* orbit = dynamic_cast<const VaryingKeplerOrbit*>(driver)) {
+			record.driver = DriverKind::VaryingKepler;
+			const VaryingElement* elements[] = { &orbit->a_wr, &orbit->e_wr, &orbit->I_wr, &orbit->L_wr, &orbit->lp_wr, &orbit->ln_wr };
+			for (size_t j = 0; j < 6; j++) {
+				el[j * 2] = elements[j]->value;
+				el[j * 2 + 1] = elements[j]->rate;
+			}
+		} else if (const auto* orbit = dynamic_cast<const KeplerOrbit*>(driver)) {
+			record.driver = DriverKind::Kepler;
+			const double values[] = { orbit->a, orbit->e, orbit->w, orbit->M, orbit->I, orbit->ln, orbit->epoch, orbit->n };
+			std::copy(std::begin(values), std::end(values), el);
+		} else if (const auto* orbit = dynamic_cast<const UniversalOrbit*>(driver)) {
+			record.driver = DriverKind::Universal;
+			const UniversalElements& e = orbit->elements;
+			const double values[] = { e.q, e.e, e.w, e.I, e.ln, e.periapsisTime };
+			std::copy(std::begin(values), std::end(values), el);
+		} else {
+			record.driver = DriverKind::Fixed;
+		}
+	}
+	return records;
+}
+
+const SatelliteBatch& SolarSystem::GetSatelliteBatch() const {
+	return _satelliteBatch;
+}
+
+bool SolarSystem::IsBatched(uint32_t index) const {
+	return _batched[index];
+}
+
+SolarBody* SolarSystem::GetBody(std::string_view bodyName) {
+	auto it = _bodiesByName.find(bodyName);
+	return it == _bodiesByName.end() ? nullptr : it->second;
+}
+
+SolarBody* SolarSystem::AddBody(SolarBody* newSolarBody, SolarBody* parent) {
+	if (parent) {
+		parent->AddSatellite(newSolarBody);
+	}
+	newSolarBody->_index = (uint32_t)bodies.size();
+	// keyed by the body's own name, which lives as long as the body
+	_bodiesByName.emplace(newSolarBody->GetName(), newSolarBody);
 	return bodies.emplace_back(newSolarBody).get();
 }
@@ -1,23 +1,45 @@
 #pragma once
+#include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 #include <memory>
 #include <unordered_map>
 #include <glm/vec3.hpp>
+#include "dynamics_satellites.h"
 
 class SolarBody;
 
 class SolarBodyDriver {
 public:
+	virtual ~SolarBodyDriver() = default;
 	virtual glm::dvec3 GetPositionAtTime(double time) const = 0;
+	// position relative to the parent body, so a hierarchy can be walked without re-evaluating the parents
+	virtual glm::dvec3 GetRelativePositionAtTime(double time) const = 0;
+	// furthest the body gets from its parent, the apoapsis a(1 + e)
+	virtual double GetMaxDistance() const = 0;
 };
 
+constexpr double J2000 = 2451545.0;
+
+// Newton iteration on Kepler's equation M = E - e sin(E), for elliptic orbits
+double GetEccentricAnomaly(double eccentricity, double meanAnomaly);
+
 class KeplerOrbit : public SolarBodyDriver {
 public:
-	KeplerOrbit(SolarBody* parentBody, double a, double e, double w, double M, double I, double ln);
+	// M is the mean anomaly at epoch, n the mean motion in radians per day (zero holds the body at M)
+	KeplerOrbit(SolarBody* parentBody, double a, double e, double w, double M, double I, double ln, double epoch = J2000, double n = 0.0);
+	// the elements are fixed after construction, the orbital frame is derived from them once
 	double a, e, w, M, I, ln;
+	double epoch, n;
 	SolarBody* parentBody;
 	glm::dvec3 GetPositionAtTime(double time) const override;
+	glm::dvec3 GetRelativePositionAtTime(double time) const override;
+	double GetMaxDistance() const override;
+private:
+	// perifocal axes in the J2000 ecliptic, towards periapsis and 90 degrees ahead of it in the direction of motion
+	glm::dvec3 _p, _q;
+	double _b; // semi-minor axis
 };
 
 struct VaryingElement {
@@ -32,23 +54,68 @@ public:
 	VaryingElement a_wr, e_wr, I_wr, L_wr, lp_wr, ln_wr;
 	SolarBody* parentBody;
 	glm::dvec3 GetPositionAtTime(double time) const override;
+	glm::dvec3 GetRelativePositionAtTime(double time) const override;
+	double GetMaxDistance() const override;
 };
 
 class SolarBody {
 public:
-	SolarBody(std::string_view name, double radius, SolarBodyDriver* driver = nullptr);
+	SolarBody(std::string_view name, double radius, SolarBodyDriver* driver = nullptr, double gm = 0.0);
 	const std::string& GetName() const;
+	uint32_t GetIndex() const; // position in SolarSystem::bodies
 	double GetRadius() const;
+	double GetGravitationalParameter() const; // m^3/s^2
+	const SolarBodyDriver* GetDriver() const;
 	glm::dvec3 GetPositionAtTime(double time) const;
+	glm::dvec3 GetRelativePositionAtTime(double time) const;
+	SolarBody* GetParent() const;
+	const std::vector<SolarBody*>& GetSatellites() const;
+	// bounds of the body and everything orbiting it, centred on the body: the furthest any satellite's centre can get
+	// and the largest radius among them, kept apart so renderers can scale radii without losing the bound
+	double GetSubsystemExtent() const;
+	double GetSubsystemBodyRadius() const;
+	void AddSatellite(SolarBody* satellite);
+	void UpdateSubsystemBounds();
 private:
+	friend class SolarSystem;
 	std::unique_ptr<SolarBodyDriver> _driver;
 	std::string _name;
+	uint32_t _index;
 	double _radius;
+	double _gm;
+	SolarBody* _parent;
+	std::vector<SolarBody*> _satellites;
+	double _subsystemExtent;
+	double _subsystemBodyRadius;
+};
+
+class JobSystem;
+
+enum class DriverKind : uint32_t {
+	Fixed,
+	VaryingKepler,
+	Kepler,
+	Universal
+};
+
+// A body flattened for the asset pack, bodies come after their parent. Elements by driver:
+// VaryingKepler value and rate pairs of a, e, I, L, lp, ln as in the table, Kepler a, e, w, M, I, ln, epoch, n,
+// Universal q, e, w, I, ln, periapsisTime.
+struct BodyRecord {
+	char name[32];
+	int32_t parent; // -1 for the root
+	DriverKind driver;
+	double radius;
+	double gm;
+	double elements[12];
 };
 
 class SolarSystem {
 public:
-	SolarSystem();
+	// with a job system the data tables are parsed in parallel
+	explicit SolarSystem(JobSystem* jobs = nullptr);
+	// from records baked by GetRecords, skipping the tables entirely
+	explicit SolarSystem(std::span<const BodyRecord> records);
 	SolarBody* sun;
 	SolarBody* mercury;
 	SolarBody* venus;
@@ -61,6 +128,20 @@ public:
 	SolarBody* neptune;
 	std::vector<std::unique_ptr<SolarBody>> bodies;
 	SolarBody* GetBody(std::string_view bodyName);
+	// every body's position relative to its parent, indexed like bodies. Mixed precision evaluates the satellites
+	// in float through the batch, the rest stay in double.
+	void GetRelativePositions(double time, std::vector<glm::dvec3>& positions, bool mixedPrecision, JobSystem* jobs = nullptr) const;
+	const SatelliteBatch& GetSatelliteBatch() const;
+	// whether mixed precision evaluates the body through the batch
+	bool IsBatched(uint32_t index) const;
+	std::vector<BodyRecord> GetRecords() const;
 private:
-	SolarBody* AddBody(SolarBody* body);
+	void Finish();
+	SolarBody* AddBody(SolarBody* body, SolarBody* parent = nullptr);
+	SatelliteBatch _satelliteBatch;
+	std::vector<bool> _batched;
+	// the planets follow the sun in the order of the generated table
+	static constexpr size_t kFirstPlanet = 1;
+	bool _constantPlanets = false;
+	std::unordered_map<std::string_view, SolarBody*> _bodiesByName;
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+# Writes the planet element tables as constexpr arrays, run with
+#   cmake -DORBITS=<PlanetOrbits.csv> -DCONSTANTS=<PlanetConstants.csv> -DOUTPUT=<header> -P dynamics_planet_elements.cmake
+# The orbits table has a row of J2000 values per planet followed by a row of rates per century, the constants table a
+# row of radius and GM per body. A body with constants but no elements is the central body.
+
+cmake_minimum_required(VERSION 3.12)
+
+function(read_rows path out)
+  file(STRINGS "${path}" lines)
+  # the column names and units rows
+  list(REMOVE_AT lines 0 1)
+  set(${out} "${lines}" PARENT_SCOPE)
+endfunction()
+
+read_rows("${CONSTANTS}" constant_rows)
+foreach(row IN LISTS constant_rows)
+  string(REPLACE "," ";" cells "${row}")
+  list(GET cells 0 name)
+  list(GET cells 1 radius)
+  list(GET cells 2 gm)
+  set(radius_${name} "${radius}")
+  set(gm_${name} "${gm}")
+  list(APPEND constant_names "${name}")
+endforeach()
+
+read_rows("${ORBITS}" orbit_rows)
+list(LENGTH orbit_rows row_count)
+set(planets "")
+set(planet_names "")
+math(EXPR last "${row_count} - 2")
+foreach(index RANGE 0 ${last} 2)
+  math(EXPR rate_index "${index} + 1")
+  list(GET orbit_rows ${index} value_row)
+  list(GET orbit_rows ${rate_index} rate_row)
+  string(REPLACE "," ";" values "${value_row}")
+  string(REPLACE "," ";" rates "${rate_row}")
+  list(GET values 0 name)
+  if (NOT DEFINED radius_${name})
+    message(FATAL_ERROR "${name} has elements in ${ORBITS} but no constants in ${CONSTANTS}")
+  endif()
+  set(elements "")
+  foreach(column RANGE 1 6)
+    list(GET values ${column} value)
+    list(GET rates ${column} rate)
+    string(APPEND elements ", { ${value}, ${rate} }")
+  endforeach()
+  string(APPEND planets "\t{ \"${name}\", ${radius_${name}}, ${gm_${name}}${elements} },\n")
+  list(APPEND planet_names "${name}")
+endforeach()
+
+set(central "")
+foreach(name IN LISTS constant_names)
+  if (NOT name IN_LIST planet_names)
+    if (central)
+      message(FATAL_ERROR "${CONSTANTS} has more than one body without elements")
+    endif()
+    set(central "constexpr BodyConstants kCentralBody{ \"${name}\", ${radius_${name}}, ${gm_${name}} };\n")
+  endif()
+endforeach()
+if (NOT central)
+  message(FATAL_ERROR "${CONSTANTS} has no central body")
+endif()
+
+get_filename_component(orbits_name "${ORBITS}" NAME)
+get_filename_component(constants_name "${CONSTANTS}" NAME)
+set(header "// Generated from ${orbits_name} and ${constants_name} by dynamics_planet_elements.cmake, edit those instead\n")
+string(APPEND header "// included by dynamics_planets.h\n#pragma once\n\n${central}\n")
+string(APPEND header "constexpr PlanetElements kPlanetElements[] = {\n${planets}};\n")
+file(WRITE "${OUTPUT}" "${header}")
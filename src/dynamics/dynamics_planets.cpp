@@ -0,0 +1,22 @@
+#include "dynamics_planets.h"
+#include <utility>
+
+namespace {
+	template<size_t... Indices>
+	void GetPositions(double time, glm::dvec3* positions, std::index_sequence<Indices...>) {
+		((positions[Indices] = ConstantPlanetOrbit<Indices>::GetRelativePositionAtTime(time)), ...);
+	}
+
+	bool IsSame(const VaryingElement& a, const VaryingElement& b) {
+		return a.value == b.value && a.rate == b.rate;
+	}
+}
+
+void GetConstantPlanetPositions(double time, glm::dvec3* positions) {
+	GetPositions(time, positions, std::make_index_sequence<kPlanetCount>());
+}
+
+bool HasPlanetElements(const VaryingKeplerOrbit& orbit, const PlanetElements& planet) {
+	return IsSame(orbit.a_wr, planet.a) && IsSame(orbit.e_wr, planet.e) && IsSame(orbit.I_wr, planet.I)
+		&& IsSame(orbit.L_wr, planet.L) && IsSame(orbit.lp_wr, planet.lp) && IsSame(orbit.ln_wr, planet.ln);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <glm/vec3.hpp>
+#include "dynamics_orbits.h"
+
+constexpr double kMetresPerAu = 149597870700.0;
+
+// Radius: https://ssd.jpl.nasa.gov/bodies/phys_par.html
+// GM: https://ssd.jpl.nasa.gov/astro_par.html
+struct BodyConstants {
+	const char* name;
+	double radius; // metres
+	double gm; // m^3/s^2
+};
+
+// J2000 values and rates per century as they are in the table, au and degrees
+struct PlanetElements {
+	const char* name;
+	double radius;
+	double gm;
+	VaryingElement a, e, I, L, lp, ln;
+};
+
+// kCentralBody and kPlanetElements, generated at build time from assets/data
+#include "dynamics/dynamics_planet_elements.h"
+
+constexpr size_t kPlanetCount = std::size(kPlanetElements);
+
+// One planet of the generated table evaluated without a virtual call. The unit conversions are folded into the
+// elements at compile time, and the rotation terms of an angle that is zero at every time are constants.
+template<size_t Index>
+class ConstantPlanetOrbit {
+public:
+	static glm::dvec3 GetRelativePositionAtTime(double time);
+private:
+	// value at J2000 and rate per day, in metres or radians
+	struct Element {
+		double value;
+		double rate;
+		constexpr bool IsZero() const { return value == 0.0 && rate == 0.0; }
+	};
+	static constexpr Element Fold(const VaryingElement& element, double scale) {
+		return { element.value * scale, element.rate * scale / 36525.0 };
+	}
+	static constexpr double kRadians = 3.141592653589793 / 180.0;
+	static constexpr PlanetElements kElements = kPlanetElements[Index];
+	static constexpr Element kA = Fold(kElements.a, kMetresPerAu);
+	static constexpr Element kE = Fold(kElements.e, 1.0);
+	static constexpr Element kI = Fold(kElements.I, kRadians);
+	static constexpr Element kL = Fold(kElements.L, kRadians);
+	static constexpr Element kLp = Fold(kElements.lp, kRadians);
+	static constexpr Element kLn = Fold(kElements.ln, kRadians);
+};
+
+template<size_t Index>
+glm::dvec3 ConstantPlanetOrbit<Index>::GetRelativePositionAtTime(double time) {
+	constexpr double kPi = 3.141592653589793;
+	const double t = time - J2000;
+	const double a = kA.value + kA.rate * t;
+	const double e = kE.value + kE.rate * t;
+	const double lp = kLp.value + kLp.rate * t;
+	const double ln = kLn.value + kLn.rate * t;
+	const double w = lp - ln; // argument of perihelion
+	// mean anomaly wrapped to [-pi, pi)
+	double M = std::fmod(kL.value + kL.rate * t - lp + kPi, 2.0 * kPi);
+	M = (M < 0.0 ? M + 2.0 * kPi : M) - kPi;
+	double cosI = 1.0, sinI = 0.0, cosN = 1.0, sinN = 0.0;
+	if constexpr (!kI.IsZero()) {
+		const double I = kI.value + kI.rate * t;
+		cosI = std::cos(I);
+		sinI = std::sin(I);
+	}
+	if constexpr (!kLn.IsZero()) {
+		cosN = std::cos(ln);
+		sinN = std::sin(ln);
+	}
+	const double cosW = std::cos(w), sinW = std::sin(w);
+	const glm::dvec3 p{ cosW * cosN - sinW * sinN * cosI, cosW * sinN + sinW * cosN * cosI, sinW * sinI };
+	const glm::dvec3 q{ -sinW * cosN - cosW * sinN * cosI, -sinW * sinN + cosW * cosN * cosI, cosW * sinI };
+	const double E = GetEccentricAnomaly(e, M);
+	return p * (a * (std::cos(E) - e)) + q * (a * std::sqrt(1.0 - e * e) * std::sin(E));
+}
+
+// every planet of the generated table relative to the central body, in table order
+void GetConstantPlanetPositions(double time, glm::dvec3* positions);
+// whether the orbit has exactly the elements of a generated planet
+bool HasPlanetElements(const VaryingKeplerOrbit& orbit, const PlanetElements& planet);
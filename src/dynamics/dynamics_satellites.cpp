@@ -0,0 +1,118 @@
+#include "dynamics_satellites.h"
+#include "dynamics_orbits.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	constexpr float kHalfPi = 1.57079632679489661923f;
+	// pi/2 split so j * kHalfPiHigh is exact for the quadrants reached here (Cody-Waite)
+	constexpr float kHalfPiHigh = 1.5703125f;
+	constexpr float kHalfPiLow = 4.83826794897e-4f;
+	// adding and removing 1.5 * 2^23 (2^52 for double) rounds to the nearest integer with plain arithmetic,
+	// std::nearbyint only becomes a SIMD instruction from SSE4.1
+	constexpr float kRoundFloat = 12582912.0f;
+	constexpr double kRoundDouble = 6755399441055744.0;
+
+	// sin and cos for |x| below a few pi, quadrant reduction and minimax polynomials on [-pi/4, pi/4], about 2 ulp.
+	// Selects instead of branches so it vectorises.
+	inline void SinCos(float x, float& s, float& c) {
+		const float j = (x * (1.0f / kHalfPi) + kRoundFloat) - kRoundFloat;
+		const float r = (x - j * kHalfPiHigh) - j * kHalfPiLow;
+		const float r2 = r * r;
+		const float sinR = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+		const float cosR = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+		const int quadrant = int(j) & 3;
+		const float sinQ = (quadrant & 1) ? cosR : sinR;
+		const float cosQ = (quadrant & 1) ? sinR : cosR;
+		s = (quadrant & 2) ? -sinQ : sinQ;
+		c = ((quadrant + 1) & 2) ? -cosQ : cosQ;
+	}
+
+	constexpr float kUlp = 5.9604645e-8f; // 2^-24
+}
+
+bool SatelliteBatch::Supports(const KeplerOrbit& orbit) {
+	return orbit.e <= kMaxEccentricity;
+}
+
+void SatelliteBatch::Add(uint32_t bodyIndex, const KeplerOrbit& orbit) {
+	// fill a padding slot if the last block has one, otherwise open a new block of lanes
+	if (_count == _a.size()) {
+		const size_t size = _a.size() + kLanes;
+		for (auto* array : { &_meanAnomaly, &_meanMotion, &_epoch }) {
+			array->resize(size, 0.0);
+		}
+		for (auto* array : { &_a, &_b, &_e, &_px, &_py, &_pz, &_qx, &_qy, &_qz }) {
+			array->resize(size, 0.0f);
+		}
+	}
+	const size_t i = _count++;
+	const double cosW = cos(orbit.w), sinW = sin(orbit.w);
+	const double cosN = cos(orbit.ln), sinN = sin(orbit.ln);
+	const double cosI = cos(orbit.I), sinI = sin(orbit.I);
+	_meanAnomaly[i] = orbit.M;
+	_meanMotion[i] = orbit.n;
+	_epoch[i] = orbit.epoch;
+	_a[i] = float(orbit.a);
+	_b[i] = float(orbit.a * sqrt(1.0 - orbit.e * orbit.e));
+	_e[i] = float(orbit.e);
+	_px[i] = float(cosW * cosN - sinW * sinN * cosI);
+	_py[i] = float(cosW * sinN + sinW * cosN * cosI);
+	_pz[i] = float(sinW * sinI);
+	_qx[i] = float(-sinW * cosN - cosW * sinN * cosI);
+	_qy[i] = float(-sinW * sinN + cosW * cosN * cosI);
+	_qz[i] = float(cosW * sinI);
+	_bodyIndices.push_back(bodyIndex);
+	// M is rounded to within pi ulp and the Kepler residual to a few ulp of pi + 1, each scaled by dE/dM <= 1/(1 - e)
+	// and |dr/dE| <= a. The trig, axes and final products add a handful of ulp of a.
+	_errorBounds.push_back(orbit.a * kUlp * (17.0 / (1.0 - orbit.e) + 8.0));
+}
+
+size_t SatelliteBatch::GetCount() const {
+	return _count;
+}
+
+uint32_t SatelliteBatch::GetBodyIndex(size_t i) const {
+	return _bodyIndices[i];
+}
+
+double SatelliteBatch::GetErrorBound(size_t i) const {
+	return _errorBounds[i];
+}
+
+void SatelliteBatch::Evaluate(double time, glm::dvec3* relativePositions) const {
+	const double twoPi = glm::two_pi<double>();
+	for (size_t block = 0; block < _a.size(); block += kLanes) {
+		float x[kLanes], y[kLanes], z[kLanes];
+		float meanAnomaly[kLanes];
+		// epoch accumulation in double, it grows without bound, only the wrapped angle becomes float
+		for (uint32_t l = 0; l < kLanes; l++) {
+			const size_t i = block + l;
+			const double m = _meanAnomaly[i] + _meanMotion[i] * (time - _epoch[i]);
+			meanAnomaly[l] = float(m - twoPi * ((m * (1.0 / twoPi) + kRoundDouble) - kRoundDouble));
+		}
+		for (uint32_t l = 0; l < kLanes; l++) {
+			const size_t i = block + l;
+			const float e = _e[i];
+			const float m = meanAnomaly[l];
+			// Danby's start, five Newton steps reach float precision for every e up to kMaxEccentricity
+			float E = m + (m >= 0.0f ? 0.85f : -0.85f) * e;
+			float sinE, cosE;
+			for (int iteration = 0; iteration < 5; iteration++) {
+				SinCos(E, sinE, cosE);
+				E -= (E - e * sinE - m) / (1.0f - e * cosE);
+			}
+			SinCos(E, sinE, cosE);
+			const float px = _a[i] * (cosE - e);
+			const float qy = _b[i] * sinE;
+			x[l] = _px[i] * px + _qx[i] * qy;
+			y[l] = _py[i] * px + _qy[i] * qy;
+			z[l] = _pz[i] * px + _qz[i] * qy;
+		}
+		const size_t lanes = std::min<size_t>(kLanes, _count - block);
+		for (size_t l = 0; l < lanes; l++) {
+			relativePositions[_bodyIndices[block + l]] = glm::dvec3(x[l], y[l], z[l]);
+		}
+	}
+}
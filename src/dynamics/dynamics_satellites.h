@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+
+class KeplerOrbit;
+
+// Parent relative positions of many Kepler satellites in single precision, eight lanes at a time. Moon offsets are at
+// most a few million kilometres so float resolves them to metres, while the mean anomaly is still advanced from the
+// epoch in double and only the wrapped angle is narrowed. The lane loops have no branches or library calls so the
+// compiler turns them into 8-wide SIMD.
+class SatelliteBatch {
+public:
+	static constexpr uint32_t kLanes = 8;
+	// the fixed iteration Kepler solve converges for e up to this, anything more eccentric stays in double
+	static constexpr double kMaxEccentricity = 0.95;
+	static bool Supports(const KeplerOrbit& orbit);
+	void Add(uint32_t bodyIndex, const KeplerOrbit& orbit);
+	size_t GetCount() const;
+	uint32_t GetBodyIndex(size_t i) const;
+	// worst case distance from the double precision position, metres
+	double GetErrorBound(size_t i) const;
+	// writes relativePositions[bodyIndex] for every satellite in the batch
+	void Evaluate(double time, glm::dvec3* relativePositions) const;
+private:
+	size_t _count = 0;
+	std::vector<uint32_t> _bodyIndices;
+	std::vector<double> _errorBounds;
+	// per orbit, padded to a whole number of lanes
+	std::vector<double> _meanAnomaly, _meanMotion, _epoch;
+	std::vector<float> _a, _b, _e;
+	std::vector<float> _px, _py, _pz, _qx, _qy, _qz;
+};
@@ -0,0 +1,91 @@
+#include "dynamics_tables.h"
+#include "util/util_allocations.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+std::string_view StripSpaces(std::string_view view) {
+	size_t first = view.find_first_not_of(' ');
+	if (first == std::string_view::npos) {
+		return {};
+	}
+	size_t last = view.find_last_not_of(' ') + 1;
+	return view.substr(first, last - first);
+}
+
+TableView::TableView(std::string_view tablePath) {
+	AllocationScope allocationScope(AllocationTag::Tables);
+	const auto path = std::filesystem::current_path() / "assets" / "data" / tablePath;
+	if (!_file.Open(path)) {
+		std::cerr << "Could not open table: " << path << "\n";
+		_rowStarts.push_back(0);
+		return;
+	}
+	const char* data = reinterpret_cast<const char*>(_file.GetData());
+	const char* end = data + _file.GetSize();
+	// sized up front so the views are written without the vectors growing
+	_cells.reserve(std::count(data, end, ',') + 1);
+	_rowStarts.reserve(std::count(data, end, '\n') + 2);
+	for (const char* line = data; line < end;) {
+		const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+		if (!lineEnd) {
+			lineEnd = end;
+		}
+		// every cell is ended by a comma, text after the last one on a line is not a cell
+		const size_t rowStart = _cells.size();
+		for (const char* cell = line;;) {
+			const char* cellEnd = static_cast<const char*>(std::memchr(cell, ',', lineEnd - cell));
+			if (!cellEnd) {
+				break;
+			}
+			_cells.emplace_back(cell, cellEnd - cell);
+			cell = cellEnd + 1;
+		}
+		if (_cells.size() > rowStart) {
+			_rowStarts.push_back((uint32_t)rowStart);
+		}
+		line = lineEnd + 1;
+	}
+	_rowStarts.push_back((uint32_t)_cells.size());
+}
+
+std::string_view TableView::GetCell(size_t column, size_t row) const {
+	if (row >= GetRowCount() || column >= GetColumnCount(row)) {
+		std::cerr << "Table cell out of range: column " << column << ", row " << row << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+	return _cells[_rowStarts[row] + column];
+}
+
+double TableView::GetCellValue(size_t column, size_t row) const {
+	std::string_view view = StripSpaces(GetCell(column, row));
+	double value{ NAN };
+	std::from_chars(view.data(), view.data() + view.size(), value);
+	return value;
+}
+
+size_t TableView::GetColumnCount(size_t row) const {
+	return _rowStarts[row + 1] - _rowStarts[row];
+}
+
+size_t TableView::GetRowCount() const {
+	return _rowStarts.size() - 1;
+}
+
+TableIndex::TableIndex(const TableView& table, size_t keyColumn, size_t firstRow) {
+	AllocationScope allocationScope(AllocationTag::Tables);
+	_rows.reserve(table.GetRowCount());
+	for (size_t row = firstRow; row < table.GetRowCount(); row++) {
+		if (keyColumn < table.GetColumnCount(row)) {
+			_rows[StripSpaces(table.GetCell(keyColumn, row))] = row;
+		}
+	}
+}
+
+size_t TableIndex::Find(std::string_view key) const {
+	auto it = _rows.find(StripSpaces(key));
+	return it == _rows.end() ? kNotFound : it->second;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "util/util_mapped_file.h"
+
+std::string_view StripSpaces(std::string_view view);
+
+// Comma separated table from assets/data, mapped rather than read. Cells are views into the mapping, so parsing is
+// one pass that only records where each cell starts and ends, and the table cannot be copied or moved.
+// A missing file is an empty table.
+class TableView {
+public:
+	TableView(std::string_view tablePath);
+	TableView(const TableView&) = delete;
+	TableView& operator=(const TableView&) = delete;
+	std::string_view GetCell(size_t column, size_t row) const;
+	// NAN for empty or non-numeric cells
+	double GetCellValue(size_t column, size_t row) const;
+	size_t GetColumnCount(size_t row) const;
+	size_t GetRowCount() const;
+private:
+	MappedFile _file;
+	std::vector<std::string_view> _cells; // every row back to back
+	std::vector<uint32_t> _rowStarts; // first cell of each row, then the cell count
+};
+
+// Hashed lookup from a key column to its row, for joining tables without scanning one per row of the other.
+// Keys are compared without surrounding spaces, a repeated key finds its last row.
+class TableIndex {
+public:
+	TableIndex(const TableView& table, size_t keyColumn, size_t firstRow = 0);
+	static constexpr size_t kNotFound = SIZE_MAX;
+	size_t Find(std::string_view key) const;
+private:
+	std::unordered_map<std::string_view, size_t> _rows;
+};
@@ -0,0 +1,252 @@
+#include "dynamics_universal.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+	constexpr double kSecondsPerDay = 86400.0;
+	// adding and removing 1.5 * 2^52 rounds to the nearest integer with plain arithmetic
+	constexpr double kRoundDouble = 6755399441055744.0;
+	// the batch series is taken at z / 4^kStumpffHalvings, within [-1, 1] for |z| up to 1024
+	constexpr int kStumpffHalvings = 5;
+	// from the start guesses five Halley steps reached double precision on every orbit tried from e = 0 to 4, one more
+	// is margin
+	constexpr int kHalleySteps = 6;
+
+	// Stumpff functions C(z) = (1 - cos sqrt z) / z and S(z) = (sqrt z - sin sqrt z) / sqrt z^3, continued through
+	// z <= 0 with cosh and sinh. Near zero the closed forms cancel, the series is used instead.
+	void Stumpff(double z, double& c, double& s) {
+		if (z > 0.1) {
+			const double root = sqrt(z);
+			c = (1.0 - cos(root)) / z;
+			s = (root - sin(root)) / (z * root);
+		} else if (z < -0.1) {
+			const double root = sqrt(-z);
+			c = (cosh(root) - 1.0) / -z;
+			s = (sinh(root) - root) / (-z * root);
+		} else {
+			c = 1.0 / 2.0 - z * (1.0 / 24.0 - z * (1.0 / 720.0 - z * (1.0 / 40320.0 - z / 3628800.0)));
+			s = 1.0 / 6.0 - z * (1.0 / 120.0 - z * (1.0 / 5040.0 - z * (1.0 / 362880.0 - z / 39916800.0)));
+		}
+	}
+
+	// Stumpff C and S for the batch without branches: the series at z / 4^n, then n doublings of the angle through
+	//	C(4z) = (1 - z S)^2 / 2 and S(4z) = (C + (1 - z C) S) / 4
+	// which only multiply and add, for either sign of z.
+	inline void StumpffDoubling(double z, double& c, double& s) {
+		double reduced = z * (1.0 / double(1 << (2 * kStumpffHalvings)));
+		c = 1.0 / 2.0 - reduced * (1.0 / 24.0 - reduced * (1.0 / 720.0 - reduced * (1.0 / 40320.0 - reduced * (1.0 / 3628800.0
+			- reduced * (1.0 / 479001600.0 - reduced * (1.0 / 87178291200.0 - reduced * (1.0 / 20922789888000.0 - reduced / 6402373705728000.0)))))));
+		s = 1.0 / 6.0 - reduced * (1.0 / 120.0 - reduced * (1.0 / 5040.0 - reduced * (1.0 / 362880.0 - reduced * (1.0 / 39916800.0
+			- reduced * (1.0 / 6227020800.0 - reduced * (1.0 / 1307674368000.0 - reduced * (1.0 / 355687428096000.0 - reduced / 121645100408832000.0)))))));
+		for (int i = 0; i < kStumpffHalvings; i++) {
+			const double c1 = 1.0 - reduced * s;
+			s = (c + (1.0 - reduced * c) * s) * 0.25;
+			c = 0.5 * c1 * c1;
+			reduced *= 4.0;
+		}
+	}
+
+	struct PerifocalPosition {
+		double x, y; // along P and Q
+	};
+
+	// start from the classical anomaly guesses, chi = sqrt(a) E or sqrt(-a) H, and near e = 1 from the exact parabolic
+	// solution of chi^3 + 6 q chi - 6 sqrt(mu) dt = 0
+	double GuessChi(double target, double q, double alpha) {
+		const double e = 1.0 - alpha * q;
+		if (alpha > 0.0 && e < 0.99) {
+			const double meanAnomaly = target * alpha * sqrt(alpha);
+			return (meanAnomaly + e * sin(meanAnomaly)) / sqrt(alpha);
+		}
+		if (alpha < 0.0 && e > 1.01) {
+			const double meanAnomaly = -target * alpha * sqrt(-alpha);
+			return asinh(meanAnomaly / e) / sqrt(-alpha);
+		}
+		const double halfQ = -3.0 * target;
+		const double root = sqrt(halfQ * halfQ + 8.0 * q * q * q);
+		return cbrt(-halfQ + root) + cbrt(-halfQ - root);
+	}
+
+	// Universal Kepler equation from periapsis, where the radial velocity is zero:
+	//	sqrt(mu) dt = (1 - alpha q) chi^3 S(alpha chi^2) + q chi
+	// its derivative in chi is the radius, so Newton steps are well behaved. A bracket keeps it safe far from
+	// periapsis on hyperbolic orbits, where the first guess can be poor.
+	PerifocalPosition Propagate(double sqrtMu, double q, double alpha, double v0, double dt) {
+		const double target = sqrtMu * dt;
+		if (target == 0.0) {
+			return { q, 0.0 };
+		}
+		// 1 - alpha q, the eccentricity
+		const double e = 1.0 - alpha * q;
+		auto evaluate = [&](double chi, double& radius, double& c, double& s) {
+			const double z = alpha * chi * chi;
+			Stumpff(z, c, s);
+			radius = chi * chi * c + q * (1.0 - z * c);
+			return e * chi * chi * chi * s + q * chi - target;
+		};
+		double chi = GuessChi(target, q, alpha);
+		const double inf = std::numeric_limits<double>::infinity();
+		double low = target > 0.0 ? 0.0 : -inf;
+		double high = target > 0.0 ? inf : 0.0;
+		if (alpha > 0.0 && e < 0.99) {
+			// dt is within half a period of periapsis, so |E| <= pi
+			const double sqrtA = 1.0 / sqrt(alpha);
+			low = std::max(low, -glm::pi<double>() * sqrtA);
+			high = std::min(high, glm::pi<double>() * sqrtA);
+		}
+		// F rises with chi and F(0) = -sqrt(mu) dt, Newton is kept inside the bracket that shrinks around the root.
+		// The last step is below 1e-11 of chi, so the Stumpff values from before it are kept.
+		double radius, c, s;
+		chi = std::clamp(chi, low, high);
+		for (int i = 0; i < 64; i++) {
+			const double f = evaluate(chi, radius, c, s);
+			if (f < 0.0) {
+				low = chi;
+			} else {
+				high = chi;
+			}
+			double next = chi - f / radius;
+			if (!(next >= low && next <= high)) {
+				next = std::isfinite(high) && std::isfinite(low) ? 0.5 * (low + high) : 2.0 * chi;
+			}
+			const bool converged = std::abs(next - chi) <= 1e-11 * std::abs(next);
+			if (converged) {
+				break;
+			}
+			chi = next;
+		}
+		// Lagrange coefficients: r = f r0 + g v0 with r0 = q P and v0 = v0 Q
+		const double f = 1.0 - chi * chi / q * c;
+		const double g = dt - chi * chi * chi / sqrtMu * s;
+		return { f * q, g * v0 };
+	}
+
+	void PerifocalAxes(double w, double I, double ln, glm::dvec3& p, glm::dvec3& q) {
+		const double cosW = cos(w), sinW = sin(w);
+		const double cosN = cos(ln), sinN = sin(ln);
+		const double cosI = cos(I), sinI = sin(I);
+		p = { cosW * cosN - sinW * sinN * cosI, cosW * sinN + sinW * cosN * cosI, sinW * sinI };
+		q = { -sinW * cosN - cosW * sinN * cosI, -sinW * sinN + cosW * cosN * cosI, cosW * sinI };
+	}
+
+	// bound orbits are wrapped to the revolution nearest periapsis so chi stays small however far the date is
+	double ReduceTime(double dt, double period) {
+		if (period > 0.0) {
+			dt -= period * std::round(dt / period);
+		}
+		return dt;
+	}
+}
+
+UniversalOrbit::UniversalOrbit(SolarBody* parentBody, const UniversalElements& elements) : parentBody(parentBody), elements(elements) {
+	const double mu = parentBody->GetGravitationalParameter();
+	PerifocalAxes(elements.w, elements.I, elements.ln, _p, _q);
+	_sqrtMu = sqrt(mu);
+	_alpha = (1.0 - elements.e) / elements.q;
+	_v0 = sqrt(mu * (1.0 + elements.e) / elements.q);
+	_period = _alpha > 0.0 ? 2.0 * glm::pi<double>() / (_sqrtMu * _alpha * sqrt(_alpha)) / kSecondsPerDay : 0.0;
+}
+
+glm::dvec3 UniversalOrbit::GetPositionAtTime(double time) const {
+	glm::dvec3 pos = GetRelativePositionAtTime(time);
+	if (parentBody) {
+		pos += parentBody->GetPositionAtTime(time);
+	}
+	return pos;
+}
+
+glm::dvec3 UniversalOrbit::GetRelativePositionAtTime(double time) const {
+	const double dt = ReduceTime(time - elements.periapsisTime, _period) * kSecondsPerDay;
+	const PerifocalPosition pos = Propagate(_sqrtMu, elements.q, _alpha, _v0, dt);
+	return _p * pos.x + _q * pos.y;
+}
+
+double UniversalOrbit::GetMaxDistance() const {
+	if (_alpha <= 0.0) {
+		return std::numeric_limits<double>::infinity();
+	}
+	return (1.0 / _alpha) * (1.0 + elements.e);
+}
+
+UniversalOrbitBatch::UniversalOrbitBatch(double gm) : _sqrtMu(sqrt(gm)) {
+}
+
+void UniversalOrbitBatch::Add(const UniversalElements& elements) {
+	glm::dvec3 p, q;
+	PerifocalAxes(elements.w, elements.I, elements.ln, p, q);
+	const double alpha = (1.0 - elements.e) / elements.q;
+	const double period = alpha > 0.0 ? 2.0 * glm::pi<double>() / (_sqrtMu * alpha * sqrt(alpha)) / kSecondsPerDay : 0.0;
+	// a new block of lanes is padded with copies of this orbit, so the spare lanes compute something finite
+	const size_t first = _count++;
+	size_t last = first + 1;
+	if (first == _q.size()) {
+		last = _q.size() + kLanes;
+		for (auto* array : { &_q, &_e, &_alpha, &_v0, &_period, &_inversePeriod, &_periapsisTime, &_px, &_py, &_pz, &_qx, &_qy, &_qz }) {
+			array->resize(last);
+		}
+	}
+	for (size_t i = first; i < last; i++) {
+		_q[i] = elements.q;
+		_e[i] = elements.e;
+		_alpha[i] = alpha;
+		_v0[i] = _sqrtMu * sqrt((1.0 + elements.e) / elements.q);
+		_period[i] = period;
+		_inversePeriod[i] = period > 0.0 ? 1.0 / period : 0.0;
+		_periapsisTime[i] = elements.periapsisTime;
+		_px[i] = p.x;
+		_py[i] = p.y;
+		_pz[i] = p.z;
+		_qx[i] = q.x;
+		_qy[i] = q.y;
+		_qz[i] = q.z;
+	}
+}
+
+size_t UniversalOrbitBatch::GetCount() const {
+	return _count;
+}
+
+void UniversalOrbitBatch::Evaluate(double time, glm::dvec3* relativePositions) const {
+	for (size_t block = 0; block < _q.size(); block += kLanes) {
+		double dt[kLanes], chi[kLanes];
+		// the guesses call sin, asinh or cbrt, so this loop stays scalar. Unbound orbits have an inverse period of 0.
+		for (uint32_t l = 0; l < kLanes; l++) {
+			const size_t i = block + l;
+			const double days = time - _periapsisTime[i];
+			dt[l] = (days - _period[i] * ((days * _inversePeriod[i] + kRoundDouble) - kRoundDouble)) * kSecondsPerDay;
+			chi[l] = GuessChi(_sqrtMu * dt[l], _q[i], _alpha[i]);
+		}
+		double x[kLanes], y[kLanes], z[kLanes];
+		for (uint32_t l = 0; l < kLanes; l++) {
+			const size_t i = block + l;
+			const double q = _q[i], e = _e[i], alpha = _alpha[i];
+			const double target = _sqrtMu * dt[l];
+			// Halley on F(chi) = e chi^3 S(psi) + q chi - sqrt(mu) dt with psi = alpha chi^2, F' is the radius and
+			// F'' = e chi (1 - psi S)
+			double root = chi[l];
+			double c, s;
+			for (int iteration = 0; iteration < kHalleySteps; iteration++) {
+				const double psi = alpha * root * root;
+				StumpffDoubling(psi, c, s);
+				const double f = e * root * root * root * s + q * root - target;
+				const double radius = e * root * root * c + q;
+				const double slope = e * root * (1.0 - psi * s);
+				root -= 2.0 * f * radius / (2.0 * radius * radius - f * slope);
+			}
+			StumpffDoubling(alpha * root * root, c, s);
+			const double f = 1.0 - root * root / q * c;
+			const double g = dt[l] - root * root * root / _sqrtMu * s;
+			const double px = f * q;
+			const double qy = g * _v0[i];
+			x[l] = _px[i] * px + _qx[i] * qy;
+			y[l] = _py[i] * px + _qy[i] * qy;
+			z[l] = _pz[i] * px + _qz[i] * qy;
+		}
+		const size_t lanes = std::min<size_t>(kLanes, _count - block);
+		for (size_t l = 0; l < lanes; l++) {
+			relativePositions[block + l] = glm::dvec3(x[l], y[l], z[l]);
+		}
+	}
+}
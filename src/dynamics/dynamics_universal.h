@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+#include "dynamics_orbits.h"
+
+// Conic defined from perihelion, valid for any eccentricity. Elliptic, parabolic and hyperbolic orbits share one
+// Kepler equation in the universal anomaly, so comets and interstellar objects need no special cases.
+struct UniversalElements {
+	double q; // periapsis distance, metres
+	double e;
+	double w, I, ln; // radians
+	double periapsisTime; // Julian date
+};
+
+class UniversalOrbit : public SolarBodyDriver {
+public:
+	// the parent's gravitational parameter drives the motion
+	UniversalOrbit(SolarBody* parentBody, const UniversalElements& elements);
+	UniversalElements elements;
+	SolarBody* parentBody;
+	glm::dvec3 GetPositionAtTime(double time) const override;
+	glm::dvec3 GetRelativePositionAtTime(double time) const override;
+	double GetMaxDistance() const override; // infinite unless the orbit is bound
+private:
+	glm::dvec3 _p, _q; // perifocal axes in the J2000 ecliptic
+	double _sqrtMu;
+	double _alpha; // 1/a, zero for a parabola and negative for a hyperbola
+	double _v0; // speed at periapsis
+	double _period; // days, zero unless bound
+};
+
+// Many orbits about one parent, for catalogues of thousands of comets. The same equation as UniversalOrbit in structure
+// of arrays, kLanes orbits at a time: the start guess is still taken per orbit, then a fixed number of Halley steps with
+// the Stumpff functions from a series and angle doubling run with no branches or library calls, so the lane loop
+// turns into SIMD like SatelliteBatch. Accurate for hyperbolic anomalies up to 32, far past anything near the sun.
+class UniversalOrbitBatch {
+public:
+	static constexpr uint32_t kLanes = 4;
+	explicit UniversalOrbitBatch(double gm);
+	void Add(const UniversalElements& elements);
+	size_t GetCount() const;
+	// positions relative to the parent, one per orbit in the order they were added
+	void Evaluate(double time, glm::dvec3* relativePositions) const;
+private:
+	double _sqrtMu;
+	size_t _count = 0;
+	// per orbit, padded to a whole number of lanes
+	std::vector<double> _q, _e, _alpha, _v0, _period, _inversePeriod, _periapsisTime;
+	std::vector<double> _px, _py, _pz, _qx, _qy, _qz;
+};
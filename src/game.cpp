@@ -5,15 +5,15 @@
 #include <SDL3/SDL_timer.h>
 #include <SDL3/SDL_mouse.h>
 #include <iostream>
+#include <algorithm>
+#include <optional>
+#include <fstream>
 #include <VkBootstrap.h>
 #define VMA_IMPLEMENTATION
 #include <vma/vk_mem_alloc.h>
 #include <imgui.h>
 #include <imgui_impl_sdl3.h>
 #include <imgui_impl_vulkan.h>
-#include <fastgltf/glm_element_traits.hpp>
-#include <fastgltf/core.hpp>
-#include <fastgltf/tools.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/matrix_clip_space.hpp> 
 #include <glm/gtc/matrix_transform.hpp>
@@ -22,388 +22,976 @@
 #include "graphics/graphics_errors.h"
 #include "graphics/graphics_shaders.h"
 #include "graphics/graphics_pipeline.h"
+#include "util/util_startup.h"
+
+constexpr VkFormat kDepthFormat{ VK_FORMAT_D32_SFLOAT };
+//hardcoding the draw format to 16 bit float
+constexpr VkFormat kDrawFormat{ VK_FORMAT_R16G16B16A16_SFLOAT };
+constexpr uint32_t kTrailSteps = 20;
+
+void Game::LoadSolarSystem() {
+	// baked records when the pack has them and the tables are unchanged, otherwise the tables
+	std::span<const BodyRecord> records = _assetPack.FindArray<BodyRecord>("dynamics/bodies", GetBodySourceStamp(std::filesystem::current_path() / "assets"));
+	if (!records.empty()) {
+		_solarSystem.emplace(records);
+	} else {
+		_solarSystem.emplace(&_jobs);
+	}
+}
 
-constexpr int kScreenWidth{ 1280 };
-constexpr int kScreenHeight{ 960 };
+Game::Game(const GameOptions& options) : _startTime(std::chrono::steady_clock::now()), _options(options), _jobs(options.threadCount),
+	_assetPack(std::filesystem::current_path() / "assets" / "steorra.pack", kAssetPackLayout), _window(nullptr),
+	_presentMode(options.presentMode), _lowLatency(options.lowLatency), _surface(VK_NULL_HANDLE), _keysDown{} {
+	AllocationScope allocationScope(AllocationTag::Graphics);
+	// Startup runs as a graph of stages. The tables and meshes need no device so they start straight away, once the
+	// device exists the swapchain, command buffers, descriptors, shaders and pipelines are created side by side.
+	// Stages that share state are ordered by their dependencies, the deletion queue is filled after the graph.
+	StartupGraph startup(_jobs, AllocationTag::Graphics);
+	startup.Add("Solar system", [&] {
+		LoadSolarSystem();
+	});
+	std::vector<DecodedMesh> decodedMeshes;
+	std::vector<MeshView> meshViews;
+	const auto decodeMeshes = startup.Add("Decode meshes", [&] {
+		if (!DecodeMeshes("basic_shapes.glb", decodedMeshes, meshViews)) {
+			std::exit(EXIT_FAILURE);
+		}
+	});
+	const auto window = startup.AddOnMainThread("Window", [&] {
+		// Init SDL
+		if (!SDL_Init(_options.headless ? 0 : SDL_INIT_VIDEO)) {
+			SDL_Log("SDL_Init failed: %s\n", SDL_GetError());
+			std::exit(EXIT_FAILURE);
+		}
+		// Create Window
+		if (!_options.headless) {
+			_window = SDL_CreateWindow("steorra", _options.width, _options.height, SDL_WINDOW_VULKAN);
+			if (!_window) {
+				SDL_Log("SDL_CreateWindow failed: %s\n", SDL_GetError());
+				std::exit(EXIT_FAILURE);
+			}
+		}
+	});
+	const auto instance = startup.Add("Instance", [&] {
+		// Vulkan Instance
+		vkb::InstanceBuilder builder;
+		auto instRet = builder.set_app_name("steorra")
+			.set_headless(_options.headless)
+			.request_validation_layers()
+			.use_default_debug_messenger()
+			.require_api_version(1, 3, 0)
+			.build();
+		if (!instRet) {
+			std::cerr << "vkb::PhysicalDeviceSelector failed: " << instRet.error().message() << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		_instance = instRet.value();
+	});
+	const auto surface = startup.AddOnMainThread("Surface", [&] {
+		// Create Surface
+		if (!_options.headless && !SDL_Vulkan_CreateSurface(_window, _instance, NULL, &_surface)) {
+			SDL_Log("SDL_Vulkan_CreateSurface failed: %s\n", SDL_GetError());
+			std::exit(EXIT_FAILURE);
+		}
+	}, { window, instance });
+	const auto device = startup.Add("Device", [&] {
+		// Select Device
+		vkb::PhysicalDeviceSelector selector{ _instance };
+		selector.set_minimum_version(1, 3)
+			.set_required_features_13(VkPhysicalDeviceVulkan13Features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+				.synchronization2 = true,
+				.dynamicRendering = true
+				})
+			.set_required_features_12(VkPhysicalDeviceVulkan12Features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+				.descriptorIndexing = true,
+				.descriptorBindingStorageImageUpdateAfterBind = true,
+				.descriptorBindingStorageBufferUpdateAfterBind = true,
+				.descriptorBindingUpdateUnusedWhilePending = true,
+				.descriptorBindingPartiallyBound = true,
+				.runtimeDescriptorArray = true,
+				.bufferDeviceAddress = true,
+				})
+			// shaders index the bindless buffer array with a push constant
+			.set_required_features(VkPhysicalDeviceFeatures{
+				.shaderStorageBufferArrayDynamicIndexing = true,
+				});
+		if (!_options.headless) {
+			selector.set_surface(_surface);
+		}
+		auto selectResult = selector.select();
+		if (!selectResult) {
+			std::cerr << "vkb::PhysicalDeviceSelector failed: " << selectResult.error().message() << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		vkb::PhysicalDevice selectedDevice = selectResult.value();
+		// real heap budgets from the driver rather than VMA's estimate
+		const bool memoryBudget = selectedDevice.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		// bright stars are drawn as larger points where the device can, otherwise every star is one pixel
+		_largePoints = selectedDevice.enable_features_if_present(VkPhysicalDeviceFeatures{ .largePoints = true });
+		// Build Device
+		auto deviceBuildResult = vkb::DeviceBuilder{ selectedDevice }.build();
+		if (!deviceBuildResult) {
+			std::cerr << "vkb::DeviceBuilder failed: " << selectResult.error().message() << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		_device = deviceBuildResult.value();
+		// Create Queue
+		_graphicsQueue = _device.get_queue(vkb::QueueType::graphics).value();
+		_graphicsQueueFamilyIndex = _device.get_queue_index(vkb::QueueType::graphics).value();
+
+		// Memory allocator
+		VmaAllocatorCreateInfo allocatorInfo = {
+			.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT | (memoryBudget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0u),
+			.physicalDevice = _device.physical_device,
+			.device = _device,
+			.instance = _instance,
+		};
+		vmaCreateAllocator(&allocatorInfo, &_allocator);
+		_retirer.Init(_device, _allocator);
+	}, { surface });
+	const VkSemaphoreCreateInfo semaphoreCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+	};
+	startup.Add("Swapchain", [&] {
+		// Create Swapchain
+		VkExtent3D drawImageExtent{ _options.width, _options.height, 1 };
+		if (!_options.headless) {
+			CreateSwapchain();
+			//draw image size will match the window
+			drawImageExtent = ToExtent3D(_swapchain.extent);
+		}
 
-Game::Game() : _keysDown{} {
-	// Init SDL
-	if (!SDL_Init(SDL_INIT_VIDEO)) {
-		SDL_Log("SDL_Init failed: %s\n", SDL_GetError());
-		std::exit(EXIT_FAILURE);
-	}
-	// Create Window
-	_window = SDL_CreateWindow("steorra", kScreenWidth, kScreenHeight, SDL_WINDOW_VULKAN);
-	if (!_window) {
-		SDL_Log("SDL_CreateWindow failed: %s\n", SDL_GetError());
-		std::exit(EXIT_FAILURE);
+		_drawImage.imageFormat = kDrawFormat;
+		_drawImage.imageExtent = drawImageExtent;
+
+		VkImageUsageFlags drawImageUsages{};
+		drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
+		drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+		VkImageCreateInfo rimgInfo = ImageCreateInfo(_drawImage.imageFormat, drawImageUsages, drawImageExtent);
+
+		//for the draw image, we want to allocate it from gpu local memory
+		VmaAllocationCreateInfo rimgAllocInfo = {};
+		rimgAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		rimgAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		//allocate and create the image
+		vmaCreateImage(_allocator, &rimgInfo, &rimgAllocInfo, &_drawImage.image, &_drawImage.allocation, nullptr);
+
+		//build a image-view for the draw image to use for rendering
+		VkImageViewCreateInfo drawImageViewCreateInfo = ImageViewCreateInfo(_drawImage.imageFormat, _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+		VK_CHECK_abort(vkCreateImageView(_device, &drawImageViewCreateInfo, nullptr, &_drawImage.imageView));
+
+		_retirer.Keep(_drawImage.image, _drawImage.allocation);
+		_retirer.Keep(_drawImage.imageView);
+		// Render graph, the depth buffer is a transient attachment it owns
+		_graph.Init(_device, _allocator);
+		_drawImageResource = _graph.RegisterImage(_drawImage.image, _drawImage.imageView, VK_IMAGE_ASPECT_COLOR_BIT);
+		// Headless output, the draw image is converted to 8 bit by a blit and copied into a ring of host visible buffers
+		if (_options.headless && !_options.outputPath.empty()) {
+			_frameWriter = std::make_unique<FrameWriter>(_options.outputPath, _options.outputFormat, drawImageExtent.width, drawImageExtent.height);
+			if (!_frameWriter->IsOpen()) {
+				std::cerr << "Could not open frame output: " << _options.outputPath << "\n";
+				std::exit(EXIT_FAILURE);
+			}
+			_readbackImage.imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+			_readbackImage.imageExtent = drawImageExtent;
+			VkImageCreateInfo readbackInfo = ImageCreateInfo(_readbackImage.imageFormat, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, drawImageExtent);
+			VK_CHECK_abort(vmaCreateImage(_allocator, &readbackInfo, &rimgAllocInfo, &_readbackImage.image, &_readbackImage.allocation, nullptr));
+			_readbackImage.imageView = VK_NULL_HANDLE;
+			_readbackImageResource = _graph.RegisterImage(_readbackImage.image, VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT);
+			for (auto& frame : _frames) {
+				frame.readbackBuffer = CreateBuffer(size_t(drawImageExtent.width) * drawImageExtent.height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+				frame.readbackResource = _graph.RegisterBuffer(frame.readbackBuffer.buffer);
+				frame.readbackFrame = -1;
+				_retirer.Keep(frame.readbackBuffer.buffer, frame.readbackBuffer.allocation);
+			}
+			_retirer.Keep(_readbackImage.image, _readbackImage.allocation);
+		}
+	}, { device });
+	const auto commands = startup.Add("Command buffers", [&] {
+		// Init command pools and buffers
+		VkCommandPoolCreateInfo commandPoolInfo = CommandPoolCreateInfo(_graphicsQueueFamilyIndex);
+		for (auto& frame : _frames) {
+			VK_CHECK_abort(vkCreateCommandPool(_device, &commandPoolInfo, nullptr, &frame.cmdPool));
+			const auto allocateInfo = CommandBufferAllocateInfo(frame.cmdPool);
+			VK_CHECK_abort(vkAllocateCommandBuffers(_device, &allocateInfo, &frame.cmdBuffer));
+			_retirer.Keep(frame.cmdPool);
+		}
+		// secondary command buffers for the geometry pass, each chunk has its own pool so any thread can record it
+		const uint32_t recordChunks = std::min(_jobs.GetThreadCount(), kTrailSteps);
+		for (auto& frame : _frames) {
+			frame.recordPools.resize(recordChunks);
+			frame.recordBuffers.resize(recordChunks);
+			for (uint32_t i = 0; i < recordChunks; i++) {
+				VK_CHECK_abort(vkCreateCommandPool(_device, &commandPoolInfo, nullptr, &frame.recordPools[i]));
+				const auto allocateInfo = CommandBufferAllocateInfo(frame.recordPools[i], VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+				VK_CHECK_abort(vkAllocateCommandBuffers(_device, &allocateInfo, &frame.recordBuffers[i]));
+				_retirer.Keep(frame.recordPools[i]);
+			}
+		}
+		_chunkPositions.resize(recordChunks);
+		VK_CHECK_abort(vkCreateCommandPool(_device, &commandPoolInfo, nullptr, &_immediateCommandPool));
+
+		// allocate the command buffer for immediate submits
+		const auto allocateInfo = CommandBufferAllocateInfo(_immediateCommandPool);
+		VK_CHECK_abort(vkAllocateCommandBuffers(_device, &allocateInfo, &_immediateCommandBuffer));
+
+		_retirer.Keep(_immediateCommandPool);
+		// Timestamp queries for the GPU zones and frame time
+		_gpuProfiler.Init(_device, _retirer, _profiler, FRAME_OVERLAP, _device.queue_families[_graphicsQueueFamilyIndex].timestampValidBits, _device.physical_device.properties.limits.timestampPeriod);
+		_timestampsSupported = _gpuProfiler.IsSupported();
+		// Create Sync structures
+		VkFenceCreateInfo fenceCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			.flags = VK_FENCE_CREATE_SIGNALED_BIT
+		};
+		for (auto& frame : _frames) {
+			VK_CHECK_abort(vkCreateFence(_device, &fenceCreateInfo, nullptr, &frame.renderFence));
+			VK_CHECK_abort(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &frame.swapchainSemaphore));
+			_retirer.Keep(frame.renderFence);
+			_retirer.Keep(frame.swapchainSemaphore);
+		}
+		VK_CHECK_abort(vkCreateFence(_device, &fenceCreateInfo, nullptr, &_immediateFence));
+		_retirer.Keep(_immediateFence);
+	}, { device });
+	const auto descriptors = startup.Add("Descriptors", [&] {
+		_bindless.Init(_device, _device.physical_device, 1 << 16, 1 << 12);
+	}, { device });
+	VkShaderModule triangleFragShader;
+	VkShaderModule triangleVertShader;
+	const auto shaders = startup.Add("Shaders", [&] {
+		if (!LoadShaderModule("colored_triangle.frag", _device, &triangleFragShader, &_assetPack)) {
+			std::cout << "Error when building the triangle fragment shader module \n";
+			std::exit(EXIT_FAILURE);
+		}
+		if (!LoadShaderModule("colored_triangle.vert", _device, &triangleVertShader, &_assetPack)) {
+			std::cout << "Error when building the triangle vertex shader module \n";
+			std::exit(EXIT_FAILURE);
+		}
+	}, { device });
+	startup.Add("Mesh pipeline", [&] {
+		//build the pipeline layout that controls the inputs/outputs of the shader
+		VkPushConstantRange vertexPushConstantRange{
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.offset = 0,
+			.size = sizeof(GPUScenePushConstants) + sizeof(GPUDrawPushConstants),
+		};
+
+		//the bindless table is the only descriptor set, draws index into it through push constants
+		VkDescriptorSetLayout bindlessLayout = _bindless.GetLayout();
+		VkPipelineLayoutCreateInfo meshLayoutInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &bindlessLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &vertexPushConstantRange,
+		};
+		VK_CHECK_abort(vkCreatePipelineLayout(_device, &meshLayoutInfo, nullptr, &_meshPipelineLayout));
+
+		PipelineBuilder pipelineBuilder;
+		pipelineBuilder._pipelineLayout = _meshPipelineLayout;
+		pipelineBuilder.SetShaders(triangleVertShader, triangleFragShader);
+		pipelineBuilder.SetColorAttachmentFormat(kDrawFormat);
+		pipelineBuilder.SetDepthFormat(kDepthFormat);
+		pipelineBuilder.SetDepthTest(true, true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+		// Leaving depth undefined
+		_meshPipeline = pipelineBuilder.BuildPipeline(_device);
+		vkDestroyShaderModule(_device, triangleFragShader, nullptr);
+		vkDestroyShaderModule(_device, triangleVertShader, nullptr);
+
+		_retirer.Keep(_meshPipelineLayout);
+		_retirer.Keep(_meshPipeline);
+	}, { shaders, descriptors });
+	// Star field, optional since the catalogue is generated rather than shipped
+	bool starsLoaded = false;
+	const auto starField = startup.Add("Star field", [&] {
+		starsLoaded = _stars.Init(_device, _allocator, _device.physical_device, _largePoints, _bindless, std::filesystem::current_path() / "assets" / "data" / "stars.bin", kDrawFormat, kDepthFormat, &_assetPack);
+	}, { descriptors });
+	// the only stage submitting to the queue
+	startup.Add("Uploads", [&] {
+		// Init Mesh Data
+		_geometry.Init(_device, _allocator, 1 << 18, 1 << 20);
+		if (!UploadMeshes(meshViews)) {
+			std::exit(EXIT_FAILURE);
+		}
+		if (starsLoaded) {
+			ImmediateSubmit([&](VkCommandBuffer cmd) {
+				_stars.RecordUpload(cmd);
+			});
+			_stars.FinishUpload();
+		}
+	}, { decodeMeshes, commands, starField });
+	startup.Run();
+	startup.Print(std::cout);
+
+	_mainDeletionQueue.PushFunction([&]() {
+		vmaDestroyAllocator(_allocator);
+	});
+	_mainDeletionQueue.PushFunction([&]() {
+		_graph.Destroy();
+	});
+	_mainDeletionQueue.PushFunction([&]() {
+		_bindless.Destroy(_device);
+	});
+	_mainDeletionQueue.PushFunction([&]() {
+		_geometry.Destroy();
+	});
+	_mainDeletionQueue.PushFunction([&]() {
+		_stars.Destroy(_bindless);
+	});
+	_graph.SetProfiler(&_gpuProfiler);
+
+	_allocationLog.SetSteadyStateFrame(_options.warmupFrames);
+	_solarTime = _options.startTime;
+	_mixedPrecision = _options.mixedPrecision;
+	_pacer.SetFrameCap(_options.frameCap);
+	if (_mixedPrecision) {
+		PrintMixedPrecisionBounds();
 	}
-	// Vulkan Instance
-	vkb::InstanceBuilder builder;
-	auto instRet = builder.set_app_name("steorra")
-		.request_validation_layers()
-		.use_default_debug_messenger()
-		.require_api_version(1, 3, 0)
-		.build();
-	if (!instRet) {
-		std::cerr << "vkb::PhysicalDeviceSelector failed: " << instRet.error().message() << "\n";
-		std::exit(EXIT_FAILURE);
+	InitPublisher();
+
+	if (!_options.headless) {
+		InitImgui();
+		SDL_SetWindowRelativeMouseMode(_window, true);
 	}
-	_instance = instRet.value();
-	// Create Surface
-	if (!SDL_Vulkan_CreateSurface(_window, _instance, NULL, &_surface)) {
-		SDL_Log("SDL_Vulkan_CreateSurface failed: %s\n", SDL_GetError());
-		std::exit(EXIT_FAILURE);
+}
+
+Game::~Game() {
+	_publisher.Close();
+	vkDeviceWaitIdle(_device);
+	_retirer.Flush();
+	_mainDeletionQueue.Flush();
+	DestroySwapchain();
+	vkb::destroy_device(_device);
+	if (!_options.headless) {
+		vkb::destroy_surface(_instance, _surface);
 	}
-	// Select Device
-	auto selectResult = vkb::PhysicalDeviceSelector{ _instance }.set_minimum_version(1, 3)
-		.set_required_features_13(VkPhysicalDeviceVulkan13Features{
-			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
-			.synchronization2 = true,
-			.dynamicRendering = true
-			})
-		.set_required_features_12(VkPhysicalDeviceVulkan12Features{
-			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
-			.descriptorIndexing = true,
-			.bufferDeviceAddress = true,
-			})
-			.set_surface(_surface)
-		.select();
-	if (!selectResult) {
-		std::cerr << "vkb::PhysicalDeviceSelector failed: " << selectResult.error().message() << "\n";
-		std::exit(EXIT_FAILURE);
+	vkb::destroy_instance(_instance);
+	if (_window) {
+		SDL_DestroyWindow(_window);
 	}
-	vkb::PhysicalDevice selectedDevice = selectResult.value();
-	// Build Device
-	auto deviceBuildResult = vkb::DeviceBuilder{ selectedDevice }.build();
-	if (!deviceBuildResult) {
-		std::cerr << "vkb::DeviceBuilder failed: " << selectResult.error().message() << "\n";
-		std::exit(EXIT_FAILURE);
+	SDL_Quit();
+}
+
+static VkPresentModeKHR ToVkPresentMode(PresentMode mode) {
+	switch (mode) {
+		case PresentMode::Mailbox:
+			return VK_PRESENT_MODE_MAILBOX_KHR;
+		case PresentMode::Immediate:
+			return VK_PRESENT_MODE_IMMEDIATE_KHR;
+		default:
+			return VK_PRESENT_MODE_FIFO_KHR;
 	}
-	_device = deviceBuildResult.value();
-	// MSAA
-	VkSampleCountFlags count = _device.physical_device.properties.limits.framebufferColorSampleCounts & _device.physical_device.properties.limits.framebufferDepthSampleCounts;
-	VkSampleCountFlagBits msaa = VK_SAMPLE_COUNT_1_BIT;
-	if (count & VK_SAMPLE_COUNT_64_BIT) {
-		msaa = VK_SAMPLE_COUNT_64_BIT;
-	} else if (count & VK_SAMPLE_COUNT_32_BIT) {
-		msaa = VK_SAMPLE_COUNT_32_BIT;
-	} else if (count & VK_SAMPLE_COUNT_16_BIT) {
-		msaa = VK_SAMPLE_COUNT_16_BIT;
-	} else if (count & VK_SAMPLE_COUNT_8_BIT) {
-		msaa = VK_SAMPLE_COUNT_8_BIT;
-	} else if (count & VK_SAMPLE_COUNT_4_BIT) {
-		msaa = VK_SAMPLE_COUNT_4_BIT;
-	} else if (count & VK_SAMPLE_COUNT_2_BIT) {
-		msaa = VK_SAMPLE_COUNT_2_BIT;
-	}
-
-	// Memory allocator
-	VmaAllocatorCreateInfo allocatorInfo = {
-		.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
-		.physicalDevice = _device.physical_device,
-		.device = _device,
-		.instance = _instance,
-	};
-	vmaCreateAllocator(&allocatorInfo, &_allocator);
-	_mainDeletionQueue.PushFunction([&]() {
-		vmaDestroyAllocator(_allocator);
-	});
-	// Create Swapchain
+}
+
+// builds a swapchain in the selected present mode, handing the current one over as the old swapchain
+void Game::CreateSwapchain() {
 	auto swapchainBuildResult = vkb::SwapchainBuilder{ _device }
 		//.use_default_format_selection()
 		.set_desired_format(VkSurfaceFormatKHR{ .format = VK_FORMAT_B8G8R8A8_UNORM, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR })
-		//use vsync present mode
-		.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-		.set_desired_extent(kScreenWidth, kScreenHeight)
+		// vk-bootstrap falls back to fifo, which every surface supports
+		.set_desired_present_mode(ToVkPresentMode(_presentMode))
+		.set_desired_extent(_options.width, _options.height)
 		.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+		.set_old_swapchain(_swapchain)
 		.build();
 	if (!swapchainBuildResult) {
 		std::cerr << "vkb::SwapchainBuilder failed: " << swapchainBuildResult.error().message() << "\n";
 		std::exit(EXIT_FAILURE);
 	}
+	DestroySwapchain();
 	_swapchain = swapchainBuildResult.value();
 	const auto& swapchainImages = _swapchain.get_images().value();
 	const auto& swapchainImageViews = _swapchain.get_image_views().value();
 	assert(swapchainImages.size() == swapchainImageViews.size());
-	for (int i = 0; i < swapchainImages.size(); i++) {
-		_swapchainImages.push_back({swapchainImages[i], swapchainImageViews[i]});
-	}
-	//draw image size will match the window
-	VkExtent3D drawImageExtent = ToExtent3D(_swapchain.extent);
-
-	//hardcoding the draw format to 16 bit float
-	_drawImage.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-	_drawImage.imageExtent = drawImageExtent;
-
-	VkImageUsageFlags drawImageUsages{};
-	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-	VkImageCreateInfo rimgInfo = ImageCreateInfo(_drawImage.imageFormat, drawImageUsages, drawImageExtent);
-
-	//for the draw image, we want to allocate it from gpu local memory
-	VmaAllocationCreateInfo rimgAllocInfo = {};
-	rimgAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	rimgAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	//allocate and create the image
-	vmaCreateImage(_allocator, &rimgInfo, &rimgAllocInfo, &_drawImage.image, &_drawImage.allocation, nullptr);
-
-	//build a image-view for the draw image to use for rendering
-	VkImageViewCreateInfo drawImageViewCreateInfo = ImageViewCreateInfo(_drawImage.imageFormat, _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
-	VK_CHECK_abort(vkCreateImageView(_device, &drawImageViewCreateInfo, nullptr, &_drawImage.imageView));
-
-	//Depth Image
-	_depthImage.imageFormat = VK_FORMAT_D32_SFLOAT;
-	_depthImage.imageExtent = drawImageExtent;
-	VkImageUsageFlags depthImageUsages{};
-	depthImageUsages |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-	VkImageCreateInfo dimgInfo = ImageCreateInfo(_depthImage.imageFormat, depthImageUsages, drawImageExtent);
-
-	//allocate and create the image
-	vmaCreateImage(_allocator, &dimgInfo, &rimgAllocInfo, &_depthImage.image, &_depthImage.allocation, nullptr);
-
-	//build a image-view for the draw image to use for rendering
-	VkImageViewCreateInfo dview_info = ImageViewCreateInfo(_depthImage.imageFormat, _depthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT);
-
-	VK_CHECK_abort(vkCreateImageView(_device, &dview_info, nullptr, &_depthImage.imageView));
-
-	//add to deletion queues
-	_mainDeletionQueue.PushFunction([=]() {
-		for (const auto& image : { _drawImage, _depthImage }) {
-			vkDestroyImageView(_device, image.imageView, nullptr);
-			vmaDestroyImage(_allocator, image.image, image.allocation);
-		}
-	});
-	// Create Queue
-	_graphicsQueue = _device.get_queue(vkb::QueueType::graphics).value();
-	_graphicsQueueFamilyIndex = _device.get_queue_index(vkb::QueueType::graphics).value();
-	// Init command pools and buffers
-	VkCommandPoolCreateInfo commandPoolInfo = CommandPoolCreateInfo(_graphicsQueueFamilyIndex);
-	for (auto& frame : _frames) {
-		VK_CHECK_abort(vkCreateCommandPool(_device, &commandPoolInfo, nullptr, &frame.cmdPool));
-		const auto allocateInfo = CommandBufferAllocateInfo(frame.cmdPool);
-		VK_CHECK_abort(vkAllocateCommandBuffers(_device, &allocateInfo, &frame.cmdBuffer));
-	}
-	VK_CHECK_abort(vkCreateCommandPool(_device, &commandPoolInfo, nullptr, &_immediateCommandPool));
-
-	// allocate the command buffer for immediate submits
-	const auto allocateInfo = CommandBufferAllocateInfo(_immediateCommandPool);
-	VK_CHECK_abort(vkAllocateCommandBuffers(_device, &allocateInfo, &_immediateCommandBuffer));
-
-	_mainDeletionQueue.PushFunction([=]() {
-		vkDestroyCommandPool(_device, _immediateCommandPool, nullptr);
-	});
-	// Create Sync structures
-	VkFenceCreateInfo fenceCreateInfo = {
-		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-		.flags = VK_FENCE_CREATE_SIGNALED_BIT
-	};
-	VkSemaphoreCreateInfo semaphoreCreateInfo = {
+	const VkSemaphoreCreateInfo semaphoreCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
 	};
-	for (auto& frame : _frames) {
-		VK_CHECK_abort(vkCreateFence(_device, &fenceCreateInfo, nullptr, &frame.renderFence));
-		VK_CHECK_abort(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &frame.swapchainSemaphore));
-	}
-	for (auto& image : _swapchainImages) {
-		VK_CHECK_abort(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &image.renderSemaphore));
-	}
-	VK_CHECK_abort(vkCreateFence(_device, &fenceCreateInfo, nullptr, &_immediateFence));
-	_mainDeletionQueue.PushFunction([=]() { vkDestroyFence(_device, _immediateFence, nullptr); });
-
-	// Triangle Pipeline
-	VkShaderModule triangleFragShader;
-	if (!LoadShaderModule("colored_triangle.frag", _device, &triangleFragShader)) {
-		std::cout << "Error when building the triangle fragment shader module \n";
-		std::exit(EXIT_FAILURE);
-	}
-
-	VkShaderModule triangleVertShader;
-	if (!LoadShaderModule("colored_triangle.vert", _device, &triangleVertShader)) {
-		std::cout << "Error when building the triangle vertex shader module \n";
-		std::exit(EXIT_FAILURE);
+	for (int i = 0; i < swapchainImages.size(); i++) {
+		_swapchainImages.push_back({swapchainImages[i], swapchainImageViews[i]});
+		VK_CHECK_abort(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_swapchainImages.back().renderSemaphore));
 	}
-
-	//build the pipeline layout that controls the inputs/outputs of the shader
-	VkPushConstantRange vertexPushConstantRange{
-		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-		.offset = 0,
-		.size = sizeof(GPUDrawPushConstants),
-	};
-	 
-	
-	//we are not using descriptor sets or other systems yet, so no need to use anything other than empty default
-	VkPipelineLayoutCreateInfo meshLayoutInfo{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.pushConstantRangeCount = 1,
-		.pPushConstantRanges = &vertexPushConstantRange,
-	};
-	VK_CHECK_abort(vkCreatePipelineLayout(_device, &meshLayoutInfo, nullptr, &_meshPipelineLayout));
-
-	PipelineBuilder pipelineBuilder;
-	pipelineBuilder._pipelineLayout = _meshPipelineLayout;
-	pipelineBuilder.SetShaders(triangleVertShader, triangleFragShader);
-	pipelineBuilder.SetColorAttachmentFormat(_drawImage.imageFormat);
-	pipelineBuilder.SetDepthFormat(_depthImage.imageFormat);
-	pipelineBuilder.SetDepthTest(true, true, VK_COMPARE_OP_GREATER_OR_EQUAL);
-
-	// Leaving depth undefined
-	_meshPipeline = pipelineBuilder.BuildPipeline(_device);
-	vkDestroyShaderModule(_device, triangleFragShader, nullptr);
-	vkDestroyShaderModule(_device, triangleVertShader, nullptr);
-
-	_mainDeletionQueue.PushFunction([&]() {
-		vkDestroyPipelineLayout(_device, _meshPipelineLayout, nullptr);
-		vkDestroyPipeline(_device, _meshPipeline, nullptr);
-	});
-	
-	// Init Mesh Data
-	if (!LoadMeshes("basic_shapes.glb")) {
-		std::exit(EXIT_FAILURE);
+	if (_swapchain.present_mode != ToVkPresentMode(_presentMode)) {
+		std::cout << "Present mode " << GetPresentModeName(_presentMode) << " is not supported, using fifo" << std::endl;
+		_presentMode = PresentMode::Fifo;
 	}
-
-	InitImgui();
-
-	_solarTime = 2461044.5;//A.D. 2026-Jan-04 00:00:00.0000 TBD
-
-	SDL_SetWindowRelativeMouseMode(_window, true);
 }
 
-Game::~Game() {
+void Game::RecreateSwapchain() {
+	// the last frames may still be presenting from the old images and waiting on their semaphores
 	vkDeviceWaitIdle(_device);
-	for (auto& frame : _frames) {
-		vkDestroyCommandPool(_device, frame.cmdPool, nullptr);
-		vkDestroyFence(_device, frame.renderFence, nullptr);
-		vkDestroySemaphore(_device, frame.swapchainSemaphore, nullptr);
-		frame.deletionQueue.Flush();
-	}
-	for (auto& [name, mesh] : _meshes) {
-		DestroyBuffer(mesh.meshBuffers.indexBuffer);
-		DestroyBuffer(mesh.meshBuffers.vertexBuffer);
-	}
-	_mainDeletionQueue.Flush();
+	CreateSwapchain();
+	_swapchainDirty = false;
+	std::cout << "Present mode " << GetPresentModeName(_presentMode) << " with " << _swapchainImages.size() << " images" << std::endl;
+}
+
+void Game::DestroySwapchain() {
 	for (const auto& image : _swapchainImages) {
 		vkDestroySemaphore(_device, image.renderSemaphore, nullptr);
 		vkDestroyImageView(_device, image.imageView, nullptr);
 	}
-	vkb::destroy_swapchain(_swapchain);
-	vkb::destroy_device(_device);
-	vkb::destroy_surface(_instance, _surface);
-	vkb::destroy_instance(_instance);
-	SDL_DestroyWindow(_window);
-	SDL_Quit();
+	_swapchainImages.clear();
+	if (_swapchain.swapchain != VK_NULL_HANDLE) {
+		vkb::destroy_swapchain(_swapchain);
+		_swapchain = {};
+	}
 }
 
 void Game::Run() {
-	Uint64 lastTime{ 0 };
+	if (_options.headless) {
+		RunHeadless();
+		return;
+	}
+	std::unique_ptr<ReplayRecorder> recorder;
+	std::unique_ptr<ReplayReader> reader;
+	if (!_options.replayPath.empty()) {
+		reader = std::make_unique<ReplayReader>(_options.replayPath);
+		if (!reader->IsOpen()) {
+			std::cerr << "Could not open replay: " << _options.replayPath << "\n";
+			return;
+		}
+	} else if (!_options.recordPath.empty()) {
+		recorder = std::make_unique<ReplayRecorder>(_options.recordPath);
+		if (!recorder->IsOpen()) {
+			std::cerr << "Could not open recording: " << _options.recordPath << "\n";
+			return;
+		}
+	}
+	Uint64 lastTime{ SDL_GetTicks() };
 	Uint64 currentTime{ 0 };
+	Uint64 replayStart{ SDL_GetTicksNS() };
+	double replayElapsed{ 0.0 };
+	ReplayFrame input{};
 	while (true) {
+		Uint64 frameStart = SDL_GetTicksNS();
+		const uint64_t frameNumber = _frameNumber;
+		_allocationLog.BeginFrame();
+		_profiler.BeginFrame(frameNumber);
+		{
+			ProfileScope zone(_profiler, "Pace");
+			_pacer.WaitForNextFrame();
+		}
+		if (_lowLatency) {
+			// the frame slot and swapchain image first, so the input is sampled as close to the submit as it can be
+			BeginFrame();
+		}
+		_pacer.MarkInputSampled();
+		input.events.clear();
+		bool quit = false;
 		SDL_Event e{};
+		std::optional<ProfileScope> eventsZone(std::in_place, _profiler, "Events");
 		while (SDL_PollEvent(&e) == true) {
 			if (e.type == SDL_EVENT_QUIT) {
-				return;
+				quit = true;
+			}
+			// live input is ignored while replaying, only closing the window is honoured
+			if (reader) {
+				continue;
+			}
+			if (e.type == SDL_EVENT_QUIT) {
+				input.events.push_back({ .type = ReplayEventType::Quit });
 			}
 			else if (e.type == SDL_EVENT_MOUSE_MOTION) {
-				_spectator.Turn(glm::dvec2{ e.motion.xrel, e.motion.yrel } * 0.002);
+				input.events.push_back({ .type = ReplayEventType::MouseMotion, .x = e.motion.xrel, .y = e.motion.yrel });
 			}
 			else if (e.type == SDL_EVENT_KEY_DOWN) {
-				_keysDown.at(e.key.scancode) = true;
-				switch (e.key.scancode) {
-					case SDL_SCANCODE_UP:
-						_foldIndex = glm::clamp(_foldIndex + 1, 0, _maxFoldIndex);
-						std::cout << "Fold to " << _foldIndex << std::endl;
-						break;
-					case SDL_SCANCODE_DOWN:
-						_foldIndex = glm::clamp(_foldIndex - 1, 0, _maxFoldIndex);
-						std::cout << "Fold to " << _foldIndex << std::endl;
-						break;
-				}
+				input.events.push_back({ .type = ReplayEventType::KeyDown, .scancode = (uint16_t)e.key.scancode });
 			}
 			else if (e.type == SDL_EVENT_KEY_UP) {
-				_keysDown.at(e.key.scancode) = false;
+				input.events.push_back({ .type = ReplayEventType::KeyUp, .scancode = (uint16_t)e.key.scancode });
 			}
 			ImGui_ImplSDL3_ProcessEvent(&e);
 		}
+		eventsZone.reset();
+		if (reader) {
+			if (quit || !reader->Read(input)) {
+				break;
+			}
+			// at recorded pace, wait until the capture's clock catches up
+			replayElapsed += input.dt;
+			if (!_options.replayFast) {
+				Uint64 target = replayStart + Uint64(replayElapsed * 1e9);
+				Uint64 now = SDL_GetTicksNS();
+				if (target > now) {
+					SDL_DelayNS(target - now);
+				}
+			}
+		} else {
+			currentTime = SDL_GetTicks();
+			input.dt = (currentTime - lastTime) / 1000.0;
+			lastTime = currentTime;
+		}
+		if (!ApplyInput(input) || quit) {
+			if (recorder) {
+				input.solarTime = _solarTime;
+				input.foldIndex = _foldIndex;
+				recorder->Write(input);
+			}
+			break;
+		}
 		// imgui new frame
+		std::optional<ProfileScope> imguiZone(std::in_place, _profiler, "Imgui");
+		std::optional<AllocationScope> imguiAllocations(std::in_place, AllocationTag::Imgui);
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplSDL3_NewFrame();
 		ImGui::NewFrame();
 
-		//some imgui UI to test
-		ImGui::ShowDemoWindow();
+		if (_showProfiler) {
+			_profiler.DrawOverlay(&_showProfiler);
+		}
+		if (_showMemory) {
+			DrawMemoryOverlay();
+		}
 
 		//make imgui calculate internal draw structures
 		ImGui::Render();
-		currentTime = SDL_GetTicks();
+		imguiAllocations.reset();
+		imguiZone.reset();
 		// Updates
-		double dt = (currentTime - lastTime) / 1000.0;
-		_solarTime += dt / 86400.0; //Number of seconds in a day (the simulation takes in the number of days)
+		std::optional<ProfileScope> simulationZone(std::in_place, _profiler, "Simulation");
+		double dt = input.dt;
+		if (reader) {
+			// the recorded values are authoritative so accumulated rounding cannot drift
+			_solarTime = input.solarTime;
+			_foldIndex = input.foldIndex;
+		} else {
+			_solarTime += dt / 86400.0; //Number of seconds in a day (the simulation takes in the number of days)
+			input.solarTime = _solarTime;
+			input.foldIndex = _foldIndex;
+		}
 		_spectator.Move(glm::dvec3{
 			_keysDown.at(SDL_SCANCODE_W) - _keysDown.at(SDL_SCANCODE_S),
 			_keysDown.at(SDL_SCANCODE_D) - _keysDown.at(SDL_SCANCODE_A),
 			_keysDown.at(SDL_SCANCODE_SPACE) - _keysDown.at(SDL_SCANCODE_LCTRL),
 		} * dt * 5000.0 * GetFoldScale());
+		simulationZone.reset();
 		Draw(dt);
-		lastTime = currentTime;
+		PublishState();
+		if (recorder) {
+			recorder->Write(input);
+		}
+		RecordTimings((SDL_GetTicksNS() - frameStart) / 1e6);
+		_profiler.EndFrame();
+		_allocationLog.EndFrame(frameNumber);
+	}
+	AbandonFrame();
+	if (recorder) {
+		std::cout << "Recorded " << recorder->GetFrameCount() << " frames to " << _options.recordPath << std::endl;
 	}
+	if (reader) {
+		double seconds = (SDL_GetTicksNS() - replayStart) / 1e9;
+		std::cout << "Replayed " << reader->GetFrameCount() << " frames in " << seconds << " s (recorded " << replayElapsed << " s)" << std::endl;
+	}
+	SaveTimings();
+	SaveTrace();
+	SaveMemoryReport();
 }
 
-void Game::Draw(double dt) {
+int Game::GetExitCode() const {
+	return _exitCode;
+}
+
+bool Game::ApplyInput(const ReplayFrame& input) {
+	for (const ReplayEvent& event : input.events) {
+		switch (event.type) {
+			case ReplayEventType::Quit:
+				return false;
+			case ReplayEventType::MouseMotion:
+				// the pointer belongs to the profiler overlay while it is open
+				if (!_showProfiler) {
+					_spectator.Turn(glm::dvec2{ event.x, event.y } * 0.002);
+				}
+				break;
+			case ReplayEventType::KeyUp:
+				_keysDown.at(event.scancode) = false;
+				break;
+			case ReplayEventType::KeyDown:
+				_keysDown.at(event.scancode) = true;
+				switch (event.scancode) {
+					case SDL_SCANCODE_UP:
+						_foldIndex = glm::clamp(_foldIndex + 1, 0, _maxFoldIndex);
+						std::cout << "Fold to " << _foldIndex << std::endl;
+						break;
+					case SDL_SCANCODE_DOWN:
+						_foldIndex = glm::clamp(_foldIndex - 1, 0, _maxFoldIndex);
+						std::cout << "Fold to " << _foldIndex << std::endl;
+						break;
+					case SDL_SCANCODE_F2:
+						if (!_timestampsSupported) {
+							std::cout << "Dynamic resolution needs timestamp queries, which this device does not support" << std::endl;
+							break;
+						}
+						_dynamicResolution.SetEnabled(!_dynamicResolution.IsEnabled());
+						std::cout << "Dynamic resolution " << (_dynamicResolution.IsEnabled() ? "on" : "off") << std::endl;
+						break;
+					case SDL_SCANCODE_F3:
+						_showProfiler = !_showProfiler;
+						// the pointer is needed to hover and click the overlay
+						if (_window) {
+							SDL_SetWindowRelativeMouseMode(_window, !_showProfiler);
+						}
+						break;
+					case SDL_SCANCODE_F4:
+						_showMemory = !_showMemory;
+						break;
+					case SDL_SCANCODE_F6:
+						_mixedPrecision = !_mixedPrecision;
+						std::cout << "Mixed precision " << (_mixedPrecision ? "on" : "off") << std::endl;
+						if (_mixedPrecision) {
+							PrintMixedPrecisionBounds();
+						}
+						break;
+					case SDL_SCANCODE_F7:
+						_presentMode = PresentMode((uint32_t(_presentMode) + 1) % kPresentModeCount);
+						_swapchainDirty = true;
+						break;
+					case SDL_SCANCODE_F8:
+						DefragmentGeometry();
+						break;
+					case SDL_SCANCODE_F9:
+						_lowLatency = !_lowLatency;
+						std::cout << "Low latency " << (_lowLatency ? "on" : "off") << std::endl;
+						break;
+					case SDL_SCANCODE_PAGEUP:
+						_starMagnitudeLimit = glm::min(_starMagnitudeLimit + 0.5f, 21.0f);
+						std::cout << "Star magnitude limit " << _starMagnitudeLimit << " (" << _stars.GetDrawCount(_starMagnitudeLimit) << " drawn)" << std::endl;
+						break;
+					case SDL_SCANCODE_PAGEDOWN:
+						_starMagnitudeLimit = glm::max(_starMagnitudeLimit - 0.5f, -2.0f);
+						std::cout << "Star magnitude limit " << _starMagnitudeLimit << " (" << _stars.GetDrawCount(_starMagnitudeLimit) << " drawn)" << std::endl;
+						break;
+				}
+				break;
+		}
+	}
+	return true;
+}
+
+void Game::RecordTimings(double cpuMs) {
+	// Draw has already advanced the frame number, and the GPU time read in it belongs to the frame that last used the slot
+	const uint64_t frame = _frameNumber - 1;
+	_timings.RecordCpu(frame, cpuMs);
+	if (_timestampsSupported && frame >= FRAME_OVERLAP) {
+		_timings.RecordGpu(frame - FRAME_OVERLAP, _lastGpuFrameMs);
+	}
+}
+
+void Game::SaveTimings() {
+	_timings.PrintSummary();
+	if (_options.timingsPath.empty()) {
+		return;
+	}
+	if (_timings.Save(_options.timingsPath)) {
+		std::cout << "Frame timings written to " << _options.timingsPath << std::endl;
+	} else {
+		std::cerr << "Could not write frame timings: " << _options.timingsPath << "\n";
+	}
+}
+
+void Game::SaveTrace() {
+	if (_options.tracePath.empty()) {
+		return;
+	}
+	if (_profiler.SaveChromeTrace(_options.tracePath)) {
+		std::cout << "Trace of the last " << Profiler::kHistory << " frames written to " << _options.tracePath << std::endl;
+	} else {
+		std::cerr << "Could not write trace: " << _options.tracePath << "\n";
+	}
+}
+
+void Game::DrawMemoryOverlay() {
+	if (!ImGui::Begin("Memory", &_showMemory)) {
+		ImGui::End();
+		return;
+	}
+	if (ImGui::CollapsingHeader("Heap", ImGuiTreeNodeFlags_DefaultOpen)) {
+		_allocationLog.DrawImgui();
+	}
+	if (ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+		_gpuMemory.Collect(_allocator);
+		_gpuMemory.DrawImgui();
+	}
+	ImGui::End();
+}
+
+void Game::SaveMemoryReport() {
+	if (_options.assertZeroAlloc) {
+		if (_allocationLog.GetSteadyStateAllocations() > 0) {
+			std::cerr << _allocationLog.GetSteadyStateAllocations() << " heap allocations after the first " << _options.warmupFrames << " frames\n";
+			_exitCode = EXIT_FAILURE;
+		} else {
+			std::cout << "No heap allocations after the first " << _options.warmupFrames << " frames" << std::endl;
+		}
+	}
+	if (_options.memoryReportPath.empty()) {
+		return;
+	}
+	_gpuMemory.Collect(_allocator);
+	std::ofstream stream(_options.memoryReportPath, std::ios::trunc);
+	stream << "{\"heap\":";
+	_allocationLog.WriteJson(stream);
+	stream << ",\"gpu\":";
+	_gpuMemory.WriteJson(stream);
+	stream << "}\n";
+	if (stream) {
+		std::cout << "Memory report written to " << _options.memoryReportPath << std::endl;
+	} else {
+		std::cerr << "Could not write memory report: " << _options.memoryReportPath << "\n";
+	}
+}
+
+void Game::InitPublisher() {
+	if (_options.publishName.empty()) {
+		return;
+	}
+	const auto& bodies = _solarSystem->bodies;
+	std::unordered_map<const SolarBody*, int32_t> indices;
+	for (size_t i = 0; i < bodies.size(); i++) {
+		indices[bodies[i].get()] = (int32_t)i;
+	}
+	_publishParents.resize(bodies.size());
+	std::vector<SharedBodyInfo> infos(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++) {
+		const SolarBody* parent = bodies[i]->GetParent();
+		_publishParents[i] = parent ? indices.at(parent) : -1;
+		infos[i] = { bodies[i]->GetName(), _publishParents[i], bodies[i]->GetRadius() };
+	}
+	if (!_publisher.Open(_options.publishName, infos)) {
+		std::cerr << "Could not create shared memory segment: " << _options.publishName << " (is another steorra publishing to it?)\n";
+		return;
+	}
+	std::cout << "Publishing " << bodies.size() << " bodies to shared memory " << _options.publishName << std::endl;
+}
+
+void Game::PublishState() {
+	if (!_publisher.IsOpen()) {
+		return;
+	}
+	ProfileScope zone(_profiler, "Publish");
+	AllocationScope allocationScope(AllocationTag::Publish);
+	// relative positions are summed down the hierarchy so each parent is evaluated once
+	_solarSystem->GetRelativePositions(_solarTime, _relativePositions, _mixedPrecision, &_jobs);
+	_publisher.Publish(_frameNumber, _solarTime, [&](double* x, double* y, double* z) {
+		for (size_t i = 0; i < _relativePositions.size(); i++) {
+			glm::dvec3 position = _relativePositions[i];
+			if (_publishParents[i] >= 0) {
+				position += glm::dvec3(x[_publishParents[i]], y[_publishParents[i]], z[_publishParents[i]]);
+			}
+			x[i] = position.x;
+			y[i] = position.y;
+			z[i] = position.z;
+		}
+	});
+}
+
+void Game::PrintMixedPrecisionBounds() const {
+	const SatelliteBatch& batch = _solarSystem->GetSatelliteBatch();
+	std::vector<size_t> order(batch.GetCount());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return batch.GetErrorBound(a) > batch.GetErrorBound(b); });
+	std::cout << batch.GetCount() << " of " << _solarSystem->bodies.size() << " bodies in float, largest error bounds:" << std::endl;
+	for (size_t i = 0; i < std::min<size_t>(order.size(), 5); i++) {
+		std::cout << "  " << _solarSystem->bodies[batch.GetBodyIndex(order[i])]->GetName() << " " << batch.GetErrorBound(order[i]) << " m" << std::endl;
+	}
+}
+
+void Game::RunHeadless() {
+	// fixed simulation step per frame so runs are repeatable
+	const double dt = _options.timeStep * 86400.0;
+	double gpuTotalMs = 0.0;
+	Uint64 startTime = SDL_GetTicksNS();
+	_timings.Reserve(_options.frameCount);
+	for (uint64_t i = 0; i < _options.frameCount; i++) {
+		Uint64 frameStart = SDL_GetTicksNS();
+		const uint64_t frameNumber = _frameNumber;
+		_allocationLog.BeginFrame();
+		_profiler.BeginFrame(frameNumber);
+		Draw(dt);
+		PublishState();
+		gpuTotalMs += _lastGpuFrameMs;
+		_solarTime += _options.timeStep;
+		RecordTimings((SDL_GetTicksNS() - frameStart) / 1e6);
+		_profiler.EndFrame();
+		_allocationLog.EndFrame(frameNumber);
+	}
+	vkDeviceWaitIdle(_device);
+	// write whatever is still in the readback ring, oldest first
+	std::array<FrameData*, FRAME_OVERLAP> pending;
+	for (unsigned i = 0; i < FRAME_OVERLAP; i++) {
+		pending[i] = &_frames[i];
+	}
+	std::sort(pending.begin(), pending.end(), [](FrameData* a, FrameData* b) { return a->readbackFrame < b->readbackFrame; });
+	for (FrameData* frame : pending) {
+		WriteReadback(*frame);
+	}
+	double seconds = (SDL_GetTicksNS() - startTime) / 1e9;
+	std::cout << "Rendered " << _options.frameCount << " frames at " << _drawImage.imageExtent.width << "x" << _drawImage.imageExtent.height
+		<< " in " << seconds << " s (" << _options.frameCount / seconds << " fps, " << seconds * 1000.0 / _options.frameCount << " ms/frame";
+	if (_timestampsSupported && _options.frameCount > FRAME_OVERLAP) {
+		// the last frames' GPU times are never read back
+		std::cout << ", " << gpuTotalMs / (_options.frameCount - FRAME_OVERLAP) << " GPU ms/frame";
+	}
+	std::cout << ")" << std::endl;
+	SaveTimings();
+	SaveTrace();
+	SaveMemoryReport();
+}
+
+void Game::WriteReadback(FrameData& frame) {
+	if (!_frameWriter || frame.readbackFrame < 0) {
+		return;
+	}
+	vmaInvalidateAllocation(_allocator, frame.readbackBuffer.allocation, 0, VK_WHOLE_SIZE);
+	if (!_frameWriter->Write((const uint8_t*)frame.readbackBuffer.info.pMappedData, frame.readbackFrame)) {
+		std::cerr << "Failed to write frame " << frame.readbackFrame << "\n";
+	}
+	frame.readbackFrame = -1;
+}
+
+// Waits until this frame's slot is free and acquires its swapchain image. The low latency loop calls it before
+// sampling input, so the wait is not part of the latency, otherwise Draw does.
+void Game::BeginFrame() {
+	if (_frameBegun) {
+		return;
+	}
+	_frameBegun = true;
 	// Wait for previous frame to finish rendering
 	uint64_t ONE_SECOND = 1'000'000'000;
 	auto& frame = GetCurrentFrame();
 
-	VK_CHECK_abort(vkWaitForFences(_device, 1, &frame.renderFence, true, ONE_SECOND));
-	frame.deletionQueue.Flush();
+	{
+		ProfileScope zone(_profiler, "Wait");
+		VK_CHECK_abort(vkWaitForFences(_device, 1, &frame.renderFence, true, ONE_SECOND));
+	}
+	// the fence covers every frame up to the one that last used this slot
+	if (_frameNumber >= FRAME_OVERLAP) {
+		_retirer.Collect(_frameNumber - FRAME_OVERLAP);
+	}
 	VK_CHECK_abort(vkResetFences(_device, 1, &frame.renderFence));
 
-	uint32_t swapchainImageIndex;
-	VK_CHECK_abort(vkAcquireNextImageKHR(_device, _swapchain, ONE_SECOND, frame.swapchainSemaphore, nullptr, &swapchainImageIndex));
-	auto& image = _swapchainImages[swapchainImageIndex];
+	// this frame slot's timestamps are from FRAME_OVERLAP frames ago and are ready now that its fence has signalled
+	_lastGpuFrameMs = _gpuProfiler.Resolve(_frameNumber % FRAME_OVERLAP);
+	// only the pass drawn at the render extent, the frame zone also holds the wait for the swapchain image
+	_dynamicResolution.Update(_gpuProfiler.GetZoneMs("Geometry"));
+	_drawExtent = _dynamicResolution.GetRenderExtent(ToExtent2D(_drawImage.imageExtent));
+	// likewise the readback this slot recorded is complete
+	if (_options.headless) {
+		WriteReadback(frame);
+		return;
+	}
+
+	ProfileScope zone(_profiler, "Acquire");
+	if (_swapchainDirty) {
+		RecreateSwapchain();
+	}
+	while (true) {
+		VkResult result = vkAcquireNextImageKHR(_device, _swapchain, ONE_SECOND, frame.swapchainSemaphore, nullptr, &_swapchainImageIndex);
+		// out of date signals nothing, so the semaphore can be used again with the new swapchain
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			RecreateSwapchain();
+			continue;
+		}
+		if (result == VK_SUBOPTIMAL_KHR) {
+			_swapchainDirty = true;
+		} else {
+			VK_CHECK_abort(result);
+		}
+		break;
+	}
+}
+
+// Leaving after BeginFrame but before Draw, as when low latency mode samples a quit, still owes the frame's submit.
+// An empty one waits out the acquire semaphore's pending signal and signals the fence BeginFrame reset, so teardown
+// finds both idle. The acquired image goes unpresented, which destroying the swapchain allows.
+void Game::AbandonFrame() {
+	if (!_frameBegun) {
+		return;
+	}
+	auto& frame = GetCurrentFrame();
+	VkSemaphoreSubmitInfo waitInfo = SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.swapchainSemaphore);
+	VkSubmitInfo2 submit = SubmitInfo(nullptr, nullptr, _options.headless ? nullptr : &waitInfo);
+	submit.commandBufferInfoCount = 0;
+	VK_CHECK_abort(vkQueueSubmit2(_graphicsQueue, 1, &submit, frame.renderFence));
+	_frameBegun = false;
+}
+
+void Game::Draw(double dt) {
+	BeginFrame();
+	auto& frame = GetCurrentFrame();
+	const uint32_t swapchainImageIndex = _swapchainImageIndex;
 	VkCommandBuffer cmd = frame.cmdBuffer;
+	std::optional<ProfileScope> recordZone(std::in_place, _profiler, "Record");
 	VK_CHECK_abort(vkResetCommandBuffer(cmd, 0));
 	VkCommandBufferBeginInfo cmdBufferBeginInfo = CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	VK_CHECK_abort(vkBeginCommandBuffer(cmd, &cmdBufferBeginInfo));
+	_gpuProfiler.BeginFrame(cmd, _frameNumber % FRAME_OVERLAP, _frameNumber);
+
+	_graph.Begin();
+	RenderGraphResource depthImage = _graph.CreateTransientImage({
+		.format = kDepthFormat,
+		.extent = _drawImage.imageExtent,
+		.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		.aspect = VK_IMAGE_ASPECT_DEPTH_BIT,
+	});
 
-	TransitionImage(cmd, _drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-	TransitionImage(cmd, _depthImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
-
-	DrawGeometry(cmd, dt);
-
-	//transition the draw image and the swapchain image into their correct transfer layouts
-	TransitionImage(cmd, _drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-	TransitionImage(cmd, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-	// execute a copy from the draw image into the swapchain
-	CopyImageToImage(cmd, _drawImage.image, image.image, ToExtent2D(_drawImage.imageExtent), _swapchain.extent);
+	_graph.AddPass("Geometry", {
+		{ _drawImageResource, ResourceUsage::ColorAttachmentWrite, true },
+		{ depthImage, ResourceUsage::DepthAttachmentWrite },
+	}, [&](VkCommandBuffer cmd) {
+		DrawGeometry(cmd, _graph.GetImageView(depthImage), dt);
+	});
 
-	// set swapchain image layout to Attachment Optimal so we can draw it
-	TransitionImage(cmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	if (_options.headless) {
+		DrawReadbackPasses(frame);
+	} else {
+		DrawPresentPasses(swapchainImageIndex);
+	}
 
-	//draw imgui into the swapchain image
-	DrawImgui(cmd, image.imageView);
+	_graph.Execute(cmd);
 
-	// set swapchain image layout to Present so we can draw it
-	TransitionImage(cmd, image.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	_gpuProfiler.EndFrame(cmd);
 
 	//finalize the command buffer (we can no longer add commands, but it can now be executed)
 	VK_CHECK_abort(vkEndCommandBuffer(cmd));
+	recordZone.reset();
+	if (_frameNumber == 0) {
+		const std::chrono::duration<double, std::milli> startup = std::chrono::steady_clock::now() - _startTime;
+		std::cout << "First frame after " << startup.count() << " ms" << std::endl;
+	}
 
 	VkCommandBufferSubmitInfo cmdinfo = CommandBufferSubmitInfo(cmd);
 
-	VkSemaphoreSubmitInfo waitInfo = SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, frame.swapchainSemaphore);
+	//submit command buffer to the queue and execute it.
+	// renderFence will now block until the graphic commands finish execution
+	if (_options.headless) {
+		VkSubmitInfo2 submit = SubmitInfo(&cmdinfo, nullptr, nullptr);
+		ProfileScope zone(_profiler, "Submit");
+		_profiler.MarkSubmit();
+		VK_CHECK_abort(vkQueueSubmit2(_graphicsQueue, 1, &submit, frame.renderFence));
+		_frameBegun = false;
+		_frameNumber++;
+		return;
+	}
+
+	auto& image = _swapchainImages[swapchainImageIndex];
+	VkSemaphoreSubmitInfo waitInfo = SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_TRANSFER_BIT, frame.swapchainSemaphore);
 	VkSemaphoreSubmitInfo signalInfo = SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, image.renderSemaphore);
 
 	VkSubmitInfo2 submit = SubmitInfo(&cmdinfo, &signalInfo, &waitInfo);
-
-	//submit command buffer to the queue and execute it.
-	// renderFence will now block until the graphic commands finish execution
-	VK_CHECK_abort(vkQueueSubmit2(_graphicsQueue, 1, &submit, frame.renderFence));
+	{
+		ProfileScope zone(_profiler, "Submit");
+		_profiler.MarkSubmit();
+		_timings.RecordLatency(_frameNumber, _pacer.MarkSubmitted());
+		VK_CHECK_abort(vkQueueSubmit2(_graphicsQueue, 1, &submit, frame.renderFence));
+	}
 
 	VkPresentInfoKHR presentInfo = {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -413,43 +1001,111 @@ void Game::Draw(double dt) {
 		.pSwapchains = &_swapchain.swapchain,
 		.pImageIndices = &swapchainImageIndex,
 	};
-	VK_CHECK_abort(vkQueuePresentKHR(_graphicsQueue, &presentInfo));
+	{
+		ProfileScope zone(_profiler, "Present");
+		VkResult result = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+			_swapchainDirty = true;
+		} else {
+			VK_CHECK_abort(result);
+		}
+	}
+
+	_frameBegun = false;
+	_frameNumber++;
+}
+
+void Game::DrawPresentPasses(uint32_t swapchainImageIndex) {
+	auto& image = _swapchainImages[swapchainImageIndex];
+	// the acquire semaphore is waited on at the transfer stage of the blit, the first pass to touch the image, so the
+	// geometry pass never waits for the presentation engine
+	RenderGraphResource swapchainImage = _graph.ImportImage(image.image, image.imageView, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_TRANSFER_BIT);
+
+	// execute a copy from the draw image into the swapchain
+	_graph.AddPass("Blit", {
+		{ _drawImageResource, ResourceUsage::TransferSrc },
+		{ swapchainImage, ResourceUsage::TransferDst, true },
+	}, [&](VkCommandBuffer cmd) {
+		// stretches the rendered region over the whole swapchain image, which is the upscale for dynamic resolution
+		CopyImageToImage(cmd, _drawImage.image, image.image, _drawExtent, _swapchain.extent);
+	});
+
+	//draw imgui into the swapchain image
+	_graph.AddPass("Imgui", {
+		{ swapchainImage, ResourceUsage::ColorAttachmentWrite },
+	}, [&](VkCommandBuffer cmd) {
+		DrawImgui(cmd, image.imageView);
+	});
+
+	_graph.AddPass("Present", {
+		{ swapchainImage, ResourceUsage::Present },
+	});
+}
+
+void Game::DrawReadbackPasses(FrameData& frame) {
+	if (!_frameWriter) {
+		return;
+	}
+	// blit converts the float draw image to 8 bit and stretches the rendered region like the present path
+	_graph.AddPass("Convert", {
+		{ _drawImageResource, ResourceUsage::TransferSrc },
+		{ _readbackImageResource, ResourceUsage::TransferDst, true },
+	}, [&](VkCommandBuffer cmd) {
+		CopyImageToImage(cmd, _drawImage.image, _readbackImage.image, _drawExtent, ToExtent2D(_readbackImage.imageExtent));
+	});
+
+	_graph.AddPass("Readback", {
+		{ _readbackImageResource, ResourceUsage::TransferSrc },
+		{ frame.readbackResource, ResourceUsage::TransferDst },
+	}, [&](VkCommandBuffer cmd) {
+		VkBufferImageCopy region{
+			.bufferOffset = 0,
+			.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.imageExtent = _readbackImage.imageExtent,
+		};
+		vkCmdCopyImageToBuffer(cmd, _readbackImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readbackBuffer.buffer, 1, &region);
+	});
+
+	// makes the copy visible to the host once the fence signals
+	_graph.AddPass("Host", {
+		{ frame.readbackResource, ResourceUsage::HostRead },
+	});
+
+	frame.readbackFrame = int64_t(_frameNumber);
 }
 
-void Game::DrawGeometry(VkCommandBuffer cmd, double dt) {
+void Game::DrawGeometry(VkCommandBuffer cmd, VkImageView depthImageView, double dt) {
+	ProfileScope zone(_profiler, "DrawGeometry");
 	//begin a render pass  connected to our draw image
 	VkClearValue clearColor{
 		.color = {0.05, 0.05, 0.10}
 	};
 	VkRenderingAttachmentInfo colorAttachment = RenderingAttachmentInfo(_drawImage.imageView, &clearColor, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-	VkRenderingAttachmentInfo depthAttachment = RenderingDepthAttachmentInfo(_depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+	VkRenderingAttachmentInfo depthAttachment = RenderingDepthAttachmentInfo(depthImageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 
-	VkRenderingInfo renderInfo = RenderingInfo(ToExtent2D(_drawImage.imageExtent), &colorAttachment, &depthAttachment);
+	VkRenderingInfo renderInfo = RenderingInfo(_drawExtent, &colorAttachment, &depthAttachment);
+	renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
 	vkCmdBeginRendering(cmd, &renderInfo);
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipeline);
-
-	//set dynamic viewport and scissor
+	//set dynamic viewport and scissor, secondary command buffers inherit neither so every chunk sets them
 	VkViewport viewport = {};
 	viewport.x = 0;
 	viewport.y = 0;
-	viewport.width = _drawImage.imageExtent.width;
-	viewport.height = _drawImage.imageExtent.height;
+	viewport.width = _drawExtent.width;
+	viewport.height = _drawExtent.height;
 	viewport.minDepth = 0.f;
 	viewport.maxDepth = 1.f;
 
-	vkCmdSetViewport(cmd, 0, 1, &viewport);
-
 	VkRect2D scissor = {};
 	scissor.offset.x = 0;
 	scissor.offset.y = 0;
-	scissor.extent.width = _drawImage.imageExtent.width;
-	scissor.extent.height = _drawImage.imageExtent.height;
+	scissor.extent.width = _drawExtent.width;
+	scissor.extent.height = _drawExtent.height;
 
-	vkCmdSetScissor(cmd, 0, 1, &scissor);
-
-	glm::dmat4 view = _spectator.GetViewMatrix();
-	glm::dmat4 proj = glm::infinitePerspective(glm::radians(70.0), kScreenWidth / (double) kScreenHeight, 0.1);
+	// floating origin, everything is made relative to the camera in double before it is narrowed to float
+	const glm::dvec3 cameraPosition = _spectator.position;
+	glm::dmat4 view = _spectator.GetRotationMatrix();
+	glm::dmat4 proj = glm::infinitePerspective(glm::radians(70.0), _drawImage.imageExtent.width / (double) _drawImage.imageExtent.height, 0.1);
 	// Flip Y because Vulkan viewport has origin in the top left (rather than bottom left like OpenGL).
 	proj[1][1] *= -1.0;
 	// Reverse Z
@@ -458,24 +1114,106 @@ void Game::DrawGeometry(VkCommandBuffer cmd, double dt) {
 #endif
 	proj[2][2] = 0.0;
 	proj[3][2] *= -1.0;
-	
+
+	GPUScenePushConstants scene{ glm::mat4(proj * view) };
+
 	auto& sphere = _meshes.at("SmoothSphere");
 
-	GPUDrawPushConstants pc{};
-	pc.vertexBuffer = sphere.meshBuffers.vertexBufferAddress;
-	vkCmdBindIndexBuffer(cmd, sphere.meshBuffers.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-	for (auto& body : _solarSystem.bodies) {
-		for (int i = 0; i < 20; i++) {
-			glm::dmat4 model = glm::scale(glm::translate(glm::dmat4(1.0), body->GetPositionAtTime(_solarTime + i)), glm::dvec3(GetFoldedRadius(body->GetRadius()) * pow(0.95, i)));
-			pc.worldMatrix = glm::mat4(proj * view * model);
-			vkCmdPushConstants(cmd, _meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &pc);
-			vkCmdDrawIndexed(cmd, sphere.surfaces[0].count, 1, sphere.surfaces[0].startIndex, 0, 0);
+	const GeometryRange& sphereRange = _geometry.GetRange(sphere.geometry);
+	const Frustum frustum = Frustum::FromViewProjection(proj * view);
+	VkDescriptorSet bindlessSet = _bindless.GetSet();
+
+	// the trail steps are spread over secondary command buffers recorded on the job system, this slot's fence has
+	// signalled so its pools can be reset
+	FrameData& frame = GetCurrentFrame();
+	const VkFormat colorFormat = _drawImage.imageFormat;
+	VkCommandBufferInheritanceRenderingInfo inheritanceRendering{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &colorFormat,
+		.depthAttachmentFormat = kDepthFormat,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+	};
+	VkCommandBufferInheritanceInfo inheritance{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = &inheritanceRendering,
+	};
+	const size_t chunkCount = frame.recordBuffers.size();
+	_jobs.ParallelFor(0, chunkCount, 1, [&](size_t first, size_t last) {
+		for (size_t chunk = first; chunk < last; chunk++) {
+			ProfileScope chunkZone(_profiler, "RecordChunk");
+			VkCommandBuffer secondary = frame.recordBuffers[chunk];
+			VK_CHECK_abort(vkResetCommandPool(_device, frame.recordPools[chunk], 0));
+			VkCommandBufferBeginInfo beginInfo = CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+			beginInfo.pInheritanceInfo = &inheritance;
+			VK_CHECK_abort(vkBeginCommandBuffer(secondary, &beginInfo));
+			vkCmdSetViewport(secondary, 0, 1, &viewport);
+			vkCmdSetScissor(secondary, 0, 1, &scissor);
+
+			// stars are directions, the camera position never applies to them
+			if (chunk == 0) {
+				_stars.Draw(secondary, bindlessSet, scene.viewProjection, _starMagnitudeLimit);
+			}
+
+			vkCmdBindPipeline(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipeline);
+			vkCmdBindDescriptorSets(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipelineLayout, 0, 1, &bindlessSet, 0, nullptr);
+			vkCmdPushConstants(secondary, _meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUScenePushConstants), &scene);
+
+			// every mesh lives in the same geometry heap, so one index buffer bind covers all draws
+			vkCmdBindIndexBuffer(secondary, _geometry.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			SubsystemDrawContext context{
+				.cmd = secondary,
+				.frustum = frustum,
+				.cameraPosition = cameraPosition,
+				.indexCount = sphere.surfaces[0].count,
+				.firstIndex = sphereRange.firstIndex + sphere.surfaces[0].startIndex,
+				.vertexOffset = int32_t(sphereRange.firstVertex),
+			};
+			context.pc.vertexBuffer = _geometry.GetVertexBufferAddress();
+			const uint32_t firstStep = uint32_t(chunk * kTrailSteps / chunkCount);
+			const uint32_t lastStep = uint32_t((chunk + 1) * kTrailSteps / chunkCount);
+			for (uint32_t i = firstStep; i < lastStep; i++) {
+				context.time = _solarTime + i;
+				context.sizeScale = pow(0.95, i);
+				// the float batch is cheapest run over every satellite at once, everything else is evaluated as it is
+				// visited so culled systems cost nothing
+				context.relativePositions = nullptr;
+				if (_mixedPrecision) {
+					_chunkPositions[chunk].resize(_solarSystem->bodies.size());
+					_solarSystem->GetSatelliteBatch().Evaluate(context.time, _chunkPositions[chunk].data());
+					context.relativePositions = _chunkPositions[chunk].data();
+				}
+				DrawSubsystem(context, *_solarSystem->sun, _solarSystem->sun->GetPositionAtTime(context.time));
+			}
+			VK_CHECK_abort(vkEndCommandBuffer(secondary));
 		}
-	}
+	});
+	vkCmdExecuteCommands(cmd, (uint32_t)chunkCount, frame.recordBuffers.data());
 
 	vkCmdEndRendering(cmd);
 }
 
+void Game::DrawSubsystem(SubsystemDrawContext& context, const SolarBody& body, const glm::dvec3& position) {
+	const glm::dvec3 relative = position - context.cameraPosition;
+	// one sphere covers the body and every orbit around it, so an off-screen system costs a single test
+	const double bound = body.GetSubsystemExtent() + GetFoldedRadius(body.GetSubsystemBodyRadius()) * context.sizeScale;
+	if (!context.frustum.IntersectsSphere(relative, bound)) {
+		return;
+	}
+	const double radius = GetFoldedRadius(body.GetRadius()) * context.sizeScale;
+	if (context.frustum.IntersectsSphere(relative, radius)) {
+		context.pc.offsetScale = glm::vec4(glm::vec3(relative), float(radius));
+		vkCmdPushConstants(context.cmd, _meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(GPUScenePushConstants), sizeof(GPUDrawPushConstants), &context.pc);
+		vkCmdDrawIndexed(context.cmd, context.indexCount, 1, context.firstIndex, context.vertexOffset, 0);
+	}
+	// satellites are placed relative to this body, its position is never evaluated again
+	for (const SolarBody* satellite : body.GetSatellites()) {
+		const glm::dvec3 offset = context.relativePositions && _solarSystem->IsBatched(satellite->GetIndex())
+			? context.relativePositions[satellite->GetIndex()] : satellite->GetRelativePositionAtTime(context.time);
+		DrawSubsystem(context, *satellite, position + offset);
+	}
+}
+
 void Game::ImmediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function) {
 	VK_CHECK_abort(vkResetFences(_device, 1, &_immediateFence));
 	VK_CHECK_abort(vkResetCommandBuffer(_immediateCommandBuffer, 0));
@@ -594,24 +1332,15 @@ void Game::DestroyBuffer(const AllocatedBuffer& buffer) {
 	vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
 }
 
-GPUMeshBuffers Game::UploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices) {
+GeometryHandle Game::UploadMesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices) {
 	const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
 	const size_t indexBufferSize = indices.size() * sizeof(uint32_t);
 
-	GPUMeshBuffers mesh{};
-
-	//create vertex buffer
-	mesh.vertexBuffer = CreateBuffer(vertexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
-
-	//find the adress of the vertex buffer
-	VkBufferDeviceAddressInfo deviceAdressInfo{ 
-		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-		.buffer = mesh.vertexBuffer.buffer 
-	};
-	mesh.vertexBufferAddress = vkGetBufferDeviceAddress(_device, &deviceAdressInfo);
-
-	//create index buffer
-	mesh.indexBuffer = CreateBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	//find a range for the mesh in the shared geometry buffers
+	GeometryHandle geometry = _geometry.Allocate((uint32_t)vertices.size(), (uint32_t)indices.size());
+	if (!geometry.IsValid()) {
+		return geometry;
+	}
 
 	AllocatedBuffer staging = CreateBuffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
 
@@ -623,134 +1352,67 @@ GPUMeshBuffers Game::UploadMesh(std::span<uint32_t> indices, std::span<Vertex> v
 	memcpy(data + vertexBufferSize, indices.data(), indexBufferSize);
 
 	ImmediateSubmit([&](VkCommandBuffer cmd) {
-		VkBufferCopy vertexCopy{ 
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = vertexBufferSize,
-		};
+		_geometry.RecordUpload(cmd, geometry, staging.buffer, 0, vertexBufferSize);
+	});
 
-		vkCmdCopyBuffer(cmd, staging.buffer, mesh.vertexBuffer.buffer, 1, &vertexCopy);
+	DestroyBuffer(staging);
 
-		VkBufferCopy indexCopy{ 
-			.srcOffset = vertexBufferSize,
-			.dstOffset = 0,
-			.size = indexBufferSize,
-		};
+	return geometry;
+}
 
-		vkCmdCopyBuffer(cmd, staging.buffer, mesh.indexBuffer.buffer, 1, &indexCopy);
-	});
+void Game::DefragmentGeometry() {
+	auto PrintStats = [](const char* label, const BuddyAllocator::Stats& stats) {
+		std::cout << "  " << label << ": " << stats.allocated << "/" << stats.capacity << " used (" << stats.requested << " requested), "
+			<< stats.allocationCount << " allocations, largest free block " << stats.largestFreeBlock << ", fragmentation " << stats.fragmentation << std::endl;
+	};
+	GeometryHeap::Stats before = _geometry.GetStats();
+	std::cout << "Geometry heap: " << before.meshCount << " meshes" << std::endl;
+	PrintStats("vertices", before.vertices);
+	PrintStats("indices", before.indices);
 
-	DestroyBuffer(staging);
+	AllocatedBuffer scratch{};
+	ImmediateSubmit([&](VkCommandBuffer cmd) {
+		scratch = _geometry.RecordDefragment(cmd);
+	});
+	_geometry.DestroyScratch(scratch);
 
-	return mesh;
+	GeometryHeap::Stats after = _geometry.GetStats();
+	std::cout << "Defragmented geometry heap" << std::endl;
+	PrintStats("vertices", after.vertices);
+	PrintStats("indices", after.indices);
 }
 
-bool Game::LoadMeshes(const std::string& filePath) {
+bool Game::DecodeMeshes(const std::string& filePath, std::vector<DecodedMesh>& decoded, std::vector<MeshView>& views) {
+	AllocationScope allocationScope(AllocationTag::Meshes);
+	// baked meshes upload straight from the mapping, loose glTF is decoded on the job system first
 	const auto& fullPath = std::filesystem::current_path() / "assets" / filePath;
+	if (UnpackMeshes(_assetPack.Find("meshes/" + filePath, GetSourceStamp({ fullPath })), views)) {
+		std::cout << "Loading meshes from asset pack: " << filePath << std::endl;
+		return true;
+	}
 	std::cout << "Loading GLTF: " << fullPath << std::endl;
-
-	fastgltf::GltfDataBuffer dataBuffer;
-	if (auto expected = fastgltf::GltfDataBuffer::FromPath(fullPath); expected) {
-		dataBuffer = std::move(expected.get());
-	} else {
-		std::cout << "Fail to get glTF data buffer from path: " << fastgltf::getErrorName(expected.error()) << std::endl;
+	if (!DecodeGltfMeshes(fullPath, _jobs, decoded)) {
 		return false;
 	}
-
-	fastgltf::Asset asset;
-	fastgltf::Parser parser{};
-	if (auto expected = parser.loadGltf(dataBuffer, fullPath.parent_path(), fastgltf::Options::LoadExternalBuffers); expected) {
-		asset = std::move(expected.get());
-	} else {
-		std::cout << "Failed to load glTF: " << fastgltf::getErrorName(expected.error()) << std::endl;
-		return false;
+	for (const DecodedMesh& mesh : decoded) {
+		views.push_back({ mesh.name, mesh.surfaces, mesh.indices, mesh.vertices });
 	}
-	
-	for (fastgltf::Mesh& mesh : asset.meshes) {
-		MeshAsset& newmesh = _meshes[std::string(mesh.name)];
-		newmesh.name = mesh.name;
-
-		std::vector<uint32_t> indices;
-		std::vector<Vertex> vertices;
-
-		for (auto&& p : mesh.primitives) {
-			GeoSurface newSurface;
-			newSurface.startIndex = (uint32_t)indices.size();
-			newSurface.count = (uint32_t)asset.accessors[p.indicesAccessor.value()].count;
-
-			size_t initial_vtx = vertices.size();
-
-			// load indexes
-			{
-				fastgltf::Accessor& indexaccessor = asset.accessors[p.indicesAccessor.value()];
-				indices.reserve(indices.size() + indexaccessor.count);
-
-				fastgltf::iterateAccessor<std::uint32_t>(asset, indexaccessor,
-					[&](std::uint32_t idx) {
-						indices.push_back(idx + initial_vtx);
-					});
-			}
-
-			// load vertex positions
-			{
-				fastgltf::Accessor& posAccessor = asset.accessors[p.findAttribute("POSITION")->accessorIndex];
-				vertices.resize(vertices.size() + posAccessor.count);
-
-				fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, posAccessor,
-					[&](glm::vec3 v, size_t index) {
-						Vertex newvtx;
-						newvtx.position = v;
-						newvtx.normal = { 1, 0, 0 };
-						newvtx.color = glm::vec4{ 1.f };
-						newvtx.uv_x = 0;
-						newvtx.uv_y = 0;
-						vertices[initial_vtx + index] = newvtx;
-					});
-			}
-
-			// load vertex normals
-			auto normals = p.findAttribute("NORMAL");
-			if (normals != p.attributes.end()) {
-
-				fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, asset.accessors[(*normals).accessorIndex],
-					[&](glm::vec3 v, size_t index) {
-						vertices[initial_vtx + index].normal = v;
-					});
-			}
-
-			// load UVs
-			auto uv = p.findAttribute("TEXCOORD_0");
-			if (uv != p.attributes.end()) {
-
-				fastgltf::iterateAccessorWithIndex<glm::vec2>(asset, asset.accessors[(*uv).accessorIndex],
-					[&](glm::vec2 v, size_t index) {
-						vertices[initial_vtx + index].uv_x = v.x;
-						vertices[initial_vtx + index].uv_y = v.y;
-					});
-			}
-
-			// load vertex colors
-			auto colors = p.findAttribute("COLOR_0");
-			if (colors != p.attributes.end()) {
-
-				fastgltf::iterateAccessorWithIndex<glm::vec4>(asset, asset.accessors[(*colors).accessorIndex],
-					[&](glm::vec4 v, size_t index) {
-						vertices[initial_vtx + index].color = v;
-					});
-			}
-			newmesh.surfaces.push_back(newSurface);
-		}
+	return true;
+}
 
-		// display the vertex normals
-		constexpr bool OverrideColors = true;
-		if (OverrideColors) {
-			for (Vertex& vtx : vertices) {
-				vtx.color = glm::vec4(vtx.normal, 1.f);
-			}
+bool Game::UploadMeshes(std::span<const MeshView> views) {
+	AllocationScope allocationScope(AllocationTag::Meshes);
+	// the uploads stay on one thread with the immediate submit
+	for (const MeshView& view : views) {
+		MeshAsset& newmesh = _meshes[std::string(view.name)];
+		newmesh.name = view.name;
+		newmesh.surfaces.assign(view.surfaces.begin(), view.surfaces.end());
+		newmesh.geometry = UploadMesh(view.indices, view.vertices);
+		if (!newmesh.geometry.IsValid()) {
+			std::cout << "Geometry heap is full, could not upload mesh: " << newmesh.name << std::endl;
+			return false;
 		}
-		newmesh.meshBuffers = UploadMesh(indices, vertices);
 	}
-
 	return true;
 }
 
@@ -3,50 +3,153 @@
 #include <SDL3/SDL_scancode.h>
 #include <VkBootstrap.h>
 #include <array>
+#include <chrono>
+#include <cstdlib>
 #include <deque>
 #include <unordered_map>
 #include <functional>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include "graphics/graphics_types.h"
 #include "graphics/graphics_memory.h"
 #include "graphics/graphics_shaders.h"
+#include "graphics/graphics_bindless.h"
+#include "graphics/graphics_geometry.h"
+#include "graphics/graphics_graph.h"
+#include "graphics/graphics_resolution.h"
+#include "graphics/graphics_stars.h"
+#include "graphics/graphics_frustum.h"
+#include "graphics/graphics_profiler.h"
+#include "graphics/graphics_meshes.h"
 #include "dynamics/dynamics_orbits.h"
 #include "util/util_spectator.h"
+#include "util/util_frame_writer.h"
+#include "util/util_replay.h"
+#include "util/util_profiler.h"
+#include "util/util_allocations.h"
+#include "util/util_jobs.h"
+#include "util/util_asset_pack.h"
+#include "util/util_frame_pacer.h"
+#include "shared/shared_state.h"
 
 const unsigned FRAME_OVERLAP = 2;
 
+// the record sizes the pack was baked with, a pack that disagrees is ignored and the loose files are used
+constexpr uint32_t kAssetPackLayout = uint32_t(sizeof(BodyRecord)) | uint32_t(sizeof(Vertex)) << 8
+	| uint32_t(sizeof(MeshRecord)) << 16 | uint32_t(sizeof(GeoSurface)) << 24;
+
+// the tables the baked body records come from, an edit to one of them makes the loose tables load instead
+inline uint64_t GetBodySourceStamp(const std::filesystem::path& assets) {
+	return GetSourceStamp({ assets / "data" / "PlanetOrbits.csv", assets / "data" / "PlanetConstants.csv",
+		assets / "data" / "SatelliteOrbits.csv", assets / "data" / "SatelliteConstants.csv" });
+}
+
+struct GameOptions {
+	uint32_t width = 1280;
+	uint32_t height = 960;
+	double startTime = 2461044.5;//A.D. 2026-Jan-04 00:00:00.0000 TBD
+	// Headless renders offscreen without a window, surface or swapchain
+	bool headless = false;
+	uint64_t frameCount = 600;
+	double timeStep = 1.0 / 24.0; // days advanced per headless frame
+	std::filesystem::path outputPath; // no output only benchmarks
+	FrameFormat outputFormat = FrameFormat::Png;
+	// Capture and replay of the per frame inputs
+	std::filesystem::path recordPath;
+	std::filesystem::path replayPath;
+	bool replayFast = false; // ignore the recorded pace
+	std::filesystem::path timingsPath; // per frame timings as CSV
+	std::string publishName; // shared memory segment for live body positions, empty to disable
+	bool mixedPrecision = false; // satellites relative to their planet in float SIMD
+	std::filesystem::path tracePath; // Chrome trace of the profiled frames, written on exit
+	std::filesystem::path memoryReportPath; // heap and VMA statistics as JSON, written on exit
+	uint64_t warmupFrames = 60; // frames after this are steady state for the allocation counts
+	bool assertZeroAlloc = false; // fail the run if a steady state frame allocates
+	uint32_t threadCount = 0; // job system threads including the main thread, 0 for one per hardware thread
+	// Frame pacing
+	PresentMode presentMode = PresentMode::Fifo; // falls back to fifo where the surface lacks it
+	bool lowLatency = false; // wait for the frame slot before sampling input
+	double frameCap = 0.0; // frames per second, 0 for no cap
+};
+
 class Game {
 public:
-	Game();
+	Game(const GameOptions& options);
 	~Game();
 	void Run();
+	int GetExitCode() const;
 private:
 	struct FrameData {
 		VkCommandPool cmdPool;
 		VkCommandBuffer cmdBuffer;
 		VkSemaphore swapchainSemaphore;
 		VkFence renderFence;
-		DeletionQueue deletionQueue;
+		// headless readback ring, one host visible buffer per frame in flight
+		AllocatedBuffer readbackBuffer;
+		RenderGraphResource readbackResource;
+		int64_t readbackFrame = -1;
+		// the geometry pass records in chunks on the job system, a pool per chunk as pools are single threaded
+		std::vector<VkCommandPool> recordPools;
+		std::vector<VkCommandBuffer> recordBuffers;
 	};
 	struct SwapChainData {
 		VkImage image;
 		VkImageView imageView;
 		VkSemaphore renderSemaphore;
 	};
+	void RunHeadless();
+	bool ApplyInput(const ReplayFrame& input);
+	void RecordTimings(double cpuMs);
+	void SaveTimings();
+	void InitPublisher();
+	void PublishState();
+	void BeginFrame();
+	void AbandonFrame();
 	void Draw(double dt);
-	void DrawGeometry(VkCommandBuffer cmd, double dt);
+	void WriteReadback(FrameData& frame);
+	void DrawPresentPasses(uint32_t swapchainImageIndex);
+	void DrawReadbackPasses(FrameData& frame);
+	void DrawGeometry(VkCommandBuffer cmd, VkImageView depthImageView, double dt);
+	struct SubsystemDrawContext {
+		VkCommandBuffer cmd;
+		Frustum frustum;
+		glm::dvec3 cameraPosition;
+		double time;
+		double sizeScale; // shrinks the trail of future positions
+		const glm::dvec3* relativePositions; // precomputed by body index, null to evaluate as drawn
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		GPUDrawPushConstants pc;
+	};
+	void DrawSubsystem(SubsystemDrawContext& context, const SolarBody& body, const glm::dvec3& position);
 	FrameData& GetCurrentFrame();
+	std::chrono::steady_clock::time_point _startTime; // for the time to first frame
+	GameOptions _options;
+	JobSystem _jobs;
+	AssetPack _assetPack;
 	SDL_Window* _window;
 	vkb::Instance _instance;
 	vkb::Device _device;
 	vkb::Swapchain _swapchain;
 	std::vector<SwapChainData> _swapchainImages;
+	void CreateSwapchain();
+	void RecreateSwapchain();
+	void DestroySwapchain();
+	PresentMode _presentMode;
+	bool _swapchainDirty = false; // suboptimal, out of date or a new present mode, recreated before the next acquire
+	FramePacer _pacer;
+	bool _lowLatency;
+	bool _frameBegun = false; // BeginFrame has run for the current frame
+	uint32_t _swapchainImageIndex = 0;
 	VkSurfaceKHR _surface;
 	std::array<FrameData, FRAME_OVERLAP> _frames = {};
 	VkQueue _graphicsQueue;
 	uint32_t _graphicsQueueFamilyIndex;
 	int32_t _frameNumber = 0;
 	DeletionQueue _mainDeletionQueue;
+	ResourceRetirer _retirer;
 	VmaAllocator _allocator;
 	struct AllocatedImage {
 		VkImage image;
@@ -56,7 +159,28 @@ private:
 		VkFormat imageFormat;
 	};
 	AllocatedImage _drawImage;
-	AllocatedImage _depthImage;
+	RenderGraph _graph;
+	RenderGraphResource _drawImageResource;
+	// the part of the draw image rendered this frame
+	VkExtent2D _drawExtent;
+	DynamicResolution _dynamicResolution;
+	bool _timestampsSupported;
+	bool _largePoints = false;
+	double _lastGpuFrameMs = 0.0;
+	Profiler _profiler;
+	GpuProfiler _gpuProfiler;
+	bool _showProfiler = false;
+	void SaveTrace();
+	FrameAllocationLog _allocationLog;
+	GpuMemoryReport _gpuMemory;
+	bool _showMemory = false;
+	void DrawMemoryOverlay();
+	void SaveMemoryReport();
+	int _exitCode = EXIT_SUCCESS;
+	AllocatedImage _readbackImage;
+	RenderGraphResource _readbackImageResource;
+	std::unique_ptr<FrameWriter> _frameWriter;
+	FrameTimingLog _timings;
 	//Immediate Submit
 	VkFence _immediateFence;
 	VkCommandBuffer _immediateCommandBuffer;
@@ -64,15 +188,29 @@ private:
 	void ImmediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
 	void InitImgui();
 	void DrawImgui(VkCommandBuffer cmd, VkImageView targetImageView);
+	BindlessTable _bindless;
+	StarField _stars;
+	float _starMagnitudeLimit = 6.5f; // roughly naked eye
 	VkPipelineLayout _meshPipelineLayout;
 	VkPipeline _meshPipeline;
 	AllocatedBuffer CreateBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
 	void DestroyBuffer(const AllocatedBuffer& buffer);
-	GPUMeshBuffers UploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
-	bool LoadMeshes(const std::string& filePath);
+	GeometryHandle UploadMesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices);
+	void DefragmentGeometry();
+	GeometryHeap _geometry;
+	// decoding needs no device, so it overlaps the Vulkan setup. The views point into the pack or the decoded meshes.
+	bool DecodeMeshes(const std::string& filePath, std::vector<DecodedMesh>& decoded, std::vector<MeshView>& views);
+	bool UploadMeshes(std::span<const MeshView> views);
 	std::unordered_map<std::string, MeshAsset> _meshes;
-	SolarSystem _solarSystem;
+	std::optional<SolarSystem> _solarSystem; // built by a startup stage
+	void LoadSolarSystem();
 	double _solarTime;
+	bool _mixedPrecision;
+	std::vector<glm::dvec3> _relativePositions;
+	std::vector<std::vector<glm::dvec3>> _chunkPositions; // per recording chunk, for the mixed precision trail
+	void PrintMixedPrecisionBounds() const;
+	SharedStatePublisher _publisher;
+	std::vector<int32_t> _publishParents; // index into bodies, parents always come first
 	Spectator _spectator;
 	std::array<bool, SDL_SCANCODE_COUNT> _keysDown;
 	int _foldIndex = 0;
@@ -0,0 +1,152 @@
+#include "graphics_bindless.h"
+#include <algorithm>
+#include <array>
+#include "graphics/graphics_errors.h"
+
+uint32_t BindlessTable::Slots::Acquire() {
+    if (!freeList.empty()) {
+        uint32_t index = freeList.back();
+        freeList.pop_back();
+        return index;
+    }
+    if (next >= capacity) {
+        return kInvalidIndex;
+    }
+    return next++;
+}
+
+void BindlessTable::Slots::Release(uint32_t index) {
+    if (index != kInvalidIndex) {
+        freeList.push_back(index);
+    }
+}
+
+void BindlessTable::Init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t maxStorageBuffers, uint32_t maxStorageImages) {
+    // clamp the table to what the device allows for update-after-bind descriptors
+    VkPhysicalDeviceVulkan12Properties properties12{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+    VkPhysicalDeviceProperties2 properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &properties12 };
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    _storageBuffers.capacity = std::min(maxStorageBuffers, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+    _storageImages.capacity = std::min(maxStorageImages, properties12.maxPerStageDescriptorUpdateAfterBindStorageImages);
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{
+        VkDescriptorSetLayoutBinding{
+            .binding = kStorageBufferBinding,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = _storageBuffers.capacity,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+        },
+        VkDescriptorSetLayoutBinding{
+            .binding = kStorageImageBinding,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = _storageImages.capacity,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+        },
+    };
+    // slots can be written while the set is bound (even by frames in flight) and most of them will never be filled
+    const VkDescriptorBindingFlags bindingFlag = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    std::array<VkDescriptorBindingFlags, 2> bindingFlags{ bindingFlag, bindingFlag };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = (uint32_t)bindingFlags.size(),
+        .pBindingFlags = bindingFlags.data(),
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &bindingFlagsInfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = (uint32_t)bindings.size(),
+        .pBindings = bindings.data(),
+    };
+    VK_CHECK_abort(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &_layout));
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{
+        VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _storageBuffers.capacity },
+        VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _storageImages.capacity },
+    };
+    VkDescriptorPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = (uint32_t)poolSizes.size(),
+        .pPoolSizes = poolSizes.data(),
+    };
+    VK_CHECK_abort(vkCreateDescriptorPool(device, &poolInfo, nullptr, &_pool));
+
+    VkDescriptorSetAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = _pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &_layout,
+    };
+    VK_CHECK_abort(vkAllocateDescriptorSets(device, &allocInfo, &_set));
+}
+
+void BindlessTable::Destroy(VkDevice device) {
+    vkDestroyDescriptorPool(device, _pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, _layout, nullptr);
+    _pool = VK_NULL_HANDLE;
+    _layout = VK_NULL_HANDLE;
+    _set = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTable::AddStorageBuffer(VkDevice device, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    uint32_t index = _storageBuffers.Acquire();
+    if (index == kInvalidIndex) {
+        return kInvalidIndex;
+    }
+    VkDescriptorBufferInfo bufferInfo{
+        .buffer = buffer,
+        .offset = offset,
+        .range = range,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = _set,
+        .dstBinding = kStorageBufferBinding,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &bufferInfo,
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return index;
+}
+
+uint32_t BindlessTable::AddStorageImage(VkDevice device, VkImageView imageView, VkImageLayout layout) {
+    uint32_t index = _storageImages.Acquire();
+    if (index == kInvalidIndex) {
+        return kInvalidIndex;
+    }
+    VkDescriptorImageInfo imageInfo{
+        .imageView = imageView,
+        .imageLayout = layout,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = _set,
+        .dstBinding = kStorageImageBinding,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .pImageInfo = &imageInfo,
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return index;
+}
+
+void BindlessTable::RemoveStorageBuffer(uint32_t index) {
+    _storageBuffers.Release(index);
+}
+
+void BindlessTable::RemoveStorageImage(uint32_t index) {
+    _storageImages.Release(index);
+}
+
+VkDescriptorSetLayout BindlessTable::GetLayout() const {
+    return _layout;
+}
+
+VkDescriptorSet BindlessTable::GetSet() const {
+    return _set;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One large update-after-bind descriptor set holding every storage buffer and storage image the renderer uses.
+// The set is bound once per frame and shaders pick resources by the indices passed in push constants.
+class BindlessTable {
+public:
+    static constexpr uint32_t kStorageBufferBinding = 0;
+    static constexpr uint32_t kStorageImageBinding = 1;
+    static constexpr uint32_t kInvalidIndex = UINT32_MAX;
+
+    void Init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t maxStorageBuffers, uint32_t maxStorageImages);
+    void Destroy(VkDevice device);
+
+    uint32_t AddStorageBuffer(VkDevice device, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    uint32_t AddStorageImage(VkDevice device, VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL);
+    // Slots are reused immediately, so only remove once no frame in flight can still read the index
+    void RemoveStorageBuffer(uint32_t index);
+    void RemoveStorageImage(uint32_t index);
+
+    VkDescriptorSetLayout GetLayout() const;
+    VkDescriptorSet GetSet() const;
+private:
+    struct Slots {
+        uint32_t capacity = 0;
+        uint32_t next = 0;
+        std::vector<uint32_t> freeList;
+        uint32_t Acquire();
+        void Release(uint32_t index);
+    };
+    VkDescriptorSetLayout _layout = VK_NULL_HANDLE;
+    VkDescriptorPool _pool = VK_NULL_HANDLE;
+    VkDescriptorSet _set = VK_NULL_HANDLE;
+    Slots _storageBuffers;
+    Slots _storageImages;
+};
@@ -67,11 +67,11 @@ constexpr VkCommandBufferSubmitInfo CommandBufferSubmitInfo(VkCommandBuffer cmd)
 	return info;
 }
 
-constexpr VkCommandBufferAllocateInfo CommandBufferAllocateInfo(VkCommandPool commandPool) {
+constexpr VkCommandBufferAllocateInfo CommandBufferAllocateInfo(VkCommandPool commandPool, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
 	return VkCommandBufferAllocateInfo{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
 		.commandPool = commandPool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.level = level,
 		.commandBufferCount = 1
 	};
 }
@@ -0,0 +1,29 @@
+#include "graphics_frustum.h"
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+Frustum Frustum::FromViewProjection(const glm::dmat4& viewProjection) {
+    // Gribb-Hartmann, the rows of the matrix combine into the clip planes
+    const glm::dmat4 m = glm::transpose(viewProjection);
+    Frustum frustum;
+    frustum._planes = {
+        m[3] + m[0], // left
+        m[3] - m[0], // right
+        m[3] + m[1], // bottom
+        m[3] - m[1], // top
+        m[3] - m[2], // near, reverse-Z puts it at z = w
+    };
+    for (glm::dvec4& plane : frustum._planes) {
+        plane /= glm::length(glm::dvec3(plane));
+    }
+    return frustum;
+}
+
+bool Frustum::IntersectsSphere(const glm::dvec3& center, double radius) const {
+    for (const glm::dvec4& plane : _planes) {
+        if (glm::dot(glm::dvec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
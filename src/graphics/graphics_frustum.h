@@ -0,0 +1,15 @@
+#pragma once
+#include <array>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+// View frustum for the infinite reverse-Z projection. There is no far plane, so only the four sides and the near
+// plane are tested. Planes point inwards and are normalised, so the distances are in world units.
+class Frustum {
+public:
+    static Frustum FromViewProjection(const glm::dmat4& viewProjection);
+    bool IntersectsSphere(const glm::dvec3& center, double radius) const;
+private:
+    std::array<glm::dvec4, 5> _planes;
+};
@@ -0,0 +1,297 @@
+#include "graphics_geometry.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include "graphics/graphics_errors.h"
+
+void BuddyAllocator::Init(uint32_t capacity, uint32_t minBlockSize) {
+    _minBlockSize = std::bit_ceil(std::max(minBlockSize, 1u));
+    _capacity = std::bit_ceil(std::max(capacity, _minBlockSize));
+    _maxOrder = std::countr_zero(_capacity / _minBlockSize);
+    Reset();
+}
+
+void BuddyAllocator::Reset() {
+    _freeBlocks.assign(_maxOrder + 1, {});
+    _freeBlocks[_maxOrder].insert(0);
+    _allocatedBlocks.clear();
+}
+
+uint32_t BuddyAllocator::GetOrder(uint32_t size) const {
+    uint32_t blocks = (std::max(size, 1u) + _minBlockSize - 1) / _minBlockSize;
+    return std::countr_zero(std::bit_ceil(blocks));
+}
+
+uint32_t BuddyAllocator::Allocate(uint32_t size) {
+    if (size > _capacity) {
+        return kInvalidOffset;
+    }
+    const uint32_t order = GetOrder(size);
+    // find the smallest free block that fits
+    uint32_t foundOrder = order;
+    while (foundOrder <= _maxOrder && _freeBlocks[foundOrder].empty()) {
+        foundOrder++;
+    }
+    if (foundOrder > _maxOrder) {
+        return kInvalidOffset;
+    }
+    // lowest offset first keeps the heap packed towards the front
+    uint32_t offset = *_freeBlocks[foundOrder].begin();
+    _freeBlocks[foundOrder].erase(_freeBlocks[foundOrder].begin());
+    // split it down, returning the upper halves to the free lists
+    while (foundOrder > order) {
+        foundOrder--;
+        _freeBlocks[foundOrder].insert(offset + (_minBlockSize << foundOrder));
+    }
+    _allocatedBlocks[offset] = { order, size };
+    return offset;
+}
+
+void BuddyAllocator::Free(uint32_t offset) {
+    auto it = _allocatedBlocks.find(offset);
+    assert(it != _allocatedBlocks.end());
+    uint32_t order = it->second.order;
+    _allocatedBlocks.erase(it);
+    // merge with the buddy for as long as it is free too
+    while (order < _maxOrder) {
+        uint32_t buddy = offset ^ (_minBlockSize << order);
+        auto buddyIt = _freeBlocks[order].find(buddy);
+        if (buddyIt == _freeBlocks[order].end()) {
+            break;
+        }
+        _freeBlocks[order].erase(buddyIt);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    _freeBlocks[order].insert(offset);
+}
+
+uint32_t BuddyAllocator::GetBlockSize(uint32_t offset) const {
+    return _minBlockSize << _allocatedBlocks.at(offset).order;
+}
+
+BuddyAllocator::Stats BuddyAllocator::GetStats() const {
+    Stats stats{ .capacity = _capacity };
+    for (const auto& [offset, block] : _allocatedBlocks) {
+        stats.allocated += _minBlockSize << block.order;
+        stats.requested += block.requested;
+        stats.allocationCount++;
+    }
+    for (uint32_t order = 0; order <= _maxOrder; order++) {
+        if (!_freeBlocks[order].empty()) {
+            stats.largestFreeBlock = _minBlockSize << order;
+            stats.freeBlockCount += (uint32_t)_freeBlocks[order].size();
+        }
+    }
+    uint32_t freeSize = _capacity - stats.allocated;
+    stats.fragmentation = freeSize > 0 ? 1.0f - float(stats.largestFreeBlock) / float(freeSize) : 0.0f;
+    return stats;
+}
+
+void GeometryHeap::Init(VkDevice device, VmaAllocator allocator, uint32_t vertexCapacity, uint32_t indexCapacity) {
+    _device = device;
+    _allocator = allocator;
+    // small meshes share a block granularity so the free lists stay short
+    _vertexBlocks.Init(vertexCapacity, 64);
+    _indexBlocks.Init(indexCapacity, 256);
+
+    _vertexBuffer = CreateBuffer(VkDeviceSize(_vertexBlocks.GetStats().capacity) * sizeof(Vertex),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    _indexBuffer = CreateBuffer(VkDeviceSize(_indexBlocks.GetStats().capacity) * sizeof(uint32_t),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+    VkBufferDeviceAddressInfo deviceAdressInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = _vertexBuffer.buffer
+    };
+    _vertexBufferAddress = vkGetBufferDeviceAddress(_device, &deviceAdressInfo);
+}
+
+void GeometryHeap::Destroy() {
+    vmaDestroyBuffer(_allocator, _vertexBuffer.buffer, _vertexBuffer.allocation);
+    vmaDestroyBuffer(_allocator, _indexBuffer.buffer, _indexBuffer.allocation);
+    _ranges.clear();
+    _live.clear();
+    _generations.clear();
+    _freeHandles.clear();
+}
+
+GeometryHandle GeometryHeap::Allocate(uint32_t vertexCount, uint32_t indexCount) {
+    uint32_t firstVertex = _vertexBlocks.Allocate(vertexCount);
+    if (firstVertex == BuddyAllocator::kInvalidOffset) {
+        return {};
+    }
+    uint32_t firstIndex = _indexBlocks.Allocate(indexCount);
+    if (firstIndex == BuddyAllocator::kInvalidOffset) {
+        _vertexBlocks.Free(firstVertex);
+        return {};
+    }
+    GeometryRange range{ firstVertex, vertexCount, firstIndex, indexCount };
+    GeometryHandle handle;
+    if (!_freeHandles.empty()) {
+        handle.index = _freeHandles.back();
+        _freeHandles.pop_back();
+        _ranges[handle.index] = range;
+        _live[handle.index] = true;
+    } else {
+        handle.index = (uint32_t)_ranges.size();
+        _ranges.push_back(range);
+        _live.push_back(true);
+        _generations.push_back(0);
+    }
+    handle.generation = _generations[handle.index];
+    return handle;
+}
+
+void GeometryHeap::Free(GeometryHandle handle) {
+    assert(IsLive(handle));
+    const GeometryRange& range = _ranges[handle.index];
+    _vertexBlocks.Free(range.firstVertex);
+    _indexBlocks.Free(range.firstIndex);
+    _live[handle.index] = false;
+    _generations[handle.index]++;
+    _freeHandles.push_back(handle.index);
+}
+
+bool GeometryHeap::IsLive(GeometryHandle handle) const {
+    return handle.IsValid() && handle.index < _ranges.size() && _live[handle.index] && _generations[handle.index] == handle.generation;
+}
+
+const GeometryRange& GeometryHeap::GetRange(GeometryHandle handle) const {
+    assert(IsLive(handle));
+    return _ranges[handle.index];
+}
+
+void GeometryHeap::RecordUpload(VkCommandBuffer cmd, GeometryHandle handle, VkBuffer staging, VkDeviceSize vertexSrcOffset, VkDeviceSize indexSrcOffset) const {
+    const GeometryRange& range = GetRange(handle);
+    VkBufferCopy vertexCopy{
+        .srcOffset = vertexSrcOffset,
+        .dstOffset = VkDeviceSize(range.firstVertex) * sizeof(Vertex),
+        .size = VkDeviceSize(range.vertexCount) * sizeof(Vertex),
+    };
+    vkCmdCopyBuffer(cmd, staging, _vertexBuffer.buffer, 1, &vertexCopy);
+
+    VkBufferCopy indexCopy{
+        .srcOffset = indexSrcOffset,
+        .dstOffset = VkDeviceSize(range.firstIndex) * sizeof(uint32_t),
+        .size = VkDeviceSize(range.indexCount) * sizeof(uint32_t),
+    };
+    vkCmdCopyBuffer(cmd, staging, _indexBuffer.buffer, 1, &indexCopy);
+}
+
+static void BufferBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+    VkMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = srcStage,
+        .srcAccessMask = srcAccess,
+        .dstStageMask = dstStage,
+        .dstAccessMask = dstAccess,
+    };
+    VkDependencyInfo depInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+AllocatedBuffer GeometryHeap::RecordDefragment(VkCommandBuffer cmd) {
+    std::vector<uint32_t> live;
+    for (uint32_t i = 0; i < _ranges.size(); i++) {
+        if (_live[i]) {
+            live.push_back(i);
+        }
+    }
+    const std::vector<GeometryRange> oldRanges = _ranges;
+
+    // re-allocating largest first lets the buddy allocator pack everything without holes
+    _vertexBlocks.Reset();
+    std::sort(live.begin(), live.end(), [&](uint32_t a, uint32_t b) { return oldRanges[a].vertexCount > oldRanges[b].vertexCount; });
+    for (uint32_t i : live) {
+        _ranges[i].firstVertex = _vertexBlocks.Allocate(oldRanges[i].vertexCount);
+    }
+    _indexBlocks.Reset();
+    std::sort(live.begin(), live.end(), [&](uint32_t a, uint32_t b) { return oldRanges[a].indexCount > oldRanges[b].indexCount; });
+    for (uint32_t i : live) {
+        _ranges[i].firstIndex = _indexBlocks.Allocate(oldRanges[i].indexCount);
+    }
+
+    // overlapping copies within one buffer are not allowed, so moved ranges go out to a scratch buffer and back
+    std::vector<VkBufferCopy> vertexOut, vertexIn, indexOut, indexIn;
+    VkDeviceSize scratchSize = 0;
+    for (uint32_t i : live) {
+        if (_ranges[i].firstVertex != oldRanges[i].firstVertex) {
+            VkDeviceSize size = VkDeviceSize(oldRanges[i].vertexCount) * sizeof(Vertex);
+            vertexOut.push_back({ VkDeviceSize(oldRanges[i].firstVertex) * sizeof(Vertex), scratchSize, size });
+            vertexIn.push_back({ scratchSize, VkDeviceSize(_ranges[i].firstVertex) * sizeof(Vertex), size });
+            scratchSize += size;
+        }
+        if (_ranges[i].firstIndex != oldRanges[i].firstIndex) {
+            VkDeviceSize size = VkDeviceSize(oldRanges[i].indexCount) * sizeof(uint32_t);
+            indexOut.push_back({ VkDeviceSize(oldRanges[i].firstIndex) * sizeof(uint32_t), scratchSize, size });
+            indexIn.push_back({ scratchSize, VkDeviceSize(_ranges[i].firstIndex) * sizeof(uint32_t), size });
+            scratchSize += size;
+        }
+    }
+    if (scratchSize == 0) {
+        return {};
+    }
+    AllocatedBuffer scratch = CreateBuffer(scratchSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    // earlier frames may still be pulling vertices from the old locations
+    BufferBarrier(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    if (!vertexOut.empty()) {
+        vkCmdCopyBuffer(cmd, _vertexBuffer.buffer, scratch.buffer, (uint32_t)vertexOut.size(), vertexOut.data());
+    }
+    if (!indexOut.empty()) {
+        vkCmdCopyBuffer(cmd, _indexBuffer.buffer, scratch.buffer, (uint32_t)indexOut.size(), indexOut.data());
+    }
+    BufferBarrier(cmd, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    if (!vertexIn.empty()) {
+        vkCmdCopyBuffer(cmd, scratch.buffer, _vertexBuffer.buffer, (uint32_t)vertexIn.size(), vertexIn.data());
+    }
+    if (!indexIn.empty()) {
+        vkCmdCopyBuffer(cmd, scratch.buffer, _indexBuffer.buffer, (uint32_t)indexIn.size(), indexIn.data());
+    }
+    BufferBarrier(cmd, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT);
+    return scratch;
+}
+
+void GeometryHeap::DestroyScratch(const AllocatedBuffer& scratch) {
+    if (scratch.buffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(_allocator, scratch.buffer, scratch.allocation);
+    }
+}
+
+VkBuffer GeometryHeap::GetIndexBuffer() const {
+    return _indexBuffer.buffer;
+}
+
+VkDeviceAddress GeometryHeap::GetVertexBufferAddress() const {
+    return _vertexBufferAddress;
+}
+
+GeometryHeap::Stats GeometryHeap::GetStats() const {
+    return Stats{
+        .vertices = _vertexBlocks.GetStats(),
+        .indices = _indexBlocks.GetStats(),
+        .meshCount = (uint32_t)std::count(_live.begin(), _live.end(), true),
+    };
+}
+
+AllocatedBuffer GeometryHeap::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+    VkBufferCreateInfo bufferInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+    };
+    VmaAllocationCreateInfo vmaallocInfo = {
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+    };
+    AllocatedBuffer newBuffer{};
+    VK_CHECK_abort(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo, &newBuffer.buffer, &newBuffer.allocation, &newBuffer.info));
+    return newBuffer;
+}
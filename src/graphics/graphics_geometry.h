@@ -0,0 +1,82 @@
+#pragma once
+#include <set>
+#include <vector>
+#include <unordered_map>
+#include "graphics/graphics_types.h"
+
+// Power-of-two buddy allocator over an abstract range of elements. It only hands out offsets, the memory lives elsewhere.
+class BuddyAllocator {
+public:
+    static constexpr uint32_t kInvalidOffset = UINT32_MAX;
+    struct Stats {
+        uint32_t capacity;
+        uint32_t allocated; // sum of block sizes, including the rounding up to a power of two
+        uint32_t requested; // sum of the sizes callers asked for
+        uint32_t largestFreeBlock;
+        uint32_t allocationCount;
+        uint32_t freeBlockCount;
+        // 0 when all free space is one block, approaching 1 as it splinters
+        float fragmentation;
+    };
+
+    void Init(uint32_t capacity, uint32_t minBlockSize);
+    void Reset();
+    uint32_t Allocate(uint32_t size);
+    void Free(uint32_t offset);
+    uint32_t GetBlockSize(uint32_t offset) const;
+    Stats GetStats() const;
+private:
+    uint32_t GetOrder(uint32_t size) const;
+    uint32_t _capacity = 0;
+    uint32_t _minBlockSize = 1;
+    uint32_t _maxOrder = 0;
+    std::vector<std::set<uint32_t>> _freeBlocks;
+    struct Block {
+        uint32_t order;
+        uint32_t requested;
+    };
+    std::unordered_map<uint32_t, Block> _allocatedBlocks;
+};
+
+// One device-local vertex buffer and one index buffer shared by every mesh. Vertices are pulled through a single
+// buffer device address, draws pass GeometryRange::firstVertex as the vertexOffset so gl_VertexIndex lands in the right range.
+class GeometryHeap {
+public:
+    struct Stats {
+        BuddyAllocator::Stats vertices;
+        BuddyAllocator::Stats indices;
+        uint32_t meshCount;
+    };
+
+    void Init(VkDevice device, VmaAllocator allocator, uint32_t vertexCapacity, uint32_t indexCapacity);
+    void Destroy();
+
+    GeometryHandle Allocate(uint32_t vertexCount, uint32_t indexCount);
+    void Free(GeometryHandle handle);
+    bool IsLive(GeometryHandle handle) const;
+    const GeometryRange& GetRange(GeometryHandle handle) const;
+
+    // Copies a staging buffer holding vertices at vertexSrcOffset and indices at indexSrcOffset into the handle's range
+    void RecordUpload(VkCommandBuffer cmd, GeometryHandle handle, VkBuffer staging, VkDeviceSize vertexSrcOffset, VkDeviceSize indexSrcOffset) const;
+    // Repacks every live range to the front of the heap. The returned scratch buffer must outlive the command buffer,
+    // release it with DestroyScratch once the copy has completed.
+    AllocatedBuffer RecordDefragment(VkCommandBuffer cmd);
+    void DestroyScratch(const AllocatedBuffer& scratch);
+
+    VkBuffer GetIndexBuffer() const;
+    VkDeviceAddress GetVertexBufferAddress() const;
+    Stats GetStats() const;
+private:
+    AllocatedBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+    VkDevice _device;
+    VmaAllocator _allocator;
+    AllocatedBuffer _vertexBuffer;
+    AllocatedBuffer _indexBuffer;
+    VkDeviceAddress _vertexBufferAddress;
+    BuddyAllocator _vertexBlocks;
+    BuddyAllocator _indexBlocks;
+    std::vector<GeometryRange> _ranges;
+    std::vector<bool> _live;
+    std::vector<uint32_t> _generations;
+    std::vector<uint32_t> _freeHandles;
+};
@@ -0,0 +1,295 @@
+#include "graphics_graph.h"
+#include <algorithm>
+#include <cassert>
+#include "graphics/graphics_data.h"
+#include "graphics/graphics_errors.h"
+#include "graphics/graphics_profiler.h"
+
+namespace {
+    struct UsageInfo {
+        VkPipelineStageFlags2 stage;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        bool write;
+    };
+
+    UsageInfo GetUsageInfo(ResourceUsage usage) {
+        switch (usage) {
+        case ResourceUsage::ColorAttachmentWrite:
+            return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true };
+        case ResourceUsage::DepthAttachmentWrite:
+            return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, true };
+        case ResourceUsage::DepthAttachmentRead:
+            return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, false };
+        case ResourceUsage::TransferSrc:
+            return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+        case ResourceUsage::TransferDst:
+            return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+        case ResourceUsage::ComputeStorageRead:
+            return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+        case ResourceUsage::ComputeStorageWrite:
+            return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+        case ResourceUsage::FragmentSampled:
+            return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+        case ResourceUsage::VertexStorageRead:
+            return { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+        case ResourceUsage::IndexRead:
+            return { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+        case ResourceUsage::IndirectRead:
+            return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+        case ResourceUsage::HostRead:
+            return { VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+        case ResourceUsage::Present:
+            // the present semaphore does the rest
+            return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false };
+        }
+        assert(false);
+        return {};
+    }
+
+    constexpr VkAccessFlags2 kWriteAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+        | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+}
+
+bool TransientImageDesc::operator==(const TransientImageDesc& other) const {
+    return format == other.format && extent.width == other.extent.width && extent.height == other.extent.height
+        && extent.depth == other.extent.depth && usage == other.usage && aspect == other.aspect;
+}
+
+void RenderGraph::Init(VkDevice device, VmaAllocator allocator) {
+    _device = device;
+    _allocator = allocator;
+}
+
+void RenderGraph::Destroy() {
+    for (const TransientImage& transient : _transientImages) {
+        vkDestroyImageView(_device, transient.imageView, nullptr);
+        vmaDestroyImage(_allocator, transient.image, transient.allocation);
+    }
+    _transientImages.clear();
+    _resources.clear();
+    _persistentCount = 0;
+}
+
+RenderGraphResource RenderGraph::RegisterImage(VkImage image, VkImageView imageView, VkImageAspectFlags aspect, VkImageLayout layout) {
+    assert(_resources.size() == _persistentCount && "persistent resources must be registered outside of a frame");
+    Resource& resource = _resources.emplace_back();
+    resource.image = image;
+    resource.imageView = imageView;
+    resource.aspect = aspect;
+    resource.state.layout = layout;
+    _persistentCount++;
+    return { uint32_t(_resources.size() - 1) };
+}
+
+RenderGraphResource RenderGraph::RegisterBuffer(VkBuffer buffer) {
+    assert(_resources.size() == _persistentCount && "persistent resources must be registered outside of a frame");
+    Resource& resource = _resources.emplace_back();
+    resource.buffer = buffer;
+    _persistentCount++;
+    return { uint32_t(_resources.size() - 1) };
+}
+
+void RenderGraph::Begin() {
+    _resources.resize(_persistentCount);
+    _passes.clear();
+    _accesses.clear();
+}
+
+RenderGraphResource RenderGraph::ImportImage(VkImage image, VkImageView imageView, VkImageAspectFlags aspect, VkImageLayout layout, VkPipelineStageFlags2 lastStage) {
+    Resource& resource = _resources.emplace_back();
+    resource.image = image;
+    resource.imageView = imageView;
+    resource.aspect = aspect;
+    resource.state.layout = layout;
+    resource.state.writeStages = lastStage;
+    return { uint32_t(_resources.size() - 1) };
+}
+
+RenderGraphResource RenderGraph::CreateTransientImage(const TransientImageDesc& desc) {
+    Resource& resource = _resources.emplace_back();
+    resource.aspect = desc.aspect;
+    resource.desc = desc;
+    // the physical image is picked in Execute once every lifetime is known
+    resource.transient = true;
+    return { uint32_t(_resources.size() - 1) };
+}
+
+void RenderGraph::AddPass(std::string_view name, std::initializer_list<RenderGraphAccess> accesses, RenderPassCallback execute) {
+    _passes.push_back(Pass{
+        .name = std::string(name),
+        .firstAccess = (uint32_t)_accesses.size(),
+        .accessCount = (uint32_t)accesses.size(),
+        .execute = execute,
+    });
+    _accesses.insert(_accesses.end(), accesses.begin(), accesses.end());
+}
+
+RenderGraph::ResourceState& RenderGraph::GetState(Resource& resource) {
+    if (resource.physical != UINT32_MAX) {
+        return _transientImages[resource.physical].state;
+    }
+    return resource.state;
+}
+
+void RenderGraph::AssignTransientImages() {
+    // lifetimes in passes of every per-frame resource
+    const uint32_t frameResources = uint32_t(_resources.size()) - _persistentCount;
+    _lifetimes.assign(frameResources, { UINT32_MAX, 0 });
+    for (uint32_t p = 0; p < _passes.size(); p++) {
+        for (uint32_t a = _passes[p].firstAccess; a < _passes[p].firstAccess + _passes[p].accessCount; a++) {
+            uint32_t r = _accesses[a].resource.index;
+            if (r >= _persistentCount) {
+                auto& [firstUse, lastUse] = _lifetimes[r - _persistentCount];
+                firstUse = std::min(firstUse, p);
+                lastUse = std::max(lastUse, p);
+            }
+        }
+    }
+
+    for (TransientImage& transient : _transientImages) {
+        transient.busyUntil = 0;
+    }
+    for (uint32_t r = _persistentCount; r < _resources.size(); r++) {
+        Resource& resource = _resources[r];
+        const auto [firstUse, lastUse] = _lifetimes[r - _persistentCount];
+        if (!resource.transient || firstUse == UINT32_MAX) {
+            continue;
+        }
+        // alias any physical image with the same description that is no longer in use by then
+        uint32_t assigned = UINT32_MAX;
+        for (uint32_t t = 0; t < _transientImages.size(); t++) {
+            if (_transientImages[t].desc == resource.desc && _transientImages[t].busyUntil <= firstUse) {
+                assigned = t;
+                break;
+            }
+        }
+        if (assigned == UINT32_MAX) {
+            TransientImage& transient = _transientImages.emplace_back();
+            transient.desc = resource.desc;
+            VkImageCreateInfo imageInfo = ImageCreateInfo(resource.desc.format, resource.desc.usage, resource.desc.extent);
+            VmaAllocationCreateInfo allocInfo = {
+                .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+                .requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+            };
+            VK_CHECK_abort(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &transient.image, &transient.allocation, nullptr));
+            VkImageViewCreateInfo viewInfo = ImageViewCreateInfo(resource.desc.format, transient.image, resource.desc.aspect);
+            VK_CHECK_abort(vkCreateImageView(_device, &viewInfo, nullptr, &transient.imageView));
+            assigned = uint32_t(_transientImages.size() - 1);
+        }
+        _transientImages[assigned].busyUntil = lastUse + 1;
+        resource.physical = assigned;
+        resource.image = _transientImages[assigned].image;
+        resource.imageView = _transientImages[assigned].imageView;
+    }
+}
+
+void RenderGraph::AddBarriers(Resource& resource, const RenderGraphAccess& access) {
+    ResourceState& state = GetState(resource);
+    const UsageInfo usage = GetUsageInfo(access.usage);
+    const bool isImage = resource.image != VK_NULL_HANDLE;
+    // a transient's first use in a frame never needs what an aliased image left behind
+    const bool discard = access.discard || (resource.transient && !resource.touched);
+    const bool layoutChange = isImage && (discard || usage.layout != state.layout);
+
+    VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+    bool needsBarrier = false;
+    if (layoutChange || usage.write) {
+        // wait for the last write and every reader since. Discarding only drops the old layout, the last write still has
+        // to finish before this one or the transition, so it stays in the source scope.
+        srcStages = state.writeStages | state.readStages;
+        srcAccess = state.writeAccess;
+        needsBarrier = layoutChange || srcStages != VK_PIPELINE_STAGE_2_NONE;
+    } else if (state.writeStages != VK_PIPELINE_STAGE_2_NONE
+        && ((usage.stage & ~state.visibleStages) || (usage.access & ~state.visibleAccess))) {
+        // read after write that has not been made visible to this stage yet
+        srcStages = state.writeStages;
+        srcAccess = state.writeAccess;
+        needsBarrier = true;
+    }
+
+    if (needsBarrier) {
+        if (isImage) {
+            _imageBarriers.push_back(VkImageMemoryBarrier2{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                .srcStageMask = srcStages,
+                .srcAccessMask = srcAccess,
+                .dstStageMask = usage.stage,
+                .dstAccessMask = usage.access,
+                .oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout,
+                .newLayout = usage.layout,
+                .image = resource.image,
+                .subresourceRange = ImageSubresourceRange(resource.aspect),
+            });
+        } else {
+            _bufferBarriers.push_back(VkBufferMemoryBarrier2{
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                .srcStageMask = srcStages,
+                .srcAccessMask = srcAccess,
+                .dstStageMask = usage.stage,
+                .dstAccessMask = usage.access,
+                .buffer = resource.buffer,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            });
+        }
+    }
+
+    if (layoutChange || usage.write) {
+        // a layout transition behaves like a write that is already visible to this pass
+        state.layout = isImage ? usage.layout : state.layout;
+        state.writeStages = usage.stage;
+        state.writeAccess = usage.access & kWriteAccess;
+        state.readStages = usage.write ? VK_PIPELINE_STAGE_2_NONE : usage.stage;
+        state.visibleStages = usage.stage;
+        state.visibleAccess = usage.access;
+    } else {
+        state.readStages |= usage.stage;
+        if (needsBarrier) {
+            state.visibleStages |= usage.stage;
+            state.visibleAccess |= usage.access;
+        }
+    }
+    resource.touched = true;
+}
+
+void RenderGraph::Execute(VkCommandBuffer cmd) {
+    AssignTransientImages();
+    for (const Pass& pass : _passes) {
+        const uint32_t zone = _profiler ? _profiler->BeginZone(cmd, pass.name) : UINT32_MAX;
+        _imageBarriers.clear();
+        _bufferBarriers.clear();
+        for (uint32_t a = pass.firstAccess; a < pass.firstAccess + pass.accessCount; a++) {
+            AddBarriers(_resources[_accesses[a].resource.index], _accesses[a]);
+        }
+        if (!_imageBarriers.empty() || !_bufferBarriers.empty()) {
+            VkDependencyInfo depInfo{
+                .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                .bufferMemoryBarrierCount = (uint32_t)_bufferBarriers.size(),
+                .pBufferMemoryBarriers = _bufferBarriers.data(),
+                .imageMemoryBarrierCount = (uint32_t)_imageBarriers.size(),
+                .pImageMemoryBarriers = _imageBarriers.data(),
+            };
+            vkCmdPipelineBarrier2(cmd, &depInfo);
+        }
+        if (pass.execute) {
+            pass.execute(cmd);
+        }
+        if (_profiler) {
+            _profiler->EndZone(cmd, zone);
+        }
+    }
+}
+
+void RenderGraph::SetProfiler(GpuProfiler* profiler) {
+    _profiler = profiler;
+}
+
+VkImage RenderGraph::GetImage(RenderGraphResource resource) const {
+    return _resources.at(resource.index).image;
+}
+
+VkImageView RenderGraph::GetImageView(RenderGraphResource resource) const {
+    return _resources.at(resource.index).imageView;
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <initializer_list>
+#include <vma/vk_mem_alloc.h>
+
+class GpuProfiler;
+
+// How a pass touches a resource, the graph derives stage, access and layout from it
+enum class ResourceUsage {
+    ColorAttachmentWrite,
+    DepthAttachmentWrite,
+    DepthAttachmentRead,
+    TransferSrc,
+    TransferDst,
+    ComputeStorageRead,
+    ComputeStorageWrite,
+    FragmentSampled,
+    VertexStorageRead,
+    IndexRead,
+    IndirectRead,
+    HostRead,
+    Present,
+};
+
+struct RenderGraphResource {
+    static constexpr uint32_t kInvalid = UINT32_MAX;
+    uint32_t index = kInvalid;
+    bool IsValid() const { return index != kInvalid; }
+};
+
+struct RenderGraphAccess {
+    RenderGraphResource resource;
+    ResourceUsage usage;
+    // the previous contents are not needed, images are transitioned from UNDEFINED
+    bool discard = false;
+};
+
+struct TransientImageDesc {
+    VkFormat format;
+    VkExtent3D extent;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+    bool operator==(const TransientImageDesc& other) const;
+};
+
+// Records a pass, stored inline so adding passes every frame never allocates the way std::function can. Captures must
+// be trivially copyable and fit in kStorage bytes, a lambda capturing by reference always does.
+class RenderPassCallback {
+public:
+    static constexpr size_t kStorage = 48;
+    RenderPassCallback() = default;
+    RenderPassCallback(std::nullptr_t) {}
+    template <typename F> requires (!std::is_same_v<std::decay_t<F>, RenderPassCallback> && std::is_invocable_v<const F&, VkCommandBuffer>)
+    RenderPassCallback(F function) {
+        static_assert(sizeof(F) <= kStorage && alignof(F) <= alignof(std::max_align_t), "pass captures too large, capture by reference");
+        static_assert(std::is_trivially_copyable_v<F>, "pass captures must be trivially copyable");
+        new (_storage) F(function);
+        _invoke = [](const void* storage, VkCommandBuffer cmd) { (*static_cast<const F*>(storage))(cmd); };
+    }
+    explicit operator bool() const { return _invoke != nullptr; }
+    void operator()(VkCommandBuffer cmd) const { _invoke(_storage, cmd); }
+private:
+    alignas(std::max_align_t) std::byte _storage[kStorage];
+    void (*_invoke)(const void* storage, VkCommandBuffer cmd) = nullptr;
+};
+
+// Passes declare what they read and write, Execute records them in order with the smallest set of barriers
+// between them, one vkCmdPipelineBarrier2 per pass at most. Transient images with the same description and
+// disjoint lifetimes share one physical image.
+class RenderGraph {
+public:
+    void Init(VkDevice device, VmaAllocator allocator);
+    void Destroy();
+
+    // Persistent resources keep their state across frames
+    RenderGraphResource RegisterImage(VkImage image, VkImageView imageView, VkImageAspectFlags aspect, VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+    RenderGraphResource RegisterBuffer(VkBuffer buffer);
+
+    // Clears passes and per-frame resources
+    void Begin();
+    // Per-frame resources, lastStage is where the previous use finished (e.g. the stage a semaphore wait blocks)
+    RenderGraphResource ImportImage(VkImage image, VkImageView imageView, VkImageAspectFlags aspect, VkImageLayout layout, VkPipelineStageFlags2 lastStage = VK_PIPELINE_STAGE_2_NONE);
+    RenderGraphResource CreateTransientImage(const TransientImageDesc& desc);
+    void AddPass(std::string_view name, std::initializer_list<RenderGraphAccess> accesses, RenderPassCallback execute = nullptr);
+    void Execute(VkCommandBuffer cmd);
+    // each pass is wrapped in a GPU zone, barriers included
+    void SetProfiler(GpuProfiler* profiler);
+
+    VkImage GetImage(RenderGraphResource resource) const;
+    VkImageView GetImageView(RenderGraphResource resource) const;
+private:
+    struct ResourceState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+        // readers since the last write, a following write has to wait for them
+        VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+        // where the last write has already been made visible
+        VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 visibleAccess = VK_ACCESS_2_NONE;
+    };
+    struct Resource {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = 0;
+        ResourceState state;
+        bool transient = false;
+        // set once a pass of this frame has used it
+        bool touched = false;
+        // index into _transientImages, the state then lives there
+        uint32_t physical = UINT32_MAX;
+        TransientImageDesc desc;
+    };
+    struct TransientImage {
+        TransientImageDesc desc;
+        VkImage image;
+        VkImageView imageView;
+        VmaAllocation allocation;
+        ResourceState state;
+        // last pass of this Execute that uses it, for aliasing
+        uint32_t busyUntil;
+    };
+    struct Pass {
+        std::string name;
+        uint32_t firstAccess;
+        uint32_t accessCount;
+        RenderPassCallback execute;
+    };
+    ResourceState& GetState(Resource& resource);
+    void AssignTransientImages();
+    void AddBarriers(Resource& resource, const RenderGraphAccess& access);
+    VkDevice _device;
+    VmaAllocator _allocator;
+    GpuProfiler* _profiler = nullptr;
+    uint32_t _persistentCount = 0;
+    std::vector<Resource> _resources;
+    std::vector<TransientImage> _transientImages;
+    std::vector<Pass> _passes;
+    // first and last pass using each per-frame resource, kept so the frame after the first never allocates
+    std::vector<std::pair<uint32_t, uint32_t>> _lifetimes;
+    std::vector<RenderGraphAccess> _accesses;
+    std::vector<VkImageMemoryBarrier2> _imageBarriers;
+    std::vector<VkBufferMemoryBarrier2> _bufferBarriers;
+};
@@ -1,4 +1,6 @@
 #include "graphics_memory.h"
+#include <array>
+#include <imgui.h>
 
 void DeletionQueue::PushFunction(std::function<void()>&& function) {
 	_deletors.push_back(function);
@@ -9,4 +11,205 @@ void DeletionQueue::Flush() {
 		(*it)();
 	}
 	_deletors.clear();
-}
\ No newline at end of file
+}
+
+template<typename T>
+void ResourceRetirer::RetireList<T>::Push(T object, uint64_t frame) {
+	if (frame == kOnFlush) {
+		kept.push_back(object);
+		return;
+	}
+	// an out of order frame only delays destruction until the entries before it are collected
+	pending.push_back({ object, frame });
+}
+
+template<typename T>
+template<typename F>
+void ResourceRetirer::RetireList<T>::Collect(uint64_t completedFrame, F&& destroy) {
+	while (head < pending.size() && pending[head].frame <= completedFrame) {
+		destroy(pending[head].object);
+		head++;
+	}
+	// compact once the destroyed prefix dominates, so the array does not grow without bound
+	if (head == pending.size()) {
+		pending.clear();
+		head = 0;
+	} else if (head > 64 && head * 2 > pending.size()) {
+		pending.erase(pending.begin(), pending.begin() + head);
+		head = 0;
+	}
+	// kept objects go last at shutdown, newest first like the deletion queue
+	if (completedFrame == kOnFlush) {
+		for (auto it = kept.rbegin(); it != kept.rend(); it++) {
+			destroy(*it);
+		}
+		kept.clear();
+	}
+}
+
+void ResourceRetirer::Init(VkDevice device, VmaAllocator allocator) {
+	_device = device;
+	_allocator = allocator;
+}
+
+void ResourceRetirer::Retire(VkBuffer buffer, VmaAllocation allocation, uint64_t frame) {
+	_buffers.Push({ buffer, allocation }, frame);
+}
+
+void ResourceRetirer::Retire(VkImage image, VmaAllocation allocation, uint64_t frame) {
+	_images.Push({ image, allocation }, frame);
+}
+
+void ResourceRetirer::Retire(VkImageView imageView, uint64_t frame) {
+	_imageViews.Push(imageView, frame);
+}
+
+void ResourceRetirer::Retire(VkSampler sampler, uint64_t frame) {
+	_samplers.Push(sampler, frame);
+}
+
+void ResourceRetirer::Retire(VkPipeline pipeline, uint64_t frame) {
+	_pipelines.Push(pipeline, frame);
+}
+
+void ResourceRetirer::Retire(VkPipelineLayout layout, uint64_t frame) {
+	_pipelineLayouts.Push(layout, frame);
+}
+
+void ResourceRetirer::Retire(VkDescriptorSetLayout layout, uint64_t frame) {
+	_descriptorSetLayouts.Push(layout, frame);
+}
+
+void ResourceRetirer::Retire(VkDescriptorPool pool, uint64_t frame) {
+	_descriptorPools.Push(pool, frame);
+}
+
+void ResourceRetirer::Retire(VkCommandPool pool, uint64_t frame) {
+	_commandPools.Push(pool, frame);
+}
+
+void ResourceRetirer::Retire(VkFence fence, uint64_t frame) {
+	_fences.Push(fence, frame);
+}
+
+void ResourceRetirer::Retire(VkSemaphore semaphore, uint64_t frame) {
+	_semaphores.Push(semaphore, frame);
+}
+
+void ResourceRetirer::Retire(VkQueryPool pool, uint64_t frame) {
+	_queryPools.Push(pool, frame);
+}
+
+void ResourceRetirer::Collect(uint64_t completedFrame) {
+	// users before the things they use: pipelines before layouts, views before images
+	_pipelines.Collect(completedFrame, [&](VkPipeline pipeline) { vkDestroyPipeline(_device, pipeline, nullptr); });
+	_pipelineLayouts.Collect(completedFrame, [&](VkPipelineLayout layout) { vkDestroyPipelineLayout(_device, layout, nullptr); });
+	_descriptorPools.Collect(completedFrame, [&](VkDescriptorPool pool) { vkDestroyDescriptorPool(_device, pool, nullptr); });
+	_descriptorSetLayouts.Collect(completedFrame, [&](VkDescriptorSetLayout layout) { vkDestroyDescriptorSetLayout(_device, layout, nullptr); });
+	_imageViews.Collect(completedFrame, [&](VkImageView view) { vkDestroyImageView(_device, view, nullptr); });
+	_samplers.Collect(completedFrame, [&](VkSampler sampler) { vkDestroySampler(_device, sampler, nullptr); });
+	_images.Collect(completedFrame, [&](const ImageAllocation& image) { vmaDestroyImage(_allocator, image.image, image.allocation); });
+	_buffers.Collect(completedFrame, [&](const BufferAllocation& buffer) { vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation); });
+	_commandPools.Collect(completedFrame, [&](VkCommandPool pool) { vkDestroyCommandPool(_device, pool, nullptr); });
+	_queryPools.Collect(completedFrame, [&](VkQueryPool pool) { vkDestroyQueryPool(_device, pool, nullptr); });
+	_fences.Collect(completedFrame, [&](VkFence fence) { vkDestroyFence(_device, fence, nullptr); });
+	_semaphores.Collect(completedFrame, [&](VkSemaphore semaphore) { vkDestroySemaphore(_device, semaphore, nullptr); });
+}
+
+void ResourceRetirer::Flush() {
+	Collect(kOnFlush);
+}
+
+size_t ResourceRetirer::GetPendingCount() const {
+	return _buffers.GetPendingCount() + _images.GetPendingCount() + _imageViews.GetPendingCount() + _samplers.GetPendingCount()
+		+ _pipelines.GetPendingCount() + _pipelineLayouts.GetPendingCount() + _descriptorSetLayouts.GetPendingCount()
+		+ _descriptorPools.GetPendingCount() + _commandPools.GetPendingCount() + _fences.GetPendingCount()
+		+ _semaphores.GetPendingCount() + _queryPools.GetPendingCount();
+}
+
+void GpuMemoryReport::Collect(VmaAllocator allocator) {
+	const VkPhysicalDeviceMemoryProperties* properties;
+	vmaGetMemoryProperties(allocator, &properties);
+	std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+	vmaGetHeapBudgets(allocator, budgets.data());
+	heaps.resize(properties->memoryHeapCount);
+	for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+		heaps[i] = {
+			.size = properties->memoryHeaps[i].size,
+			.deviceLocal = (properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+			.budget = budgets[i],
+		};
+	}
+	VmaTotalStatistics statistics;
+	vmaCalculateStatistics(allocator, &statistics);
+	types.resize(properties->memoryTypeCount);
+	for (uint32_t i = 0; i < properties->memoryTypeCount; i++) {
+		types[i] = {
+			.heapIndex = properties->memoryTypes[i].heapIndex,
+			.flags = properties->memoryTypes[i].propertyFlags,
+			.statistics = statistics.memoryType[i],
+		};
+	}
+}
+
+void GpuMemoryReport::DrawImgui() const {
+	for (size_t i = 0; i < heaps.size(); i++) {
+		const Heap& heap = heaps[i];
+		const VmaStatistics& stats = heap.budget.statistics;
+		ImGui::Text("Heap %zu%s: %.1f / %.1f MiB budget, %.1f MiB in %u blocks, %u allocations", i, heap.deviceLocal ? " (device)" : "",
+			heap.budget.usage / 1048576.0, heap.budget.budget / 1048576.0, stats.blockBytes / 1048576.0, stats.blockCount, stats.allocationCount);
+		ImGui::ProgressBar(heap.budget.budget ? float(double(heap.budget.usage) / heap.budget.budget) : 0.0f, ImVec2(-1.0f, 0.0f));
+	}
+	if (ImGui::BeginTable("Memory types", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Type");
+		ImGui::TableSetupColumn("Heap");
+		ImGui::TableSetupColumn("Blocks");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableSetupColumn("Used / block MiB");
+		ImGui::TableHeadersRow();
+		for (size_t i = 0; i < types.size(); i++) {
+			const VmaStatistics& stats = types[i].statistics.statistics;
+			if (stats.blockCount == 0) {
+				continue;
+			}
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", i);
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", types[i].heapIndex);
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", stats.blockCount);
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", stats.allocationCount);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f / %.1f", stats.allocationBytes / 1048576.0, stats.blockBytes / 1048576.0);
+		}
+		ImGui::EndTable();
+	}
+}
+
+void GpuMemoryReport::WriteJson(std::ostream& stream) const {
+	stream << "{\"heaps\":[";
+	for (size_t i = 0; i < heaps.size(); i++) {
+		const Heap& heap = heaps[i];
+		const VmaStatistics& stats = heap.budget.statistics;
+		stream << (i ? "," : "") << "{\"size\":" << heap.size << ",\"deviceLocal\":" << (heap.deviceLocal ? "true" : "false")
+			<< ",\"usage\":" << heap.budget.usage << ",\"budget\":" << heap.budget.budget
+			<< ",\"blockCount\":" << stats.blockCount << ",\"blockBytes\":" << stats.blockBytes
+			<< ",\"allocationCount\":" << stats.allocationCount << ",\"allocationBytes\":" << stats.allocationBytes << "}";
+	}
+	stream << "],\"types\":[";
+	bool first = true;
+	for (size_t i = 0; i < types.size(); i++) {
+		const VmaDetailedStatistics& detailed = types[i].statistics;
+		if (detailed.statistics.blockCount == 0) {
+			continue;
+		}
+		stream << (first ? "" : ",") << "{\"index\":" << i << ",\"heap\":" << types[i].heapIndex << ",\"flags\":" << types[i].flags
+			<< ",\"blockCount\":" << detailed.statistics.blockCount << ",\"blockBytes\":" << detailed.statistics.blockBytes
+			<< ",\"allocationCount\":" << detailed.statistics.allocationCount << ",\"allocationBytes\":" << detailed.statistics.allocationBytes
+			<< ",\"unusedRanges\":" << detailed.unusedRangeCount << ",\"largestAllocation\":" << detailed.allocationSizeMax << "}";
+		first = false;
+	}
+	stream << "]}";
+}
@@ -1,9 +1,105 @@
 #pragma once
 #include <deque>
 #include <functional>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include "graphics/graphics_types.h"
 
+// For teardown that is not a plain handle (imgui, the allocator itself). Vulkan objects go through ResourceRetirer.
 struct DeletionQueue {
 	std::deque<std::function<void()>> _deletors;
 	void PushFunction(std::function<void()>&& function);
 	void Flush();
-};
\ No newline at end of file
+};
+
+// Deferred destruction of Vulkan and VMA objects. Each type has its own array of handles tagged with the frame that
+// last used them, Collect destroys everything the GPU has finished with in one pass per type.
+// Keep registers objects that live until Flush at shutdown, and may be called from several startup jobs at once.
+class ResourceRetirer {
+public:
+	void Init(VkDevice device, VmaAllocator allocator);
+	void Retire(VkBuffer buffer, VmaAllocation allocation, uint64_t frame);
+	void Retire(VkImage image, VmaAllocation allocation, uint64_t frame);
+	void Retire(VkImageView imageView, uint64_t frame);
+	void Retire(VkSampler sampler, uint64_t frame);
+	void Retire(VkPipeline pipeline, uint64_t frame);
+	void Retire(VkPipelineLayout layout, uint64_t frame);
+	void Retire(VkDescriptorSetLayout layout, uint64_t frame);
+	void Retire(VkDescriptorPool pool, uint64_t frame);
+	void Retire(VkCommandPool pool, uint64_t frame);
+	void Retire(VkFence fence, uint64_t frame);
+	void Retire(VkSemaphore semaphore, uint64_t frame);
+	void Retire(VkQueryPool pool, uint64_t frame);
+	template<typename... Handles>
+	void Keep(Handles... handles) {
+		std::lock_guard lock(_keepMutex);
+		Retire(handles..., kOnFlush);
+	}
+	// Destroys everything retired at or before completedFrame
+	void Collect(uint64_t completedFrame);
+	// Destroys everything, the device must be idle
+	void Flush();
+	size_t GetPendingCount() const;
+private:
+	static constexpr uint64_t kOnFlush = UINT64_MAX;
+	struct BufferAllocation {
+		VkBuffer buffer;
+		VmaAllocation allocation;
+	};
+	struct ImageAllocation {
+		VkImage image;
+		VmaAllocation allocation;
+	};
+	template<typename T>
+	struct RetireList {
+		struct Entry {
+			T object;
+			uint64_t frame;
+		};
+		// retire frames only grow, so a Collect destroys a prefix. Everything before head is gone.
+		std::vector<Entry> pending;
+		size_t head = 0;
+		std::vector<T> kept;
+		void Push(T object, uint64_t frame);
+		template<typename F>
+		void Collect(uint64_t completedFrame, F&& destroy);
+		size_t GetPendingCount() const { return pending.size() - head; }
+	};
+	VkDevice _device;
+	VmaAllocator _allocator;
+	std::mutex _keepMutex; // the kept lists only, retiring stays on the main thread
+	RetireList<BufferAllocation> _buffers;
+	RetireList<ImageAllocation> _images;
+	RetireList<VkImageView> _imageViews;
+	RetireList<VkSampler> _samplers;
+	RetireList<VkPipeline> _pipelines;
+	RetireList<VkPipelineLayout> _pipelineLayouts;
+	RetireList<VkDescriptorSetLayout> _descriptorSetLayouts;
+	RetireList<VkDescriptorPool> _descriptorPools;
+	RetireList<VkCommandPool> _commandPools;
+	RetireList<VkFence> _fences;
+	RetireList<VkSemaphore> _semaphores;
+	RetireList<VkQueryPool> _queryPools;
+};
+
+// VMA budgets per heap and usage per memory type. The allocator has no custom pools, so the memory types stand in for
+// them. Collect walks every block, so it is taken on demand rather than every frame.
+struct GpuMemoryReport {
+	struct Heap {
+		VkDeviceSize size;
+		bool deviceLocal;
+		VmaBudget budget;
+	};
+	struct Type {
+		uint32_t heapIndex;
+		VkMemoryPropertyFlags flags;
+		VmaDetailedStatistics statistics;
+	};
+	std::vector<Heap> heaps;
+	std::vector<Type> types;
+	void Collect(VmaAllocator allocator);
+	// draws into the current imgui window
+	void DrawImgui() const;
+	void WriteJson(std::ostream& stream) const;
+};
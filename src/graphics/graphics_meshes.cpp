@@ -0,0 +1,222 @@
+#include "graphics_meshes.h"
+#include <cstring>
+#include <iostream>
+#include <fastgltf/glm_element_traits.hpp>
+#include <fastgltf/core.hpp>
+#include <fastgltf/tools.hpp>
+#include "util/util_allocations.h"
+#include "util/util_jobs.h"
+
+namespace {
+    // the vertices start on a 16 byte boundary of the blob, which the pack keeps aligned
+    constexpr size_t kVertexAlignment = 16;
+
+    struct MeshPackLayout {
+        size_t records, surfaces, indices, vertices, size;
+    };
+
+    MeshPackLayout GetLayout(const MeshPackHeader& header) {
+        MeshPackLayout layout;
+        layout.records = sizeof(MeshPackHeader);
+        layout.surfaces = layout.records + size_t(header.meshCount) * sizeof(MeshRecord);
+        layout.indices = layout.surfaces + size_t(header.surfaceCount) * sizeof(GeoSurface);
+        layout.vertices = layout.indices + size_t(header.indexCount) * sizeof(uint32_t);
+        layout.vertices = (layout.vertices + kVertexAlignment - 1) & ~(kVertexAlignment - 1);
+        layout.size = layout.vertices + size_t(header.vertexCount) * sizeof(Vertex);
+        return layout;
+    }
+}
+
+bool DecodeGltfMeshes(const std::filesystem::path& path, JobSystem& jobs, std::vector<DecodedMesh>& meshes) {
+    fastgltf::GltfDataBuffer dataBuffer;
+    if (auto expected = fastgltf::GltfDataBuffer::FromPath(path); expected) {
+        dataBuffer = std::move(expected.get());
+    } else {
+        std::cout << "Fail to get glTF data buffer from path: " << fastgltf::getErrorName(expected.error()) << std::endl;
+        return false;
+    }
+
+    fastgltf::Asset asset;
+    fastgltf::Parser parser{};
+    if (auto expected = parser.loadGltf(dataBuffer, path.parent_path(), fastgltf::Options::LoadExternalBuffers); expected) {
+        asset = std::move(expected.get());
+    } else {
+        std::cout << "Failed to load glTF: " << fastgltf::getErrorName(expected.error()) << std::endl;
+        return false;
+    }
+
+    meshes.clear();
+    meshes.resize(asset.meshes.size());
+    jobs.ParallelFor(0, asset.meshes.size(), 1, [&](size_t first, size_t last) {
+        AllocationScope allocationScope(AllocationTag::Meshes);
+        for (size_t m = first; m < last; m++) {
+            const fastgltf::Mesh& mesh = asset.meshes[m];
+            meshes[m].name = mesh.name;
+            std::vector<uint32_t>& indices = meshes[m].indices;
+            std::vector<Vertex>& vertices = meshes[m].vertices;
+
+            for (auto&& p : mesh.primitives) {
+                GeoSurface newSurface;
+                newSurface.startIndex = (uint32_t)indices.size();
+                newSurface.count = (uint32_t)asset.accessors[p.indicesAccessor.value()].count;
+
+                size_t initial_vtx = vertices.size();
+
+                // load indexes
+                {
+                    const fastgltf::Accessor& indexaccessor = asset.accessors[p.indicesAccessor.value()];
+                    indices.reserve(indices.size() + indexaccessor.count);
+
+                    fastgltf::iterateAccessor<std::uint32_t>(asset, indexaccessor,
+                        [&](std::uint32_t idx) {
+                            indices.push_back(idx + initial_vtx);
+                        });
+                }
+
+                // load vertex positions
+                {
+                    const fastgltf::Accessor& posAccessor = asset.accessors[p.findAttribute("POSITION")->accessorIndex];
+                    vertices.resize(vertices.size() + posAccessor.count);
+
+                    fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, posAccessor,
+                        [&](glm::vec3 v, size_t index) {
+                            Vertex newvtx;
+                            newvtx.position = v;
+                            newvtx.normal = { 1, 0, 0 };
+                            newvtx.color = glm::vec4{ 1.f };
+                            newvtx.uv_x = 0;
+                            newvtx.uv_y = 0;
+                            vertices[initial_vtx + index] = newvtx;
+                        });
+                }
+
+                // load vertex normals
+                auto normals = p.findAttribute("NORMAL");
+                if (normals != p.attributes.end()) {
+
+                    fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, asset.accessors[(*normals).accessorIndex],
+                        [&](glm::vec3 v, size_t index) {
+                            vertices[initial_vtx + index].normal = v;
+                        });
+                }
+
+                // load UVs
+                auto uv = p.findAttribute("TEXCOORD_0");
+                if (uv != p.attributes.end()) {
+
+                    fastgltf::iterateAccessorWithIndex<glm::vec2>(asset, asset.accessors[(*uv).accessorIndex],
+                        [&](glm::vec2 v, size_t index) {
+                            vertices[initial_vtx + index].uv_x = v.x;
+                            vertices[initial_vtx + index].uv_y = v.y;
+                        });
+                }
+
+                // load vertex colors
+                auto colors = p.findAttribute("COLOR_0");
+                if (colors != p.attributes.end()) {
+
+                    fastgltf::iterateAccessorWithIndex<glm::vec4>(asset, asset.accessors[(*colors).accessorIndex],
+                        [&](glm::vec4 v, size_t index) {
+                            vertices[initial_vtx + index].color = v;
+                        });
+                }
+                meshes[m].surfaces.push_back(newSurface);
+            }
+
+            // display the vertex normals
+            constexpr bool OverrideColors = true;
+            if (OverrideColors) {
+                for (Vertex& vtx : vertices) {
+                    vtx.color = glm::vec4(vtx.normal, 1.f);
+                }
+            }
+            OptimizeVertexFetch(meshes[m]);
+        }
+    });
+    return true;
+}
+
+void OptimizeVertexFetch(DecodedMesh& mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices) {
+        if (index >= remap.size()) {
+            // out of range indices are left for the validation layers to report
+            continue;
+        }
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+}
+
+std::vector<uint8_t> PackMeshes(std::span<const DecodedMesh> meshes) {
+    MeshPackHeader header{};
+    header.meshCount = (uint32_t)meshes.size();
+    for (const DecodedMesh& mesh : meshes) {
+        header.surfaceCount += (uint32_t)mesh.surfaces.size();
+        header.indexCount += (uint32_t)mesh.indices.size();
+        header.vertexCount += (uint32_t)mesh.vertices.size();
+    }
+    const MeshPackLayout layout = GetLayout(header);
+    std::vector<uint8_t> blob(layout.size);
+    memcpy(blob.data(), &header, sizeof(header));
+    MeshRecord record{};
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const DecodedMesh& mesh = meshes[m];
+        if (mesh.name.size() >= sizeof(record.name)) {
+            std::cout << "Mesh name " << mesh.name << " is truncated in the pack" << std::endl;
+        }
+        memset(record.name, 0, sizeof(record.name));
+        mesh.name.copy(record.name, sizeof(record.name) - 1);
+        record.surfaceCount = (uint32_t)mesh.surfaces.size();
+        record.indexCount = (uint32_t)mesh.indices.size();
+        record.vertexCount = (uint32_t)mesh.vertices.size();
+        memcpy(blob.data() + layout.records + m * sizeof(MeshRecord), &record, sizeof(record));
+        memcpy(blob.data() + layout.surfaces + record.firstSurface * sizeof(GeoSurface), mesh.surfaces.data(), mesh.surfaces.size() * sizeof(GeoSurface));
+        memcpy(blob.data() + layout.indices + record.firstIndex * sizeof(uint32_t), mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+        memcpy(blob.data() + layout.vertices + record.firstVertex * sizeof(Vertex), mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+        record.firstSurface += record.surfaceCount;
+        record.firstIndex += record.indexCount;
+        record.firstVertex += record.vertexCount;
+    }
+    return blob;
+}
+
+bool UnpackMeshes(std::span<const uint8_t> blob, std::vector<MeshView>& meshes) {
+    meshes.clear();
+    if (blob.size() < sizeof(MeshPackHeader)) {
+        return false;
+    }
+    MeshPackHeader header;
+    memcpy(&header, blob.data(), sizeof(header));
+    const MeshPackLayout layout = GetLayout(header);
+    if (blob.size() < layout.size) {
+        return false;
+    }
+    const auto* records = reinterpret_cast<const MeshRecord*>(blob.data() + layout.records);
+    const auto* surfaces = reinterpret_cast<const GeoSurface*>(blob.data() + layout.surfaces);
+    const auto* indices = reinterpret_cast<const uint32_t*>(blob.data() + layout.indices);
+    const auto* vertices = reinterpret_cast<const Vertex*>(blob.data() + layout.vertices);
+    meshes.reserve(header.meshCount);
+    for (uint32_t m = 0; m < header.meshCount; m++) {
+        const MeshRecord& record = records[m];
+        if (uint64_t(record.firstSurface) + record.surfaceCount > header.surfaceCount
+            || uint64_t(record.firstIndex) + record.indexCount > header.indexCount
+            || uint64_t(record.firstVertex) + record.vertexCount > header.vertexCount) {
+            meshes.clear();
+            return false;
+        }
+        meshes.push_back({
+            std::string_view(record.name, strnlen(record.name, sizeof(record.name))),
+            { surfaces + record.firstSurface, record.surfaceCount },
+            { indices + record.firstIndex, record.indexCount },
+            { vertices + record.firstVertex, record.vertexCount }
+        });
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "graphics/graphics_types.h"
+
+class JobSystem;
+
+// A glTF mesh flattened into one vertex and index array, indices are relative to the mesh's own vertices
+struct DecodedMesh {
+    std::string name;
+    std::vector<uint32_t> indices;
+    std::vector<Vertex> vertices;
+    std::vector<GeoSurface> surfaces;
+};
+
+// Decodes every mesh of a binary glTF, one job per mesh. Vertices come out in the order the indices first use them.
+bool DecodeGltfMeshes(const std::filesystem::path& path, JobSystem& jobs, std::vector<DecodedMesh>& meshes);
+// Renumbers the vertices by first use in the index buffer so the vertex fetches walk memory forwards,
+// vertices no index refers to are dropped
+void OptimizeVertexFetch(DecodedMesh& mesh);
+
+// Meshes baked into one blob: the header, a record per mesh, then the surfaces, indices and vertices of every mesh
+// back to back. Index and vertex ranges can be copied into staging as they are.
+struct MeshPackHeader {
+    uint32_t meshCount;
+    uint32_t surfaceCount;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+};
+
+struct MeshRecord {
+    char name[32];
+    uint32_t firstSurface;
+    uint32_t surfaceCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+};
+
+// views into a baked blob
+struct MeshView {
+    std::string_view name;
+    std::span<const GeoSurface> surfaces;
+    std::span<const uint32_t> indices;
+    std::span<const Vertex> vertices;
+};
+
+std::vector<uint8_t> PackMeshes(std::span<const DecodedMesh> meshes);
+// false if the blob is damaged
+bool UnpackMeshes(std::span<const uint8_t> blob, std::vector<MeshView>& meshes);
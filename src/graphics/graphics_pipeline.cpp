@@ -54,6 +54,11 @@ void PipelineBuilder::SetShaders(VkShaderModule vertexShader, VkShaderModule fra
     _shaderStages.push_back(PipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader));
 }
 
+void PipelineBuilder::SetInputTopology(VkPrimitiveTopology topology) {
+    _inputAssembly.topology = topology;
+    _inputAssembly.primitiveRestartEnable = VK_FALSE;
+}
+
 void PipelineBuilder::SetColorAttachmentFormat(VkFormat format) {
     _colorAttachmentformat = format;
     // connect the format to the renderInfo  structure
@@ -73,6 +78,21 @@ void PipelineBuilder::SetDepthTest(bool test, bool write, VkCompareOp op) {
     _depthStencil.maxDepthBounds = 1.0f;
 }
 
+void PipelineBuilder::EnableBlendingAdditive() {
+    // outColor = srcColor + dstColor
+    _colorBlendAttachment.blendEnable = VK_TRUE;
+    _colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    _colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    _colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    _colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    _colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    _colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+}
+
+void PipelineBuilder::DisableBlending() {
+    _colorBlendAttachment.blendEnable = VK_FALSE;
+}
+
 VkPipeline PipelineBuilder::BuildPipeline(VkDevice device) {
     // Don't need to provide ptrs because we are using dynamic viewport and scissor state
     VkPipelineViewportStateCreateInfo viewportState = {
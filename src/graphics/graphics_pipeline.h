@@ -19,9 +19,12 @@ public:
     void Reset();
 
     void SetShaders(VkShaderModule vertexShader, VkShaderModule fragmentShader);
+    void SetInputTopology(VkPrimitiveTopology topology);
     void SetColorAttachmentFormat(VkFormat format);
     void SetDepthFormat(VkFormat format);
     void SetDepthTest(bool test, bool write, VkCompareOp op);
+    void EnableBlendingAdditive();
+    void DisableBlending();
 
     VkPipeline BuildPipeline(VkDevice device);
 };
\ No newline at end of file
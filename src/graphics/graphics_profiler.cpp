@@ -0,0 +1,98 @@
+#include "graphics_profiler.h"
+#include "graphics/graphics_errors.h"
+
+void GpuProfiler::Init(VkDevice device, ResourceRetirer& retirer, Profiler& profiler, uint32_t frameSlots, uint32_t timestampValidBits, float timestampPeriod) {
+    _device = device;
+    _profiler = &profiler;
+    _slots.resize(frameSlots);
+    if (timestampValidBits == 0 || timestampPeriod <= 0.0f) {
+        return;
+    }
+    _timestampPeriod = timestampPeriod;
+    _timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampValidBits) - 1;
+    VkQueryPoolCreateInfo queryPoolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = kMaxZones * 2,
+    };
+    for (Slot& slot : _slots) {
+        VK_CHECK_abort(vkCreateQueryPool(_device, &queryPoolInfo, nullptr, &slot.pool));
+        retirer.Keep(slot.pool);
+    }
+}
+
+bool GpuProfiler::IsSupported() const {
+    return _timestampPeriod > 0.0;
+}
+
+double GpuProfiler::Resolve(uint32_t slotIndex) {
+    Slot& slot = _slots[slotIndex];
+    if (slot.frame == UINT64_MAX) {
+        return 0.0;
+    }
+    const uint64_t frame = slot.frame;
+    const uint32_t queryCount = slot.zoneCount * 2;
+    const VkResult result = vkGetQueryPoolResults(_device, slot.pool, 0, queryCount, queryCount * sizeof(uint64_t), _results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    slot.frame = UINT64_MAX;
+    _resolvedCount = 0;
+    if (result != VK_SUCCESS) {
+        return 0.0;
+    }
+    // nanoseconds from the start of the command buffer, the profiler places them at the frame's submit
+    const uint64_t origin = _results[0];
+    for (uint32_t i = 0; i < slot.zoneCount; i++) {
+        const uint64_t start = uint64_t(((_results[i * 2] - origin) & _timestampMask) * _timestampPeriod);
+        const uint64_t end = uint64_t(((_results[i * 2 + 1] - origin) & _timestampMask) * _timestampPeriod);
+        _zones[i] = { slot.names[i], start, end, 0, slot.depths[i] };
+    }
+    _resolvedCount = slot.zoneCount;
+    _profiler->AddGpuZones(frame, _zones.data(), slot.zoneCount);
+    return (_zones[0].end - _zones[0].start) / 1'000'000.0;
+}
+
+double GpuProfiler::GetZoneMs(std::string_view name) const {
+    for (uint32_t i = 0; i < _resolvedCount; i++) {
+        if (name == _zones[i].name) {
+            return (_zones[i].end - _zones[i].start) / 1'000'000.0;
+        }
+    }
+    return 0.0;
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer cmd, uint32_t slotIndex, uint64_t frame) {
+    _current = nullptr;
+    if (!IsSupported()) {
+        return;
+    }
+    Slot& slot = _slots[slotIndex];
+    vkCmdResetQueryPool(cmd, slot.pool, 0, kMaxZones * 2);
+    slot.frame = frame;
+    slot.zoneCount = 0;
+    _current = &slot;
+    _depth = 0;
+    BeginZone(cmd, "Frame");
+}
+
+uint32_t GpuProfiler::BeginZone(VkCommandBuffer cmd, std::string_view name) {
+    if (!_current || _current->zoneCount == kMaxZones) {
+        return UINT32_MAX;
+    }
+    const uint32_t zone = _current->zoneCount++;
+    _current->names[zone] = _profiler->Intern(name);
+    _current->depths[zone] = _depth++;
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, _current->pool, zone * 2);
+    return zone;
+}
+
+void GpuProfiler::EndZone(VkCommandBuffer cmd, uint32_t zone) {
+    if (!_current || zone == UINT32_MAX) {
+        return;
+    }
+    _depth--;
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, _current->pool, zone * 2 + 1);
+}
+
+void GpuProfiler::EndFrame(VkCommandBuffer cmd) {
+    EndZone(cmd, 0);
+    _current = nullptr;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <string_view>
+#include <vector>
+#include "graphics/graphics_memory.h"
+#include "util/util_profiler.h"
+
+// GPU zones from timestamp queries, one query pool per frame in flight. Zone 0 spans the whole command buffer and
+// gives the GPU frame time, which includes any wait on the swapchain image. Results are read once the slot's fence has
+// signalled, so they never stall.
+class GpuProfiler {
+public:
+    static constexpr uint32_t kMaxZones = 32;
+    void Init(VkDevice device, ResourceRetirer& retirer, Profiler& profiler, uint32_t frameSlots, uint32_t timestampValidBits, float timestampPeriod);
+    bool IsSupported() const;
+    // reads the slot's previous frame into the profiler and returns its GPU time in ms, 0 if there is none
+    double Resolve(uint32_t slot);
+    // a named zone of the last resolved frame in ms, 0 if it had none
+    double GetZoneMs(std::string_view name) const;
+    void BeginFrame(VkCommandBuffer cmd, uint32_t slot, uint64_t frame);
+    // returns UINT32_MAX once the pool is full, EndZone ignores it
+    uint32_t BeginZone(VkCommandBuffer cmd, std::string_view name);
+    void EndZone(VkCommandBuffer cmd, uint32_t zone);
+    void EndFrame(VkCommandBuffer cmd);
+private:
+    struct Slot {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        uint64_t frame = UINT64_MAX; // UINT64_MAX until timestamps are written
+        uint32_t zoneCount = 0;
+        std::array<const char*, kMaxZones> names;
+        std::array<uint16_t, kMaxZones> depths;
+    };
+    VkDevice _device;
+    Profiler* _profiler = nullptr;
+    std::vector<Slot> _slots;
+    Slot* _current = nullptr;
+    uint16_t _depth = 0;
+    double _timestampPeriod = 0.0;
+    uint64_t _timestampMask = 0;
+    std::array<uint64_t, kMaxZones * 2> _results;
+    std::array<ProfileZone, kMaxZones> _zones;
+    uint32_t _resolvedCount = 0;
+};
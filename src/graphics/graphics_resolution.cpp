@@ -0,0 +1,62 @@
+#include "graphics_resolution.h"
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution() : DynamicResolution(Settings{}) {
+}
+
+DynamicResolution::DynamicResolution(const Settings& settings) : _settings(settings), _scale(settings.maxScale) {
+}
+
+void DynamicResolution::SetEnabled(bool enabled) {
+    _enabled = enabled;
+    _scale = _settings.maxScale;
+    _smoothedMs = 0.0;
+    _framesSinceChange = 0;
+}
+
+bool DynamicResolution::IsEnabled() const {
+    return _enabled;
+}
+
+void DynamicResolution::Update(double gpuFrameMs) {
+    if (!_enabled || gpuFrameMs <= 0.0) {
+        return;
+    }
+    // exponential moving average to ignore single slow frames
+    _smoothedMs = _smoothedMs == 0.0 ? gpuFrameMs : _smoothedMs * 0.9 + gpuFrameMs * 0.1;
+    if (++_framesSinceChange < _settings.settleFrames) {
+        return;
+    }
+    const double upper = _settings.targetFrameMs * (1.0 + _settings.hysteresis);
+    const double lower = _settings.targetFrameMs * (1.0 - _settings.hysteresis);
+    if (_smoothedMs <= upper && _smoothedMs >= lower) {
+        return;
+    }
+    // GPU time scales roughly with pixel count, which is the square of the scale
+    double wanted = _scale * std::sqrt(_settings.targetFrameMs / _smoothedMs);
+    wanted = std::clamp(wanted, _scale - _settings.maxStep, _scale + _settings.maxStep);
+    wanted = std::clamp(wanted, _settings.minScale, _settings.maxScale);
+    if (wanted != _scale) {
+        _scale = wanted;
+        _framesSinceChange = 0;
+        // the average was measured at the old scale
+        _smoothedMs = 0.0;
+    }
+}
+
+double DynamicResolution::GetScale() const {
+    return _enabled ? _scale : 1.0;
+}
+
+double DynamicResolution::GetSmoothedFrameMs() const {
+    return _smoothedMs;
+}
+
+VkExtent2D DynamicResolution::GetRenderExtent(VkExtent2D maxExtent) const {
+    const double scale = GetScale();
+    return {
+        std::max(1u, uint32_t(maxExtent.width * scale)),
+        std::max(1u, uint32_t(maxExtent.height * scale)),
+    };
+}
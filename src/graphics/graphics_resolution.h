@@ -0,0 +1,34 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+// Picks the fraction of the draw image to render into so the GPU frame time stays near a target.
+// The scale applies to both axes, the rendered region is then stretched over the swapchain by the existing blit.
+class DynamicResolution {
+public:
+    struct Settings {
+        double targetFrameMs = 1000.0 / 60.0;
+        double minScale = 0.5;
+        double maxScale = 1.0;
+        // fraction of the target the smoothed time has to leave before the scale changes
+        double hysteresis = 0.1;
+        // largest change of scale per adjustment
+        double maxStep = 0.1;
+        // frames to wait after a change, timings lag behind by the frames in flight
+        int settleFrames = 8;
+    };
+
+    DynamicResolution();
+    explicit DynamicResolution(const Settings& settings);
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const;
+    void Update(double gpuFrameMs);
+    double GetScale() const;
+    double GetSmoothedFrameMs() const;
+    VkExtent2D GetRenderExtent(VkExtent2D maxExtent) const;
+private:
+    Settings _settings;
+    bool _enabled = false;
+    double _scale = 1.0;
+    double _smoothedMs = 0.0;
+    int _framesSinceChange = 0;
+};
@@ -34,47 +34,37 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::Build(VkDevice device, VkShaderSt
     return set;
 }
 
-void DescriptorAllocator::InitPool(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios) {
-    std::vector<VkDescriptorPoolSize> poolSizes;
-    for (PoolSizeRatio ratio : poolRatios) {
-        poolSizes.push_back(VkDescriptorPoolSize{
-            .type = ratio._type,
-            .descriptorCount = uint32_t(ratio._ratio * maxSets)
-        });
-    }
-
-    VkDescriptorPoolCreateInfo pool_info = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-    pool_info.flags = 0;
-    pool_info.maxSets = maxSets;
-    pool_info.poolSizeCount = (uint32_t)poolSizes.size();
-    pool_info.pPoolSizes = poolSizes.data();
-
-    vkCreateDescriptorPool(device, &pool_info, nullptr, &_pool);
-}
+static bool CreateShaderModule(VkDevice device, std::span<const uint32_t> code, VkShaderModule* outShaderModule) {
+    // create a new shader module, using the buffer we loaded
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.pNext = nullptr;
 
-void DescriptorAllocator::ClearDescriptors(VkDevice device) {
-    vkResetDescriptorPool(device, _pool, 0);
-}
+    // codeSize has to be in bytes, so multply the ints in the buffer by size of
+    // int to know the real size of the buffer
+    createInfo.codeSize = code.size_bytes();
+    createInfo.pCode = code.data();
 
-void DescriptorAllocator::DestroyPool(VkDevice device) {
-    vkDestroyDescriptorPool(device, _pool, nullptr);
+    // check that the creation goes well.
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        return false;
+    }
+    *outShaderModule = shaderModule;
+    return true;
 }
 
-VkDescriptorSet DescriptorAllocator::Allocate(VkDevice device, VkDescriptorSetLayout layout) {
-    VkDescriptorSetAllocateInfo allocInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-    allocInfo.descriptorPool = _pool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &layout;
-
-    VkDescriptorSet ds;
-    VK_CHECK_abort(vkAllocateDescriptorSets(device, &allocInfo, &ds));
-
-    return ds;
-}
+bool LoadShaderModule(std::string_view shaderPath, VkDevice device, VkShaderModule* outShaderModule, const AssetPack* pack) {
+    const auto& fullPath = std::filesystem::current_path() / "assets" / "shaders" / (std::string(shaderPath) + ".spv");
+    // baked SPIR-V is read in place from the mapping, unless the shader was rebuilt since
+    if (pack) {
+        std::span<const uint32_t> code = pack->FindArray<uint32_t>("shaders/" + std::string(shaderPath) + ".spv", GetSourceStamp({ fullPath }));
+        if (!code.empty()) {
+            return CreateShaderModule(device, code, outShaderModule);
+        }
+    }
 
-bool LoadShaderModule(std::string_view shaderPath, VkDevice device, VkShaderModule* outShaderModule) {
     // open the file. With cursor at the end
-    const auto& fullPath = std::filesystem::current_path() / "assets" / "shaders" / (std::string(shaderPath) + ".spv");
     std::ifstream file(fullPath, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
@@ -98,21 +88,5 @@ bool LoadShaderModule(std::string_view shaderPath, VkDevice device, VkShaderModu
     // now that the file is loaded into the buffer, we can close it
     file.close();
 
-    // create a new shader module, using the buffer we loaded
-    VkShaderModuleCreateInfo createInfo = {};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.pNext = nullptr;
-
-    // codeSize has to be in bytes, so multply the ints in the buffer by size of
-    // int to know the real size of the buffer
-    createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-    createInfo.pCode = buffer.data();
-
-    // check that the creation goes well.
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-        return false;
-    }
-    *outShaderModule = shaderModule;
-    return true;
+    return CreateShaderModule(device, buffer, outShaderModule);
 }
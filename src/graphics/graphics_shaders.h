@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 #include <span>
 #include <string>
+#include "util/util_asset_pack.h"
 
 struct DescriptorLayoutBuilder {
     std::vector<VkDescriptorSetLayoutBinding> _bindings;
@@ -12,18 +13,5 @@ struct DescriptorLayoutBuilder {
     VkDescriptorSetLayout Build(VkDevice device, VkShaderStageFlags shaderStages, void* pNext = nullptr, VkDescriptorSetLayoutCreateFlags flags = 0);
 };
 
-struct DescriptorAllocator {
-    struct PoolSizeRatio {
-        VkDescriptorType _type;
-        float _ratio;
-    };
-    VkDescriptorPool _pool;
-
-    void InitPool(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios);
-    void ClearDescriptors(VkDevice device);
-    void DestroyPool(VkDevice device);
-
-    VkDescriptorSet Allocate(VkDevice device, VkDescriptorSetLayout layout);
-};
-
-bool LoadShaderModule(std::string_view filePath, VkDevice device, VkShaderModule* outShaderModule);
+// looks in the pack first when one is given, then in assets/shaders
+bool LoadShaderModule(std::string_view filePath, VkDevice device, VkShaderModule* outShaderModule, const AssetPack* pack = nullptr);
@@ -0,0 +1,188 @@
+#include "graphics_stars.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "graphics/graphics_bindless.h"
+#include "graphics/graphics_errors.h"
+#include "graphics/graphics_pipeline.h"
+#include "graphics/graphics_shaders.h"
+
+bool StarField::Init(VkDevice device, VmaAllocator allocator, VkPhysicalDevice physicalDevice, bool largePoints, BindlessTable& bindless,
+    const std::filesystem::path& catalogPath, VkFormat colorFormat, VkFormat depthFormat, const AssetPack* pack) {
+    _device = device;
+    _allocator = allocator;
+    if (!_catalog.Open(catalogPath)) {
+        std::cout << "No star catalogue at " << catalogPath << ", generate one with py/make_star_catalog.py" << std::endl;
+        return false;
+    }
+    const uint8_t* data = _catalog.GetData();
+    const size_t size = _catalog.GetSize();
+    if (size < sizeof(StarCatalogHeader)) {
+        std::cout << "Star catalogue is truncated" << std::endl;
+        _catalog.Close();
+        return false;
+    }
+    std::memcpy(&_header, data, sizeof(StarCatalogHeader));
+    const size_t binsOffset = sizeof(StarCatalogHeader);
+    const size_t starsOffset = binsOffset + size_t(_header.binCount) * sizeof(uint32_t);
+    if (std::memcmp(_header.magic, "STAR", 4) != 0 || _header.version != kVersion || _header.binCount == 0 || _header.binWidth <= 0.0f
+        || size < starsOffset + size_t(_header.starCount) * sizeof(StarRecord)) {
+        std::cout << "Star catalogue " << catalogPath << " is not a version " << kVersion << " catalogue" << std::endl;
+        _catalog.Close();
+        return false;
+    }
+    _bins.resize(_header.binCount);
+    std::memcpy(_bins.data(), data + binsOffset, _bins.size() * sizeof(uint32_t));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    // one storage buffer binding has to cover the whole catalogue, the faintest stars are dropped if it cannot
+    const uint32_t maxStars = uint32_t(std::min<uint64_t>(properties.limits.maxStorageBufferRange / sizeof(StarRecord), UINT32_MAX));
+    if (_header.starCount > maxStars) {
+        std::cout << "Star catalogue trimmed from " << _header.starCount << " to " << maxStars << " stars" << std::endl;
+        _header.starCount = maxStars;
+        for (uint32_t& bin : _bins) {
+            bin = std::min(bin, maxStars);
+        }
+    }
+    // the range is what the device supports, writing a size above one is only valid with largePoints enabled
+    _maxPointSize = largePoints ? std::min(properties.limits.pointSizeRange[1], 8.0f) : 1.0f;
+
+    const VkDeviceSize bufferSize = VkDeviceSize(std::max(_header.starCount, 1u)) * sizeof(StarRecord);
+    VkBufferCreateInfo bufferInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = bufferSize,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    };
+    VmaAllocationCreateInfo allocInfo{
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+    };
+    VK_CHECK_abort(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &_stars.buffer, &_stars.allocation, &_stars.info));
+
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VmaAllocationCreateInfo stagingAllocInfo{
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .usage = VMA_MEMORY_USAGE_CPU_ONLY,
+    };
+    VK_CHECK_abort(vmaCreateBuffer(_allocator, &bufferInfo, &stagingAllocInfo, &_staging.buffer, &_staging.allocation, &_staging.info));
+    // the records are already in the GPU layout, so the mapped file is copied straight into the staging buffer
+    std::memcpy(_staging.info.pMappedData, data + starsOffset, size_t(_header.starCount) * sizeof(StarRecord));
+    vmaFlushAllocation(_allocator, _staging.allocation, 0, VK_WHOLE_SIZE);
+
+    _bindlessIndex = bindless.AddStorageBuffer(_device, _stars.buffer);
+    if (!CreatePipeline(bindless.GetLayout(), colorFormat, depthFormat, pack)) {
+        std::cout << "Error when building the star field pipeline" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    std::cout << "Loaded " << _header.starCount << " stars" << std::endl;
+    return true;
+}
+
+bool StarField::CreatePipeline(VkDescriptorSetLayout bindlessLayout, VkFormat colorFormat, VkFormat depthFormat, const AssetPack* pack) {
+    VkShaderModule vertexShader;
+    if (!LoadShaderModule("star_field.vert", _device, &vertexShader, pack)) {
+        return false;
+    }
+    VkShaderModule fragmentShader;
+    if (!LoadShaderModule("star_field.frag", _device, &fragmentShader, pack)) {
+        vkDestroyShaderModule(_device, vertexShader, nullptr);
+        return false;
+    }
+    VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(PushConstants),
+    };
+    VkPipelineLayoutCreateInfo layoutInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &bindlessLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    VK_CHECK_abort(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+    PipelineBuilder pipelineBuilder;
+    pipelineBuilder._pipelineLayout = _pipelineLayout;
+    pipelineBuilder.SetShaders(vertexShader, fragmentShader);
+    pipelineBuilder.SetInputTopology(VK_PRIMITIVE_TOPOLOGY_POINT_LIST);
+    pipelineBuilder.SetColorAttachmentFormat(colorFormat);
+    pipelineBuilder.SetDepthFormat(depthFormat);
+    // stars sit on the far plane, they are tested so the planets cover them but never write depth
+    pipelineBuilder.SetDepthTest(true, false, VK_COMPARE_OP_GREATER_OR_EQUAL);
+    pipelineBuilder.EnableBlendingAdditive();
+    _pipeline = pipelineBuilder.BuildPipeline(_device);
+
+    vkDestroyShaderModule(_device, vertexShader, nullptr);
+    vkDestroyShaderModule(_device, fragmentShader, nullptr);
+    return _pipeline != VK_NULL_HANDLE;
+}
+
+void StarField::RecordUpload(VkCommandBuffer cmd) const {
+    VkBufferCopy copy{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = VkDeviceSize(std::max(_header.starCount, 1u)) * sizeof(StarRecord),
+    };
+    vkCmdCopyBuffer(cmd, _staging.buffer, _stars.buffer, 1, &copy);
+}
+
+void StarField::FinishUpload() {
+    vmaDestroyBuffer(_allocator, _staging.buffer, _staging.allocation);
+    _staging = {};
+    _catalog.Close();
+}
+
+void StarField::Destroy(BindlessTable& bindless) {
+    if (!IsLoaded()) {
+        return;
+    }
+    bindless.RemoveStorageBuffer(_bindlessIndex);
+    vkDestroyPipeline(_device, _pipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+    vmaDestroyBuffer(_allocator, _stars.buffer, _stars.allocation);
+    _stars = {};
+    _pipeline = VK_NULL_HANDLE;
+    _pipelineLayout = VK_NULL_HANDLE;
+}
+
+bool StarField::IsLoaded() const {
+    return _pipeline != VK_NULL_HANDLE;
+}
+
+uint32_t StarField::GetStarCount() const {
+    return _header.starCount;
+}
+
+uint32_t StarField::GetDrawCount(float magnitudeLimit) const {
+    // the bin holding the limit still has stars past it, those are culled in the vertex shader
+    const float bin = std::floor((magnitudeLimit - _header.firstBinMagnitude) / _header.binWidth);
+    if (bin < 0.0f) {
+        return 0;
+    }
+    if (bin >= float(_bins.size())) {
+        return _header.starCount;
+    }
+    return _bins[size_t(bin)];
+}
+
+void StarField::Draw(VkCommandBuffer cmd, VkDescriptorSet bindlessSet, const glm::mat4& viewProjection, float magnitudeLimit) const {
+    if (!IsLoaded()) {
+        return;
+    }
+    const uint32_t count = GetDrawCount(magnitudeLimit);
+    if (count == 0) {
+        return;
+    }
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &bindlessSet, 0, nullptr);
+    PushConstants pc{
+        .viewProjection = viewProjection,
+        .starBuffer = _bindlessIndex,
+        .magnitudeLimit = magnitudeLimit,
+        .maxPointSize = _maxPointSize,
+    };
+    vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pc);
+    vkCmdDraw(cmd, count, 1, 0, 0);
+}
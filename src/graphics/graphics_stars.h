@@ -0,0 +1,67 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include "graphics/graphics_types.h"
+#include "util/util_asset_pack.h"
+#include "util/util_mapped_file.h"
+
+class BindlessTable;
+
+// Layout of stars.bin as written by py/make_star_catalog.py. The header is followed by binCount cumulative star counts
+// (stars fainter than firstBinMagnitude + (i + 1) * binWidth are not counted in bin i) and then the records, brightest first.
+struct StarCatalogHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t starCount;
+    uint32_t binCount;
+    float firstBinMagnitude;
+    float binWidth;
+};
+
+// Matches the std430 layout the star shader reads
+struct StarRecord {
+    float direction[3]; // unit vector in the J2000 ecliptic frame
+    uint32_t magnitudeColor; // half floats, visual magnitude in the low half and B-V colour index in the high half
+};
+
+// Background stars drawn as point sprites in one draw. The catalogue is uploaded once into a device-local buffer read
+// through the bindless table, per frame the CPU only picks a draw count and the vertex shader culls the remainder.
+class StarField {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    // Maps the catalogue and stages it for upload. Returns false if there is no usable catalogue. The shaders come from
+    // the pack when one is given. Stars are single pixels unless the device was created with largePoints.
+    bool Init(VkDevice device, VmaAllocator allocator, VkPhysicalDevice physicalDevice, bool largePoints, BindlessTable& bindless,
+        const std::filesystem::path& catalogPath, VkFormat colorFormat, VkFormat depthFormat, const AssetPack* pack = nullptr);
+    void RecordUpload(VkCommandBuffer cmd) const;
+    // Releases the staging copy and the mapping once the upload has completed
+    void FinishUpload();
+    void Destroy(BindlessTable& bindless);
+
+    bool IsLoaded() const;
+    uint32_t GetStarCount() const;
+    uint32_t GetDrawCount(float magnitudeLimit) const;
+    void Draw(VkCommandBuffer cmd, VkDescriptorSet bindlessSet, const glm::mat4& viewProjection, float magnitudeLimit) const;
+private:
+    struct PushConstants {
+        glm::mat4 viewProjection;
+        uint32_t starBuffer;
+        float magnitudeLimit;
+        float maxPointSize;
+        float padding;
+    };
+    bool CreatePipeline(VkDescriptorSetLayout bindlessLayout, VkFormat colorFormat, VkFormat depthFormat, const AssetPack* pack);
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MappedFile _catalog;
+    StarCatalogHeader _header{};
+    std::vector<uint32_t> _bins;
+    AllocatedBuffer _stars{};
+    AllocatedBuffer _staging{};
+    uint32_t _bindlessIndex = UINT32_MAX;
+    float _maxPointSize = 1.0f;
+    VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline _pipeline = VK_NULL_HANDLE;
+};
@@ -25,16 +25,31 @@ struct AllocatedBuffer {
 	VmaAllocationInfo info;
 };
 
-// holds the resources needed for a mesh
-struct GPUMeshBuffers {
-	AllocatedBuffer indexBuffer;
-	AllocatedBuffer vertexBuffer;
-	VkDeviceAddress vertexBufferAddress;
+// where a mesh lives inside the shared geometry buffers, in vertices and indices rather than bytes
+struct GeometryRange {
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
 };
 
-// push constants for our mesh object draws
+// the generation changes every time a slot is freed, so a stale handle is caught instead of aliasing the next mesh
+struct GeometryHandle {
+	static constexpr uint32_t kInvalid = UINT32_MAX;
+	uint32_t index = kInvalid;
+	uint32_t generation = 0;
+	bool IsValid() const { return index != kInvalid; }
+};
+
+// push constants shared by every mesh draw in a pass, pushed once. The camera sits at the origin so this is the
+// projection times the view rotation only, positions arrive already camera-relative.
+struct GPUScenePushConstants {
+	glm::mat4 viewProjection;
+};
+
+// push constants for our mesh object draws, pushed after the scene block
 struct GPUDrawPushConstants {
-	glm::mat4 worldMatrix;
+	glm::vec4 offsetScale; // camera-relative position in xyz, uniform scale in w
 	VkDeviceAddress vertexBuffer;
 };
 
@@ -47,5 +62,5 @@ struct MeshAsset {
 	std::string name;
 
 	std::vector<GeoSurface> surfaces;
-	GPUMeshBuffers meshBuffers;
+	GeometryHandle geometry;
 };
@@ -0,0 +1,389 @@
+#include "shared_state.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	constexpr char kMagic[8] = { 'S', 'T', 'E', 'O', 'R', 'R', 'A', '\0' };
+
+	// keeps every array on its own cache lines so the snapshots never share a line
+	constexpr size_t AlignUp(size_t value) {
+		return (value + 63) & ~size_t(63);
+	}
+
+	size_t GetSnapshotSize(uint32_t bodyCapacity) {
+		return AlignUp(sizeof(shared::SnapshotHeader)) + 3 * AlignUp(size_t(bodyCapacity) * sizeof(double));
+	}
+
+	const double* GetComponent(const shared::SnapshotHeader* snapshot, uint32_t bodyCapacity, int component) {
+		const uint8_t* base = reinterpret_cast<const uint8_t*>(snapshot) + AlignUp(sizeof(shared::SnapshotHeader));
+		return reinterpret_cast<const double*>(base + component * AlignUp(size_t(bodyCapacity) * sizeof(double)));
+	}
+
+	uint32_t GetProcessId() {
+#ifdef _WIN32
+		return uint32_t(GetCurrentProcessId());
+#else
+		return uint32_t(getpid());
+#endif
+	}
+
+	bool IsProcessAlive(uint32_t process) {
+		// 0 is a segment from before the id was recorded
+		if (process == 0) {
+			return false;
+		}
+#ifdef _WIN32
+		HANDLE handle = OpenProcess(SYNCHRONIZE, FALSE, DWORD(process));
+		if (!handle) {
+			return false;
+		}
+		const bool alive = WaitForSingleObject(handle, 0) == WAIT_TIMEOUT;
+		CloseHandle(handle);
+		return alive;
+#else
+		return kill(pid_t(process), 0) == 0 || errno == EPERM;
+#endif
+	}
+
+	// a steorra segment whose publisher closed it or died without closing it
+	bool IsStale(const std::string& name) {
+		SharedSegment segment;
+		if (!segment.OpenExisting(name) || segment.GetSize() < sizeof(shared::SegmentHeader)) {
+			return false;
+		}
+		const auto* header = reinterpret_cast<const shared::SegmentHeader*>(segment.GetData());
+		if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) {
+			return false;
+		}
+		return header->publisherAlive.load(std::memory_order_acquire) == 0 || !IsProcessAlive(header->publisherProcess);
+	}
+}
+
+size_t shared::GetSegmentSize(uint32_t bodyCapacity) {
+	return AlignUp(sizeof(SegmentHeader)) + 2 * GetSnapshotSize(bodyCapacity)
+		+ AlignUp(size_t(bodyCapacity) * kNameLength) + AlignUp(size_t(bodyCapacity) * sizeof(int32_t)) + AlignUp(size_t(bodyCapacity) * sizeof(double));
+}
+
+SharedSegment::~SharedSegment() {
+	Close();
+}
+
+#ifdef _WIN32
+bool SharedSegment::Create(const std::string& name, size_t size) {
+	Close();
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), ("Local\\" + name).c_str());
+	if (!mapping) {
+		return false;
+	}
+	if (GetLastError() == ERROR_ALREADY_EXISTS) {
+		CloseHandle(mapping);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!view) {
+		CloseHandle(mapping);
+		return false;
+	}
+	std::memset(view, 0, size);
+	_mapping = mapping;
+	_data = static_cast<uint8_t*>(view);
+	_size = size;
+	_name = name;
+	_owner = true;
+	return true;
+}
+
+bool SharedSegment::OpenExisting(const std::string& name) {
+	Close();
+	HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, ("Local\\" + name).c_str());
+	if (!mapping) {
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(mapping);
+		return false;
+	}
+	MEMORY_BASIC_INFORMATION info;
+	VirtualQuery(view, &info, sizeof(info));
+	_mapping = mapping;
+	_data = static_cast<uint8_t*>(view);
+	_size = info.RegionSize;
+	_name = name;
+	_owner = false;
+	return true;
+}
+
+void SharedSegment::Close() {
+	if (_data) {
+		UnmapViewOfFile(_data);
+	}
+	if (_mapping) {
+		CloseHandle(_mapping);
+	}
+	_data = nullptr;
+	_mapping = nullptr;
+	_size = 0;
+	_owner = false;
+}
+
+void SharedSegment::Remove(const std::string&) {
+}
+#else
+bool SharedSegment::Create(const std::string& name, size_t size) {
+	Close();
+	const std::string path = "/" + name;
+	int file = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (file < 0) {
+		return false;
+	}
+	if (ftruncate(file, off_t(size)) != 0) {
+		close(file);
+		shm_unlink(path.c_str());
+		return false;
+	}
+	void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (view == MAP_FAILED) {
+		shm_unlink(path.c_str());
+		return false;
+	}
+	_data = static_cast<uint8_t*>(view);
+	_size = size;
+	_name = name;
+	_owner = true;
+	return true;
+}
+
+bool SharedSegment::OpenExisting(const std::string& name) {
+	Close();
+	int file = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+	if (file < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		close(file);
+		return false;
+	}
+	void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+	_data = static_cast<uint8_t*>(view);
+	_size = size_t(info.st_size);
+	_name = name;
+	_owner = false;
+	return true;
+}
+
+void SharedSegment::Close() {
+	if (_data) {
+		munmap(_data, _size);
+	}
+	if (_owner) {
+		shm_unlink(("/" + _name).c_str());
+	}
+	_data = nullptr;
+	_size = 0;
+	_owner = false;
+}
+
+void SharedSegment::Remove(const std::string& name) {
+	shm_unlink(("/" + name).c_str());
+}
+#endif
+
+uint8_t* SharedSegment::GetData() const {
+	return _data;
+}
+
+size_t SharedSegment::GetSize() const {
+	return _size;
+}
+
+bool SharedStatePublisher::Open(const std::string& name, std::span<const SharedBodyInfo> bodies) {
+	const uint32_t bodyCapacity = uint32_t(bodies.size());
+	const size_t size = shared::GetSegmentSize(bodyCapacity);
+	if (!_segment.Create(name, size)) {
+		// only a segment left behind by a crashed run is replaced, never one another instance is publishing to
+		if (!IsStale(name)) {
+			return false;
+		}
+		SharedSegment::Remove(name);
+		if (!_segment.Create(name, size)) {
+			return false;
+		}
+	}
+	uint8_t* data = _segment.GetData();
+	_header = new (data) shared::SegmentHeader{};
+	_header->version = shared::kVersion;
+	_header->bodyCapacity = bodyCapacity;
+	_header->bodyCount = bodyCapacity;
+	_header->publisherProcess = GetProcessId();
+	size_t offset = AlignUp(sizeof(shared::SegmentHeader));
+	for (uint64_t& snapshotOffset : _header->snapshotOffsets) {
+		snapshotOffset = offset;
+		new (data + offset) shared::SnapshotHeader{};
+		offset += GetSnapshotSize(bodyCapacity);
+	}
+	_header->namesOffset = offset;
+	offset += AlignUp(size_t(bodyCapacity) * shared::kNameLength);
+	_header->parentsOffset = offset;
+	offset += AlignUp(size_t(bodyCapacity) * sizeof(int32_t));
+	_header->radiiOffset = offset;
+	_header->segmentSize = size;
+	for (uint32_t i = 0; i < bodyCapacity; i++) {
+		char* nameSlot = reinterpret_cast<char*>(data + _header->namesOffset) + size_t(i) * shared::kNameLength;
+		std::memcpy(nameSlot, bodies[i].name.data(), std::min<size_t>(bodies[i].name.size(), shared::kNameLength - 1));
+		reinterpret_cast<int32_t*>(data + _header->parentsOffset)[i] = bodies[i].parent;
+		reinterpret_cast<double*>(data + _header->radiiOffset)[i] = bodies[i].radius;
+	}
+	_header->publisherAlive.store(1, std::memory_order_relaxed);
+	// the magic goes last, a reader that sees it sees a complete layout and body table
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(_header->magic, kMagic, sizeof(kMagic));
+	return true;
+}
+
+void SharedStatePublisher::Close() {
+	if (_header) {
+		_header->publisherAlive.store(0, std::memory_order_release);
+	}
+	_header = nullptr;
+	_segment.Close();
+}
+
+bool SharedStatePublisher::IsOpen() const {
+	return _header != nullptr;
+}
+
+shared::SnapshotHeader* SharedStatePublisher::BeginWrite(uint64_t frame, double solarTime) {
+	// write whichever snapshot readers are not being pointed at
+	_back = 1 - _header->current.load(std::memory_order_relaxed);
+	auto* snapshot = reinterpret_cast<shared::SnapshotHeader*>(_segment.GetData() + _header->snapshotOffsets[_back]);
+	const uint64_t sequence = snapshot->sequence.load(std::memory_order_relaxed);
+	snapshot->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	snapshot->frame = frame;
+	snapshot->solarTime = solarTime;
+	snapshot->bodyCount = _header->bodyCount;
+	return snapshot;
+}
+
+void SharedStatePublisher::EndWrite(shared::SnapshotHeader* snapshot) {
+	snapshot->sequence.fetch_add(1, std::memory_order_release);
+	_header->current.store(_back, std::memory_order_release);
+}
+
+double* SharedStatePublisher::GetX(shared::SnapshotHeader* snapshot) const {
+	return const_cast<double*>(GetComponent(snapshot, _header->bodyCapacity, 0));
+}
+
+double* SharedStatePublisher::GetY(shared::SnapshotHeader* snapshot) const {
+	return const_cast<double*>(GetComponent(snapshot, _header->bodyCapacity, 1));
+}
+
+double* SharedStatePublisher::GetZ(shared::SnapshotHeader* snapshot) const {
+	return const_cast<double*>(GetComponent(snapshot, _header->bodyCapacity, 2));
+}
+
+bool SharedStateReader::Open(const std::string& name) {
+	if (!_segment.OpenExisting(name)) {
+		return false;
+	}
+	const auto* header = reinterpret_cast<const shared::SegmentHeader*>(_segment.GetData());
+	if (_segment.GetSize() < sizeof(shared::SegmentHeader) || std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0
+		|| header->version != shared::kVersion || _segment.GetSize() < header->segmentSize) {
+		_segment.Close();
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	_header = header;
+	return true;
+}
+
+void SharedStateReader::Close() {
+	_header = nullptr;
+	_segment.Close();
+}
+
+bool SharedStateReader::IsOpen() const {
+	return _header != nullptr;
+}
+
+bool SharedStateReader::IsPublisherAlive() const {
+	return _header && _header->publisherAlive.load(std::memory_order_acquire) != 0;
+}
+
+SharedStateView SharedStateReader::Begin() const {
+	SharedStateView view{};
+	if (!_header) {
+		return view;
+	}
+	while (true) {
+		view.snapshot = _header->current.load(std::memory_order_acquire);
+		const auto* snapshot = reinterpret_cast<const shared::SnapshotHeader*>(_segment.GetData() + _header->snapshotOffsets[view.snapshot]);
+		view.sequence = snapshot->sequence.load(std::memory_order_acquire);
+		// odd means the publisher lapped us and is rewriting this snapshot, the other one is complete
+		if (view.sequence & 1) {
+			continue;
+		}
+		view.frame = snapshot->frame;
+		view.solarTime = snapshot->solarTime;
+		view.bodyCount = snapshot->bodyCount;
+		view.x = GetComponent(snapshot, _header->bodyCapacity, 0);
+		view.y = GetComponent(snapshot, _header->bodyCapacity, 1);
+		view.z = GetComponent(snapshot, _header->bodyCapacity, 2);
+		return view;
+	}
+}
+
+bool SharedStateReader::Validate(const SharedStateView& view) const {
+	if (!_header) {
+		return false;
+	}
+	const auto* snapshot = reinterpret_cast<const shared::SnapshotHeader*>(_segment.GetData() + _header->snapshotOffsets[view.snapshot]);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return snapshot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+uint32_t SharedStateReader::GetBodyCount() const {
+	return _header ? _header->bodyCount : 0;
+}
+
+std::string SharedStateReader::GetBodyName(uint32_t index) const {
+	if (!_header || index >= _header->bodyCount) {
+		return {};
+	}
+	const char* nameSlot = reinterpret_cast<const char*>(_segment.GetData() + _header->namesOffset) + size_t(index) * shared::kNameLength;
+	return std::string(nameSlot, strnlen(nameSlot, shared::kNameLength));
+}
+
+int32_t SharedStateReader::GetBodyParent(uint32_t index) const {
+	if (!_header || index >= _header->bodyCount) {
+		return -1;
+	}
+	return reinterpret_cast<const int32_t*>(_segment.GetData() + _header->parentsOffset)[index];
+}
+
+double SharedStateReader::GetBodyRadius(uint32_t index) const {
+	if (!_header || index >= _header->bodyCount) {
+		return 0.0;
+	}
+	return reinterpret_cast<const double*>(_segment.GetData() + _header->radiiOffset)[index];
+}
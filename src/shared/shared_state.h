@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Live simulation state published into a named shared memory segment for tools running next to steorra.
+// The segment holds two SoA snapshots, each guarded by its own sequence counter (a seqlock). The publisher always
+// writes the snapshot readers are not pointed at and then flips to it, so it never waits on readers, and readers
+// never make a syscall after Open.
+//
+// Reading without copies:
+//	SharedStateReader reader;
+//	reader.Open();
+//	SharedStateView view;
+//	do {
+//		view = reader.Begin();
+//		... read view.x[i], view.y[i], view.z[i] ...
+//	} while (!reader.Validate(view));
+
+namespace shared {
+	constexpr const char* kDefaultSegmentName = "steorra_state";
+	constexpr uint32_t kVersion = 2;
+	constexpr uint32_t kNameLength = 32;
+
+	struct SegmentHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t bodyCapacity;
+		uint32_t bodyCount;
+		uint32_t publisherProcess; // a segment left by a crashed run names a process that is gone
+		std::atomic<uint32_t> current; // snapshot readers should use
+		std::atomic<uint32_t> publisherAlive;
+		uint64_t snapshotOffsets[2];
+		uint64_t namesOffset;
+		uint64_t parentsOffset;
+		uint64_t radiiOffset;
+		uint64_t segmentSize;
+	};
+
+	// followed by bodyCapacity doubles each of x, y and z (metres, J2000 ecliptic, heliocentric)
+	struct SnapshotHeader {
+		std::atomic<uint64_t> sequence; // odd while the snapshot is being written
+		uint64_t frame;
+		double solarTime; // Julian date
+		uint32_t bodyCount;
+		uint32_t padding;
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+		"the seqlock needs address-free atomics to work across processes");
+
+	size_t GetSegmentSize(uint32_t bodyCapacity);
+}
+
+// Platform shared memory, POSIX shm or a named Windows file mapping
+class SharedSegment {
+public:
+	SharedSegment() = default;
+	~SharedSegment();
+	SharedSegment(const SharedSegment&) = delete;
+	SharedSegment& operator=(const SharedSegment&) = delete;
+	// fails if a segment of that name already exists
+	bool Create(const std::string& name, size_t size);
+	bool OpenExisting(const std::string& name);
+	// unlinks a segment left behind by a publisher that is gone, nothing to do on Windows where it dies with its handles
+	static void Remove(const std::string& name);
+	void Close();
+	uint8_t* GetData() const;
+	size_t GetSize() const;
+private:
+	uint8_t* _data = nullptr;
+	size_t _size = 0;
+	std::string _name;
+	bool _owner = false;
+#ifdef _WIN32
+	void* _mapping = nullptr;
+#endif
+};
+
+// static per body data, written once when the segment is created
+struct SharedBodyInfo {
+	std::string name;
+	int32_t parent; // index of the parent body, -1 for none
+	double radius; // metres
+};
+
+class SharedStatePublisher {
+public:
+	// fails if a live publisher already owns the name, a segment left by a crashed run is replaced
+	bool Open(const std::string& name, std::span<const SharedBodyInfo> bodies);
+	void Close();
+	bool IsOpen() const;
+	// fills the back snapshot through write(x, y, z) and makes it current
+	template<typename F>
+	void Publish(uint64_t frame, double solarTime, F&& write) {
+		shared::SnapshotHeader* snapshot = BeginWrite(frame, solarTime);
+		write(GetX(snapshot), GetY(snapshot), GetZ(snapshot));
+		EndWrite(snapshot);
+	}
+private:
+	shared::SnapshotHeader* BeginWrite(uint64_t frame, double solarTime);
+	void EndWrite(shared::SnapshotHeader* snapshot);
+	double* GetX(shared::SnapshotHeader* snapshot) const;
+	double* GetY(shared::SnapshotHeader* snapshot) const;
+	double* GetZ(shared::SnapshotHeader* snapshot) const;
+	SharedSegment _segment;
+	shared::SegmentHeader* _header = nullptr;
+	uint32_t _back = 0;
+};
+
+struct SharedStateView {
+	uint64_t frame;
+	double solarTime;
+	uint32_t bodyCount;
+	const double* x;
+	const double* y;
+	const double* z;
+	uint32_t snapshot;
+	uint64_t sequence;
+};
+
+class SharedStateReader {
+public:
+	bool Open(const std::string& name = shared::kDefaultSegmentName);
+	void Close();
+	bool IsOpen() const;
+	bool IsPublisherAlive() const;
+	// a view of the latest snapshot, only trust what was read from it once Validate returns true
+	SharedStateView Begin() const;
+	bool Validate(const SharedStateView& view) const;
+	uint32_t GetBodyCount() const;
+	std::string GetBodyName(uint32_t index) const;
+	int32_t GetBodyParent(uint32_t index) const;
+	double GetBodyRadius(uint32_t index) const;
+private:
+	SharedSegment _segment;
+	const shared::SegmentHeader* _header = nullptr;
+};
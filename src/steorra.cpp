@@ -1,9 +1,335 @@
 ﻿#include <SDL3/SDL_main.h>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
 #include "game.h"
+#include "dynamics/dynamics_export.h"
+#include "util/util_jobs.h"
+#include "util/util_asset_pack.h"
 
+static void PrintUsage() {
+	std::cout << "usage: steorra [options]\n"
+		<< "  --headless            render offscreen without a window\n"
+		<< "  --frames <n>          number of frames to render when headless (default 600)\n"
+		<< "  --output <path>       headless output, a directory for png or a file for raw/y4m\n"
+		<< "  --format <fmt>        raw, png or y4m (default png)\n"
+		<< "  --start <jd>          start time as a Julian date\n"
+		<< "  --step <days>         simulated days per headless frame\n"
+		<< "  --size <w>x<h>        render size (default 1280x960)\n"
+		<< "  --record <file>       capture per frame input and time\n"
+		<< "  --replay <file>       play a capture back at its recorded pace\n"
+		<< "  --replay-fast         play the capture back as fast as possible\n"
+		<< "  --timings <file>      write per frame CPU/GPU times as CSV\n"
+		<< "  --publish <name>      publish live body positions to a shared memory segment (e.g. steorra_state)\n"
+		<< "  --mixed-precision     evaluate satellites in float SIMD (toggle with F6)\n"
+		<< "  --trace <file>        write the profiled frames as a Chrome trace on exit (overlay with F3)\n"
+		<< "  --memory-report <file> write heap and GPU memory statistics as JSON on exit (overlay with F4)\n"
+		<< "  --warmup <n>          frames before the allocation counts are steady state (default 60)\n"
+		<< "  --assert-zero-alloc   fail if a steady state frame allocates, needs STEORRA_TRACK_ALLOCATIONS\n"
+		<< "  --threads <n>         job system threads including the main thread (default one per hardware thread)\n"
+		<< "  --present-mode <mode> fifo, mailbox or immediate (default fifo, cycle with F7)\n"
+		<< "  --low-latency         wait for the frame slot before sampling input (toggle with F9)\n"
+		<< "  --fps-cap <n>         limit the frame rate, sleeping then spinning to each frame's start\n"
+		<< "\n"
+		<< "usage: steorra export --output <file> [options]\n"
+		<< "  --bodies <a,b,...>    bodies to export (default all)\n"
+		<< "  --start <jd>          first sample as a Julian date (default 2451545.0)\n"
+		<< "  --end <jd>            last sample as a Julian date (default a year after the start)\n"
+		<< "  --step <days>         time between samples (default 1/24)\n"
+		<< "  --format <fmt>        bin (columnar) or csv (default bin)\n"
+		<< "  --velocities          also export velocities\n"
+		<< "  --threads <n>         threads evaluating samples (default one per hardware thread)\n"
+		<< "\n"
+		<< "usage: steorra bench-jobs [options]\n"
+		<< "  --threads <n>         highest thread count to measure (default one per hardware thread)\n"
+		<< "  --samples <n>         ephemeris samples evaluated per run (default 20000)\n"
+		<< "\n"
+		<< "usage: steorra bake [options]\n"
+		<< "  --output <file>       asset pack to write (default assets/steorra.pack)\n";
+}
+
+static bool ParseExportOptions(int argc, char* args[], EphemerisExportOptions& options, uint32_t& threadCount) {
+	bool endSet = false;
+	for (int i = 2; i < argc; i++) {
+		std::string arg = args[i];
+		const char* value = (i + 1 < argc) ? args[i + 1] : nullptr;
+		if (arg == "--velocities") {
+			options.velocities = true;
+			continue;
+		}
+		if (!value) {
+			return false;
+		}
+		i++;
+		if (arg == "--bodies") {
+			std::string_view list = value;
+			while (!list.empty()) {
+				size_t comma = std::min(list.find(','), list.size());
+				if (comma > 0) {
+					options.bodies.emplace_back(list.substr(0, comma));
+				}
+				list.remove_prefix(std::min(comma + 1, list.size()));
+			}
+		} else if (arg == "--start") {
+			options.startTime = std::stod(value);
+		} else if (arg == "--end") {
+			options.endTime = std::stod(value);
+			endSet = true;
+		} else if (arg == "--step") {
+			options.step = std::stod(value);
+		} else if (arg == "--output") {
+			options.outputPath = value;
+		} else if (arg == "--threads") {
+			threadCount = std::stoul(value);
+		} else if (arg == "--format") {
+			if (std::strcmp(value, "bin") == 0) {
+				options.format = EphemerisFormat::Binary;
+			} else if (std::strcmp(value, "csv") == 0) {
+				options.format = EphemerisFormat::Csv;
+			} else {
+				return false;
+			}
+		} else {
+			return false;
+		}
+	}
+	if (!endSet) {
+		options.endTime = options.startTime + 365.25;
+	}
+	return !options.outputPath.empty();
+}
+
+static int RunExport(int argc, char* args[]) {
+	EphemerisExportOptions options;
+	uint32_t threadCount = 0;
+	try {
+		if (!ParseExportOptions(argc, args, options, threadCount)) {
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	} catch (const std::exception&) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+	// no window or device, only the orbit tables
+	JobSystem jobs(threadCount);
+	SolarSystem system(&jobs);
+	return ExportEphemeris(system, options, &jobs) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Times ephemeris evaluation of every body over a run of samples with 1 to N threads
+static int RunJobScaling(int argc, char* args[]) {
+	uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	size_t sampleCount = 20000;
+	try {
+		for (int i = 2; i < argc; i++) {
+			std::string arg = args[i];
+			if (i + 1 >= argc) {
+				PrintUsage();
+				return EXIT_FAILURE;
+			}
+			const char* value = args[++i];
+			if (arg == "--threads") {
+				maxThreads = std::max<uint32_t>(1, (uint32_t)std::stoul(value));
+			} else if (arg == "--samples") {
+				sampleCount = std::stoull(value);
+			} else {
+				PrintUsage();
+				return EXIT_FAILURE;
+			}
+		}
+	} catch (const std::exception&) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+	SolarSystem system;
+	const double startTime = 2451545.0;
+	double baseline = 0.0;
+	std::cout << "threads,ms,speedup,efficiency" << std::endl;
+	for (uint32_t threads = 1; threads <= maxThreads; threads++) {
+		JobSystem jobs(threads);
+		std::vector<glm::dvec3> sums(sampleCount);
+		const auto start = std::chrono::steady_clock::now();
+		jobs.ParallelFor(0, sampleCount, 64, [&](size_t first, size_t last) {
+			std::vector<glm::dvec3> positions;
+			for (size_t s = first; s < last; s++) {
+				system.GetRelativePositions(startTime + double(s) / 24.0, positions, false);
+				glm::dvec3 sum(0.0);
+				for (const glm::dvec3& position : positions) {
+					sum += position;
+				}
+				sums[s] = sum;
+			}
+		});
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (threads == 1) {
+			baseline = ms;
+		}
+		const double speedup = baseline / ms;
+		std::cout << threads << "," << ms << "," << speedup << "," << speedup / threads << std::endl;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Bakes the body records, every glTF in assets and the compiled shaders into one pack that Game maps at startup. Each
+// entry keeps a stamp of its sources, so the game falls back to a loose file edited after the bake.
+static int RunBake(int argc, char* args[]) {
+	const std::filesystem::path assets = std::filesystem::current_path() / "assets";
+	std::filesystem::path outputPath = assets / "steorra.pack";
+	for (int i = 2; i < argc; i++) {
+		if (std::strcmp(args[i], "--output") == 0 && i + 1 < argc) {
+			outputPath = args[++i];
+		} else {
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+	JobSystem jobs;
+	AssetPackWriter writer;
+	// always from the tables, never from a previous pack
+	const std::vector<BodyRecord> bodies = SolarSystem(&jobs).GetRecords();
+	writer.AddArray<BodyRecord>("dynamics/bodies", bodies, GetBodySourceStamp(assets));
+	for (const auto& entry : std::filesystem::directory_iterator(assets)) {
+		if (entry.path().extension() != ".glb") {
+			continue;
+		}
+		std::vector<DecodedMesh> meshes;
+		if (!DecodeGltfMeshes(entry.path(), jobs, meshes)) {
+			return EXIT_FAILURE;
+		}
+		writer.Add("meshes/" + entry.path().filename().string(), PackMeshes(meshes), GetSourceStamp({ entry.path() }));
+		std::cout << "Baked " << meshes.size() << " meshes from " << entry.path().filename() << std::endl;
+	}
+	size_t shaderCount = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(assets / "shaders")) {
+		if (entry.path().extension() != ".spv") {
+			continue;
+		}
+		std::ifstream file(entry.path(), std::ios::binary);
+		const std::vector<uint8_t> code((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		writer.Add("shaders/" + entry.path().filename().string(), code, GetSourceStamp({ entry.path() }));
+		shaderCount++;
+	}
+	std::cout << "Baked " << bodies.size() << " bodies and " << shaderCount << " shaders" << std::endl;
+	if (!writer.Write(outputPath, kAssetPackLayout)) {
+		return EXIT_FAILURE;
+	}
+	std::cout << "Wrote " << outputPath << std::endl;
+	return EXIT_SUCCESS;
+}
+
+static bool ParseOptions(int argc, char* args[], GameOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = args[i];
+		// every option except the flags takes a value
+		const char* value = (i + 1 < argc) ? args[i + 1] : nullptr;
+		if (arg == "--headless") {
+			options.headless = true;
+			continue;
+		}
+		if (arg == "--replay-fast") {
+			options.replayFast = true;
+			continue;
+		}
+		if (arg == "--mixed-precision") {
+			options.mixedPrecision = true;
+			continue;
+		}
+		if (arg == "--assert-zero-alloc") {
+			options.assertZeroAlloc = true;
+			continue;
+		}
+		if (arg == "--low-latency") {
+			options.lowLatency = true;
+			continue;
+		}
+		if (!value) {
+			return false;
+		}
+		i++;
+		if (arg == "--frames") {
+			options.frameCount = std::stoull(value);
+		} else if (arg == "--output") {
+			options.outputPath = value;
+		} else if (arg == "--format") {
+			if (std::strcmp(value, "raw") == 0) {
+				options.outputFormat = FrameFormat::Raw;
+			} else if (std::strcmp(value, "png") == 0) {
+				options.outputFormat = FrameFormat::Png;
+			} else if (std::strcmp(value, "y4m") == 0) {
+				options.outputFormat = FrameFormat::Y4m;
+			} else {
+				return false;
+			}
+		} else if (arg == "--start") {
+			options.startTime = std::stod(value);
+		} else if (arg == "--step") {
+			options.timeStep = std::stod(value);
+		} else if (arg == "--record") {
+			options.recordPath = value;
+		} else if (arg == "--replay") {
+			options.replayPath = value;
+		} else if (arg == "--timings") {
+			options.timingsPath = value;
+		} else if (arg == "--publish") {
+			options.publishName = value;
+		} else if (arg == "--trace") {
+			options.tracePath = value;
+		} else if (arg == "--memory-report") {
+			options.memoryReportPath = value;
+		} else if (arg == "--warmup") {
+			options.warmupFrames = std::stoull(value);
+		} else if (arg == "--threads") {
+			options.threadCount = std::stoul(value);
+		} else if (arg == "--present-mode") {
+			if (!ParsePresentMode(value, options.presentMode)) {
+				return false;
+			}
+		} else if (arg == "--fps-cap") {
+			options.frameCap = std::stod(value);
+		} else if (arg == "--size") {
+			unsigned width, height;
+			if (std::sscanf(value, "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+				return false;
+			}
+			options.width = width;
+			options.height = height;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
 
 int main(int argc, char* args[]) {
-	Game game{};
+	if (argc > 1 && std::strcmp(args[1], "export") == 0) {
+		return RunExport(argc, args);
+	}
+	if (argc > 1 && std::strcmp(args[1], "bench-jobs") == 0) {
+		return RunJobScaling(argc, args);
+	}
+	if (argc > 1 && std::strcmp(args[1], "bake") == 0) {
+		return RunBake(argc, args);
+	}
+	GameOptions options;
+	try {
+		if (!ParseOptions(argc, args, options)) {
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	} catch (const std::exception&) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+	if (options.assertZeroAlloc && !kAllocationTracking) {
+		std::cerr << "--assert-zero-alloc needs a build configured with -DSTEORRA_TRACK_ALLOCATIONS=ON\n";
+		return EXIT_FAILURE;
+	}
+	Game game{ options };
 	game.Run();
-	return EXIT_SUCCESS;
+	return game.GetExitCode();
 }
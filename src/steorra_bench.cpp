@@ -0,0 +1,531 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dynamics/dynamics_orbits.h"
+#include "dynamics/dynamics_planets.h"
+#include "dynamics/dynamics_tables.h"
+#include "dynamics/dynamics_universal.h"
+#include "dynamics/dynamics_export.h"
+
+// Microbenchmarks of the dynamics without a window or device. Each benchmark is calibrated to run for a minimum time
+// per sample, and the samples are reported as nanoseconds per operation in JSON so runs can be compared over time.
+// With --accuracy the drivers are checked against Horizons reference states instead, error next to throughput.
+
+namespace {
+	constexpr int kSamples = 7;
+	constexpr double kTrailStartTime = 2461044.5;
+	constexpr int kTrailSteps = 20; // as drawn by Game::DrawGeometry
+
+	struct BenchOptions {
+		std::string filter;
+		double minSampleMs = 20.0;
+		std::string outputPath;
+		std::string referencePath; // accuracy suite instead of the microbenchmarks
+		double toleranceMetres = 1000.0; // a variant may lose this much on any body before it is flagged
+	};
+
+	struct BenchResult {
+		std::string name;
+		uint64_t operations; // per sample
+		std::vector<double> nsPerOp;
+	};
+
+	// SolarSystem logs what it loaded, which would land in the JSON and time the terminal
+	struct NullBuffer : std::streambuf {
+		int overflow(int c) override { return c; }
+	};
+
+	// results feed this so the optimiser cannot drop the work
+	volatile double g_sink;
+
+	void Consume(double value) {
+		g_sink = g_sink + value;
+	}
+
+	void Consume(const glm::dvec3& value) {
+		Consume(value.x + value.y + value.z);
+	}
+
+	class Bench {
+	public:
+		explicit Bench(const BenchOptions& options) : _options(options) {}
+		// run does operationsPerRun operations each call, returns the median ns per operation (zero when filtered out)
+		double Run(const std::string& name, uint64_t operationsPerRun, const std::function<void()>& run) {
+			if (!_options.filter.empty() && name.find(_options.filter) == std::string::npos) {
+				return 0.0;
+			}
+			using Clock = std::chrono::steady_clock;
+			// double the runs per sample until one sample takes long enough to time reliably
+			uint64_t runs = 1;
+			while (true) {
+				const auto start = Clock::now();
+				for (uint64_t i = 0; i < runs; i++) {
+					run();
+				}
+				const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+				if (ms >= _options.minSampleMs || runs >= (1ull << 40)) {
+					break;
+				}
+				runs *= 2;
+			}
+			BenchResult result{ name, runs * operationsPerRun, {} };
+			for (int s = 0; s < kSamples; s++) {
+				const auto start = Clock::now();
+				for (uint64_t i = 0; i < runs; i++) {
+					run();
+				}
+				const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+				result.nsPerOp.push_back(ns / double(result.operations));
+			}
+			std::vector<double> sorted = result.nsPerOp;
+			std::sort(sorted.begin(), sorted.end());
+			const double median = sorted[sorted.size() / 2];
+			std::cerr << name << ": " << median << " ns/op" << std::endl;
+			_results.push_back(std::move(result));
+			return median;
+		}
+		// sections are extra members of the top level object, each starting with its key
+		void WriteJson(std::ostream& stream, const std::string& sections) const {
+			stream << "{\n";
+			stream << "  \"context\": {\n";
+			stream << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+			stream << "    \"build\": \"release\",\n";
+#else
+			stream << "    \"build\": \"debug\",\n";
+#endif
+			stream << "    \"samples\": " << kSamples << ",\n";
+			stream << "    \"min_sample_ms\": " << _options.minSampleMs << "\n";
+			stream << "  },\n";
+			stream << "  \"benchmarks\": [";
+			for (size_t i = 0; i < _results.size(); i++) {
+				const BenchResult& result = _results[i];
+				std::vector<double> sorted = result.nsPerOp;
+				std::sort(sorted.begin(), sorted.end());
+				double mean = 0.0;
+				for (double ns : sorted) {
+					mean += ns;
+				}
+				mean /= double(sorted.size());
+				double variance = 0.0;
+				for (double ns : sorted) {
+					variance += (ns - mean) * (ns - mean);
+				}
+				const double stddev = std::sqrt(variance / double(sorted.size()));
+				stream << (i ? ",\n" : "\n");
+				stream << "    { \"name\": \"" << result.name << "\", \"operations\": " << result.operations
+					<< ", \"median_ns\": " << sorted[sorted.size() / 2] << ", \"mean_ns\": " << mean
+					<< ", \"min_ns\": " << sorted.front() << ", \"max_ns\": " << sorted.back()
+					<< ", \"stddev_ns\": " << stddev << " }";
+			}
+			stream << "\n  ]" << sections << "\n}\n";
+		}
+	private:
+		BenchOptions _options;
+		std::vector<BenchResult> _results;
+	};
+
+	// the walk Game::DrawSubsystem makes with nothing culled, each body placed relative to its parent
+	void WalkSubsystem(const SolarBody& body, const glm::dvec3& position, double time, const glm::dvec3* relativePositions) {
+		Consume(position);
+		for (const SolarBody* satellite : body.GetSatellites()) {
+			const glm::dvec3 offset = relativePositions ? relativePositions[satellite->GetIndex()] : satellite->GetRelativePositionAtTime(time);
+			WalkSubsystem(*satellite, position + offset, time, relativePositions);
+		}
+	}
+
+	void PrintUsage() {
+		std::cout << "usage: steorra_bench [options]\n"
+			<< "  --output <file>       write the results as JSON (default stdout)\n"
+			<< "  --filter <text>       only run benchmarks whose name contains the text\n"
+			<< "  --min-time <ms>       minimum time per sample (default 20)\n"
+			<< "  --accuracy <file>     compare the drivers against reference states from py/get_data.py instead\n"
+			<< "  --tolerance <metres>  error a variant may add on any body before it is flagged (default 1000)\n";
+	}
+
+	bool ParseOptions(int argc, char* args[], BenchOptions& options) {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = args[i];
+			if (i + 1 >= argc) {
+				return false;
+			}
+			const char* value = args[++i];
+			if (arg == "--output") {
+				options.outputPath = value;
+			} else if (arg == "--filter") {
+				options.filter = value;
+			} else if (arg == "--min-time") {
+				options.minSampleMs = std::stod(value);
+			} else if (arg == "--accuracy") {
+				options.referencePath = value;
+			} else if (arg == "--tolerance") {
+				options.toleranceMetres = std::stod(value);
+			} else {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	int RunBenchmarks(Bench& bench) {
+		// table parsing and construction read assets/data like the game does
+		for (const char* table : { "PlanetOrbits.csv", "SatelliteOrbits.csv", "SatelliteConstants.csv" }) {
+			bench.Run(std::string("parse/") + table, 1, [&] {
+				TableView view(table);
+				Consume(double(view.GetRowCount()));
+			});
+		}
+		// a catalogue far larger than the shipped tables, parsing and joining it should stay in milliseconds
+		constexpr size_t kCatalogRows = 50000;
+		const std::filesystem::path catalogPath = std::filesystem::temp_directory_path() / "steorra_bench_catalog.csv";
+		{
+			std::ofstream catalog(catalogPath);
+			catalog << "Planet,Satellite,Code,Frame,Epoch,a,e,w,M,i,node,P,\n";
+			for (size_t row = 0; row < kCatalogRows; row++) {
+				catalog << "Jupiter,S" << row << "," << 1000000 + row << ",ecliptic,2000-01-01.5," << 1e6 + double(row) * 17.0 << ",0.0554,318.15,135.27,5.16,125.08,27.322,\n";
+			}
+		}
+		bench.Run("parse/catalog_50k", 1, [&] {
+			TableView view(catalogPath.string());
+			Consume(view.GetCellValue(5, view.GetRowCount() - 1));
+		});
+		{
+			TableView catalog(catalogPath.string());
+			bench.Run("join/catalog_50k", 1, [&] {
+				TableIndex index(catalog, 1, 1);
+				for (size_t row = 1; row < catalog.GetRowCount(); row++) {
+					Consume(double(index.Find(catalog.GetCell(1, row))));
+				}
+			});
+		}
+		std::filesystem::remove(catalogPath);
+		bench.Run("construct/solar_system", 1, [] {
+			SolarSystem system;
+			Consume(double(system.bodies.size()));
+		});
+
+		SolarSystem system;
+		if (system.bodies.empty()) {
+			std::cerr << "No bodies loaded, run from the directory containing assets/data\n";
+			return EXIT_FAILURE;
+		}
+
+		// eccentricities and mean anomalies spread over the range the satellites and planets cover
+		constexpr size_t kKeplerInputs = 1024;
+		std::vector<double> eccentricities(kKeplerInputs), meanAnomalies(kKeplerInputs);
+		for (size_t i = 0; i < kKeplerInputs; i++) {
+			eccentricities[i] = 0.9 * double(i % 97) / 96.0;
+			meanAnomalies[i] = 6.283185307179586 * double(i) / double(kKeplerInputs);
+		}
+		bench.Run("kepler/solve", kKeplerInputs, [&] {
+			for (size_t i = 0; i < kKeplerInputs; i++) {
+				Consume(GetEccentricAnomaly(eccentricities[i], meanAnomalies[i]));
+			}
+		});
+
+		// hourly samples, so each run evaluates the elements at different times
+		constexpr int kBodySamples = 64;
+		for (const auto& body : system.bodies) {
+			if (!body->GetDriver()) {
+				continue;
+			}
+			bench.Run("body/" + body->GetName(), kBodySamples, [&] {
+				for (int i = 0; i < kBodySamples; i++) {
+					Consume(body->GetRelativePositionAtTime(kTrailStartTime + i / 24.0));
+				}
+			});
+		}
+
+		// the same planets through the virtual drivers and through the generated tables
+		std::vector<glm::dvec3> planetPositions(kPlanetCount);
+		bench.Run("planets/virtual", kBodySamples * kPlanetCount, [&] {
+			for (int i = 0; i < kBodySamples; i++) {
+				for (size_t p = 0; p < kPlanetCount; p++) {
+					planetPositions[p] = system.bodies[1 + p]->GetRelativePositionAtTime(kTrailStartTime + i / 24.0);
+				}
+				Consume(planetPositions[0]);
+			}
+		});
+		bench.Run("planets/constant", kBodySamples * kPlanetCount, [&] {
+			for (int i = 0; i < kBodySamples; i++) {
+				GetConstantPlanetPositions(kTrailStartTime + i / 24.0, planetPositions.data());
+				Consume(planetPositions[0]);
+			}
+		});
+
+		std::vector<glm::dvec3> positions;
+		for (bool mixedPrecision : { false, true }) {
+			const std::string suffix = mixedPrecision ? "_mixed" : "";
+			bench.Run("system/relative_positions" + suffix, 1, [&] {
+				system.GetRelativePositions(kTrailStartTime, positions, mixedPrecision);
+				Consume(positions[1]);
+			});
+			// every trail step of a frame, double evaluates lazily during the walk and mixed up front per step
+			bench.Run("trail/draw_geometry" + suffix, kTrailSteps, [&] {
+				for (int i = 0; i < kTrailSteps; i++) {
+					const double time = kTrailStartTime + i;
+					const glm::dvec3* relativePositions = nullptr;
+					if (mixedPrecision) {
+						system.GetRelativePositions(time, positions, true);
+						relativePositions = positions.data();
+					}
+					WalkSubsystem(*system.sun, system.sun->GetPositionAtTime(time), time, relativePositions);
+				}
+			});
+		}
+
+		// the float Kepler batch the satellites use, next to a catalogue of synthetic comets through the universal driver
+		// one at a time and in lanes. Eccentricities straddle e = 1 like long period and interstellar comets.
+		const SatelliteBatch& satellites = system.GetSatelliteBatch();
+		positions.resize(system.bodies.size());
+		if (satellites.GetCount() > 0) {
+			bench.Run("batch/satellites_kepler", satellites.GetCount(), [&] {
+				satellites.Evaluate(kTrailStartTime, positions.data());
+				Consume(positions[satellites.GetBodyIndex(0)]);
+			});
+		}
+		constexpr size_t kComets = 4096;
+		constexpr double kMetresPerAu = 1.495978707e11;
+		UniversalOrbitBatch comets(system.sun->GetGravitationalParameter());
+		std::vector<UniversalOrbit> cometOrbits;
+		cometOrbits.reserve(kComets);
+		for (size_t i = 0; i < kComets; i++) {
+			const double t = double(i) / double(kComets);
+			const UniversalElements elements{ kMetresPerAu * (0.3 + 5.0 * t), 0.9 + 0.2 * double(i % 101) / 100.0,
+				double(i % 37) * 0.17, double(i % 23) * 0.13, double(i % 29) * 0.21, kTrailStartTime + 2000.0 * (t - 0.5) };
+			comets.Add(elements);
+			cometOrbits.emplace_back(system.sun, elements);
+		}
+		std::vector<glm::dvec3> cometPositions(kComets);
+		bench.Run("batch/comets_universal_scalar", kComets, [&] {
+			for (size_t i = 0; i < kComets; i++) {
+				cometPositions[i] = cometOrbits[i].GetRelativePositionAtTime(kTrailStartTime);
+			}
+			Consume(cometPositions[0]);
+		});
+		bench.Run("batch/comets_universal", kComets, [&] {
+			comets.Evaluate(kTrailStartTime, cometPositions.data());
+			Consume(cometPositions[0]);
+		});
+			return EXIT_SUCCESS;
+	}
+
+	const char* GetDriverKind(const SolarBody& body) {
+		const SolarBodyDriver* driver = body.GetDriver();
+		if (dynamic_cast<const VaryingKeplerOrbit*>(driver)) {
+			return "varying_kepler";
+		}
+		if (dynamic_cast<const KeplerOrbit*>(driver)) {
+			return "kepler";
+		}
+		if (dynamic_cast<const UniversalOrbit*>(driver)) {
+			return "universal";
+		}
+		return driver ? "other" : "fixed";
+	}
+
+	struct BodyError {
+		double max = 0.0;
+		double sumSquares = 0.0;
+	};
+
+	struct Variant {
+		const char* name;
+		// heliocentric position of every body at a time, indexed like SolarSystem::bodies
+		std::function<void(double time, std::vector<glm::dvec3>& positions)> evaluate;
+		std::vector<BodyError> errors; // per reference body
+		double maxError = 0.0;
+		double rmsError = 0.0;
+		double evaluationsPerSecond = 0.0;
+		bool pareto = true;
+		bool flagged = false;
+	};
+
+	// Every evaluation path against the reference over its date grid. A variant is flagged when any body's worst error
+	// grows past the tolerance over the double path's, the Pareto column marks the variants nothing beats on both
+	// error and speed.
+	int RunAccuracy(Bench& bench, SolarSystem& system, const BenchOptions& options, std::string& sections) {
+		EphemerisData reference;
+		if (!ReadEphemeris(options.referencePath, reference)) {
+			std::cerr << "Generate reference states with: python get_data.py reference ../assets/data/HorizonsReference.bin\n";
+			return EXIT_FAILURE;
+		}
+		std::vector<uint32_t> bodyIndices; // reference body to SolarSystem::bodies
+		std::vector<size_t> referenceIndices;
+		for (size_t b = 0; b < reference.bodies.size(); b++) {
+			if (const SolarBody* body = system.GetBody(reference.bodies[b])) {
+				bodyIndices.push_back(body->GetIndex());
+				referenceIndices.push_back(b);
+			} else {
+				std::cerr << "Reference body not in the model: " << reference.bodies[b] << "\n";
+			}
+		}
+		if (bodyIndices.empty() || reference.times.empty()) {
+			std::cerr << "No reference bodies to compare\n";
+			return EXIT_FAILURE;
+		}
+
+		// parents always come before their satellites, so relative positions sum in one pass
+		const size_t bodyCount = system.bodies.size();
+		std::vector<int32_t> parents(bodyCount, -1);
+		for (size_t i = 0; i < bodyCount; i++) {
+			if (const SolarBody* parent = system.bodies[i]->GetParent()) {
+				parents[i] = int32_t(parent->GetIndex());
+			}
+		}
+		auto sumHierarchy = [&](std::vector<glm::dvec3>& positions) {
+			for (size_t i = 0; i < bodyCount; i++) {
+				if (parents[i] >= 0) {
+					positions[i] += positions[parents[i]];
+				}
+			}
+		};
+		std::vector<Variant> variants;
+		variants.push_back({ "double", [&](double time, std::vector<glm::dvec3>& positions) {
+			system.GetRelativePositions(time, positions, false);
+			sumHierarchy(positions);
+		} });
+		variants.push_back({ "mixed", [&](double time, std::vector<glm::dvec3>& positions) {
+			system.GetRelativePositions(time, positions, true);
+			sumHierarchy(positions);
+		} });
+		// what the export does, every body walks its own parents
+		variants.push_back({ "per_body", [&](double time, std::vector<glm::dvec3>& positions) {
+			positions.resize(bodyCount);
+			for (size_t i = 0; i < bodyCount; i++) {
+				positions[i] = system.bodies[i]->GetPositionAtTime(time);
+			}
+		} });
+
+		std::vector<glm::dvec3> positions;
+		const size_t sampleCount = reference.times.size();
+		for (Variant& variant : variants) {
+			variant.errors.assign(bodyIndices.size(), {});
+			double sumSquares = 0.0;
+			for (size_t s = 0; s < sampleCount; s++) {
+				variant.evaluate(reference.times[s], positions);
+				for (size_t b = 0; b < bodyIndices.size(); b++) {
+					const double error = glm::length(positions[bodyIndices[b]] - reference.GetPosition(referenceIndices[b], s));
+					variant.errors[b].max = std::max(variant.errors[b].max, error);
+					variant.errors[b].sumSquares += error * error;
+					variant.maxError = std::max(variant.maxError, error);
+					sumSquares += error * error;
+				}
+			}
+			variant.rmsError = std::sqrt(sumSquares / double(sampleCount * bodyIndices.size()));
+			const double ns = bench.Run(std::string("accuracy/") + variant.name, sampleCount * bodyCount, [&] {
+				for (size_t s = 0; s < sampleCount; s++) {
+					variant.evaluate(reference.times[s], positions);
+					Consume(positions[bodyIndices[0]]);
+				}
+			});
+			variant.evaluationsPerSecond = ns > 0.0 ? 1e9 / ns : 0.0;
+		}
+		int result = EXIT_SUCCESS;
+		for (Variant& variant : variants) {
+			for (const Variant& other : variants) {
+				const bool noWorse = other.maxError <= variant.maxError && other.evaluationsPerSecond >= variant.evaluationsPerSecond;
+				const bool better = other.maxError < variant.maxError || other.evaluationsPerSecond > variant.evaluationsPerSecond;
+				if (&other != &variant && noWorse && better) {
+					variant.pareto = false;
+				}
+			}
+			for (size_t b = 0; b < bodyIndices.size(); b++) {
+				if (variant.errors[b].max > variants[0].errors[b].max + options.toleranceMetres) {
+					variant.flagged = true;
+				}
+			}
+			if (variant.flagged) {
+				result = EXIT_FAILURE;
+			}
+		}
+
+		std::cerr << "\nbody, driver";
+		for (const Variant& variant : variants) {
+			std::cerr << ", " << variant.name << " max m, " << variant.name << " rms m";
+		}
+		std::cerr << "\n";
+		for (size_t b = 0; b < bodyIndices.size(); b++) {
+			const SolarBody& body = *system.bodies[bodyIndices[b]];
+			std::cerr << body.GetName() << ", " << GetDriverKind(body);
+			for (const Variant& variant : variants) {
+				std::cerr << ", " << variant.errors[b].max << ", " << std::sqrt(variant.errors[b].sumSquares / double(sampleCount));
+			}
+			std::cerr << "\n";
+		}
+		std::cerr << "\nvariant, max error m, rms error m, evaluations/s, pareto, flagged\n";
+		for (const Variant& variant : variants) {
+			std::cerr << variant.name << ", " << variant.maxError << ", " << variant.rmsError << ", " << variant.evaluationsPerSecond
+				<< ", " << (variant.pareto ? "yes" : "no") << ", " << (variant.flagged ? "TOO INACCURATE" : "no") << "\n";
+		}
+
+		std::ostringstream json;
+		json << ",\n  \"accuracy\": {\n";
+		json << "    \"reference\": \"" << options.referencePath << "\", \"samples\": " << sampleCount << ", \"tolerance_m\": " << options.toleranceMetres << ",\n";
+		json << "    \"variants\": [";
+		for (size_t v = 0; v < variants.size(); v++) {
+			const Variant& variant = variants[v];
+			json << (v ? ",\n" : "\n");
+			json << "      { \"name\": \"" << variant.name << "\", \"max_error_m\": " << variant.maxError << ", \"rms_error_m\": " << variant.rmsError
+				<< ", \"evaluations_per_second\": " << variant.evaluationsPerSecond << ", \"pareto\": " << (variant.pareto ? "true" : "false")
+				<< ", \"flagged\": " << (variant.flagged ? "true" : "false") << ",\n        \"bodies\": [";
+			for (size_t b = 0; b < bodyIndices.size(); b++) {
+				const SolarBody& body = *system.bodies[bodyIndices[b]];
+				json << (b ? ",\n" : "\n");
+				json << "          { \"name\": \"" << body.GetName() << "\", \"driver\": \"" << GetDriverKind(body) << "\", \"max_error_m\": " << variant.errors[b].max
+					<< ", \"rms_error_m\": " << std::sqrt(variant.errors[b].sumSquares / double(sampleCount)) << " }";
+			}
+			json << "\n        ] }";
+		}
+		json << "\n    ]\n  }";
+		sections = json.str();
+		return result;
+	}
+}
+
+int main(int argc, char* args[]) {
+	BenchOptions options;
+	try {
+		if (!ParseOptions(argc, args, options)) {
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	} catch (const std::exception&) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+	Bench bench(options);
+	NullBuffer nullBuffer;
+	std::ostream json(std::cout.rdbuf());
+	std::cout.rdbuf(&nullBuffer);
+
+	std::string sections;
+	int result;
+	if (options.referencePath.empty()) {
+		result = RunBenchmarks(bench);
+	} else {
+		SolarSystem system;
+		result = RunAccuracy(bench, system, options, sections);
+	}
+	if (options.outputPath.empty()) {
+		bench.WriteJson(json, sections);
+		return result;
+	}
+	std::ofstream stream(options.outputPath);
+	bench.WriteJson(stream, sections);
+	if (!stream) {
+		std::cerr << "Could not write benchmark results: " << options.outputPath << "\n";
+		return EXIT_FAILURE;
+	}
+	return result;
+}
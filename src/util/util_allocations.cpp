@@ -0,0 +1,201 @@
+#include "util_allocations.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <imgui.h>
+
+namespace {
+	struct TagCounters {
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> frees{ 0 };
+		std::atomic<uint64_t> liveBytes{ 0 };
+		std::atomic<uint64_t> totalBytes{ 0 };
+	};
+	// constant initialised, so allocations made before main are already counted
+	std::array<TagCounters, size_t(AllocationTag::Count)> g_counters;
+	std::atomic<uint64_t> g_allocationCount{ 0 };
+
+	constexpr std::array<const char*, size_t(AllocationTag::Count)> kTagNames = {
+		"untagged", "tables", "dynamics", "meshes", "graphics", "imgui", "publish",
+	};
+}
+
+#ifdef STEORRA_TRACK_ALLOCATIONS
+namespace {
+	// sits right before every block, offset leads back to what malloc returned
+	struct alignas(16) AllocationHeader {
+		uint64_t size;
+		uint32_t offset;
+		AllocationTag tag;
+	};
+	static_assert(sizeof(AllocationHeader) == 16);
+
+	void* TrackedAllocate(size_t size, size_t alignment) {
+		alignment = std::max(alignment, alignof(AllocationHeader));
+		const size_t padding = alignment > alignof(AllocationHeader) ? alignment : 0;
+		uint8_t* block = static_cast<uint8_t*>(std::malloc(size + sizeof(AllocationHeader) + padding));
+		if (!block) {
+			return nullptr;
+		}
+		const uintptr_t first = reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader);
+		uint8_t* user = reinterpret_cast<uint8_t*>((first + alignment - 1) & ~uintptr_t(alignment - 1));
+		AllocationHeader* header = reinterpret_cast<AllocationHeader*>(user) - 1;
+		header->size = size;
+		header->offset = uint32_t(user - block);
+		header->tag = t_allocationTag;
+		TagCounters& counters = g_counters[size_t(header->tag)];
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+		counters.liveBytes.fetch_add(size, std::memory_order_relaxed);
+		counters.totalBytes.fetch_add(size, std::memory_order_relaxed);
+		g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+		return user;
+	}
+
+	void* TrackedAllocateOrThrow(size_t size, size_t alignment) {
+		void* pointer = TrackedAllocate(size, alignment);
+		if (!pointer) {
+			throw std::bad_alloc();
+		}
+		return pointer;
+	}
+
+	void TrackedFree(void* pointer) {
+		if (!pointer) {
+			return;
+		}
+		const AllocationHeader* header = static_cast<AllocationHeader*>(pointer) - 1;
+		TagCounters& counters = g_counters[size_t(header->tag)];
+		counters.frees.fetch_add(1, std::memory_order_relaxed);
+		counters.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+		std::free(static_cast<uint8_t*>(pointer) - header->offset);
+	}
+}
+
+void* operator new(size_t size) { return TrackedAllocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return TrackedAllocateOrThrow(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return TrackedAllocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return TrackedAllocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return TrackedAllocateOrThrow(size, size_t(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return TrackedAllocateOrThrow(size, size_t(alignment)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return TrackedAllocate(size, size_t(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return TrackedAllocate(size, size_t(alignment)); }
+void operator delete(void* pointer) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+#endif
+
+const char* GetAllocationTagName(AllocationTag tag) {
+	return kTagNames[size_t(tag)];
+}
+
+AllocationCounters GetAllocationCounters(AllocationTag tag) {
+	const TagCounters& counters = g_counters[size_t(tag)];
+	return {
+		.allocations = counters.allocations.load(std::memory_order_relaxed),
+		.frees = counters.frees.load(std::memory_order_relaxed),
+		.liveBytes = counters.liveBytes.load(std::memory_order_relaxed),
+		.totalBytes = counters.totalBytes.load(std::memory_order_relaxed),
+	};
+}
+
+uint64_t GetAllocationCount() {
+	return g_allocationCount.load(std::memory_order_relaxed);
+}
+
+void FrameAllocationLog::SetSteadyStateFrame(uint64_t frame) {
+	_steadyStateFrame = frame;
+}
+
+void FrameAllocationLog::BeginFrame() {
+	_frameStart = GetAllocationCount();
+}
+
+void FrameAllocationLog::EndFrame(uint64_t frame) {
+	// allocations from other threads during the frame count too, there is no way to tell them apart here
+	const uint32_t count = uint32_t(std::min<uint64_t>(GetAllocationCount() - _frameStart, UINT32_MAX));
+	_counts[_frames % kHistory] = count;
+	_frames++;
+	if (frame < _steadyStateFrame) {
+		return;
+	}
+	_maxPerFrame = std::max(_maxPerFrame, count);
+	if (count > 0) {
+		_steadyStateAllocations += count;
+		_steadyStateFramesWithAllocations++;
+		_firstAllocatingFrame = std::min(_firstAllocatingFrame, frame);
+	}
+}
+
+uint64_t FrameAllocationLog::GetSteadyStateAllocations() const {
+	return _steadyStateAllocations;
+}
+
+void FrameAllocationLog::DrawImgui() const {
+	if (!kAllocationTracking) {
+		ImGui::TextUnformatted("Heap tracking is off, configure with -DSTEORRA_TRACK_ALLOCATIONS=ON");
+		return;
+	}
+	std::array<float, kHistory> counts{};
+	const uint64_t samples = std::min<uint64_t>(_frames, kHistory);
+	for (uint64_t i = 0; i < samples; i++) {
+		counts[i] = float(_counts[(_frames - samples + i) % kHistory]);
+	}
+	ImGui::PlotHistogram("Allocations", counts.data(), int(samples), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+	ImGui::Text("Steady state: %llu allocations in %llu frames, at most %u per frame", (unsigned long long)_steadyStateAllocations,
+		(unsigned long long)_steadyStateFramesWithAllocations, _maxPerFrame);
+	if (ImGui::BeginTable("Heap", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Tag");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableSetupColumn("Frees");
+		ImGui::TableSetupColumn("Live KiB");
+		ImGui::TableSetupColumn("Total KiB");
+		ImGui::TableHeadersRow();
+		for (size_t t = 0; t < size_t(AllocationTag::Count); t++) {
+			const AllocationCounters counters = GetAllocationCounters(AllocationTag(t));
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(kTagNames[t]);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)counters.allocations);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)counters.frees);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", counters.liveBytes / 1024.0);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", counters.totalBytes / 1024.0);
+		}
+		ImGui::EndTable();
+	}
+}
+
+void FrameAllocationLog::WriteJson(std::ostream& stream) const {
+	stream << "{\"tracking\":" << (kAllocationTracking ? "true" : "false")
+		<< ",\"frames\":" << _frames
+		<< ",\"steadyStateFrame\":" << _steadyStateFrame
+		<< ",\"steadyStateAllocations\":" << _steadyStateAllocations
+		<< ",\"steadyStateFramesWithAllocations\":" << _steadyStateFramesWithAllocations
+		<< ",\"maxPerFrame\":" << _maxPerFrame
+		<< ",\"firstAllocatingFrame\":";
+	if (_firstAllocatingFrame == UINT64_MAX) {
+		stream << "null";
+	} else {
+		stream << _firstAllocatingFrame;
+	}
+	stream << ",\"tags\":{";
+	for (size_t t = 0; t < size_t(AllocationTag::Count); t++) {
+		const AllocationCounters counters = GetAllocationCounters(AllocationTag(t));
+		stream << (t ? "," : "") << "\"" << kTagNames[t] << "\":{\"allocations\":" << counters.allocations << ",\"frees\":" << counters.frees
+			<< ",\"liveBytes\":" << counters.liveBytes << ",\"totalBytes\":" << counters.totalBytes << "}";
+	}
+	stream << "}}";
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+// Heap instrumentation, compiled in with -DSTEORRA_TRACK_ALLOCATIONS=ON. Global operator new/delete are replaced so
+// every allocation is counted against the tag of the innermost AllocationScope on its thread. Without the option
+// the scopes compile to nothing and the counters stay at zero.
+#ifdef STEORRA_TRACK_ALLOCATIONS
+constexpr bool kAllocationTracking = true;
+#else
+constexpr bool kAllocationTracking = false;
+#endif
+
+enum class AllocationTag : uint8_t {
+	Untagged,
+	Tables,
+	Dynamics,
+	Meshes,
+	Graphics,
+	Imgui,
+	Publish,
+	Count,
+};
+
+const char* GetAllocationTagName(AllocationTag tag);
+
+struct AllocationCounters {
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+	uint64_t liveBytes = 0;
+	uint64_t totalBytes = 0;
+};
+
+AllocationCounters GetAllocationCounters(AllocationTag tag);
+// allocations of every tag since startup, cheap enough to read twice a frame
+uint64_t GetAllocationCount();
+
+#ifdef STEORRA_TRACK_ALLOCATIONS
+inline thread_local AllocationTag t_allocationTag = AllocationTag::Untagged;
+
+class AllocationScope {
+public:
+	explicit AllocationScope(AllocationTag tag) : _previous(t_allocationTag) { t_allocationTag = tag; }
+	~AllocationScope() { t_allocationTag = _previous; }
+	AllocationScope(const AllocationScope&) = delete;
+	AllocationScope& operator=(const AllocationScope&) = delete;
+private:
+	AllocationTag _previous;
+};
+#else
+class AllocationScope {
+public:
+	explicit AllocationScope(AllocationTag) {}
+};
+#endif
+
+// Allocations per frame. Fixed storage only, so recording a frame never allocates itself.
+class FrameAllocationLog {
+public:
+	static constexpr uint32_t kHistory = 240;
+	// frames before this one are warm up and do not count against the steady state
+	void SetSteadyStateFrame(uint64_t frame);
+	void BeginFrame();
+	void EndFrame(uint64_t frame);
+	uint64_t GetSteadyStateAllocations() const;
+	// draws into the current imgui window
+	void DrawImgui() const;
+	void WriteJson(std::ostream& stream) const;
+private:
+	std::array<uint32_t, kHistory> _counts{};
+	uint64_t _frames = 0;
+	uint64_t _frameStart = 0;
+	uint64_t _steadyStateFrame = 0;
+	uint64_t _steadyStateAllocations = 0;
+	uint64_t _steadyStateFramesWithAllocations = 0;
+	uint64_t _firstAllocatingFrame = UINT64_MAX;
+	uint32_t _maxPerFrame = 0;
+};
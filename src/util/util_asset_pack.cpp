@@ -0,0 +1,139 @@
+#include "util_asset_pack.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	uint64_t AlignUp(uint64_t value) {
+		return (value + AssetPack::kAlignment - 1) & ~uint64_t(AssetPack::kAlignment - 1);
+	}
+
+	std::string_view GetEntryName(const AssetPackEntry& entry) {
+		return { entry.name, strnlen(entry.name, AssetPackEntry::kNameLength) };
+	}
+}
+
+uint64_t GetSourceStamp(std::initializer_list<std::filesystem::path> sources) {
+	// FNV-1a over each size and write time
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&](uint64_t value) {
+		for (int i = 0; i < 8; i++) {
+			hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 1099511628211ull;
+		}
+	};
+	for (const std::filesystem::path& source : sources) {
+		std::error_code error;
+		const uint64_t size = std::filesystem::file_size(source, error);
+		const auto time = std::filesystem::last_write_time(source, error);
+		if (error) {
+			return 0;
+		}
+		mix(size);
+		mix(uint64_t(time.time_since_epoch().count()));
+	}
+	// 0 stays reserved for unchecked entries
+	return hash ? hash : 1;
+}
+
+AssetPack::AssetPack(const std::filesystem::path& path, uint32_t layoutStamp) {
+	Open(path, layoutStamp);
+}
+
+bool AssetPack::Open(const std::filesystem::path& path, uint32_t layoutStamp) {
+	Close();
+	if (!_file.Open(path)) {
+		return false;
+	}
+	const uint8_t* data = _file.GetData();
+	const size_t size = _file.GetSize();
+	AssetPackHeader header{};
+	if (size >= sizeof(header)) {
+		memcpy(&header, data, sizeof(header));
+	}
+	auto reject = [&](const char* reason) {
+		std::cout << "Ignoring asset pack " << path << ", " << reason << std::endl;
+		_file.Close();
+		return false;
+	};
+	if (size < sizeof(header) || memcmp(header.magic, kAssetPackMagic, sizeof(header.magic)) != 0) {
+		return reject("not an asset pack");
+	}
+	if (header.version != kAssetPackVersion || header.layoutStamp != layoutStamp) {
+		return reject("baked by a different build, rebake it with steorra bake");
+	}
+	if ((size - sizeof(header)) / sizeof(AssetPackEntry) < header.entryCount) {
+		return reject("truncated");
+	}
+	const auto* entries = reinterpret_cast<const AssetPackEntry*>(data + sizeof(header));
+	for (uint32_t i = 0; i < header.entryCount; i++) {
+		if (entries[i].offset % kAlignment != 0 || entries[i].offset > size || entries[i].size > size - entries[i].offset) {
+			return reject("truncated");
+		}
+	}
+	_entries = { entries, header.entryCount };
+	return true;
+}
+
+void AssetPack::Close() {
+	_entries = {};
+	_file.Close();
+}
+
+bool AssetPack::IsOpen() const {
+	return _file.IsOpen();
+}
+
+std::span<const uint8_t> AssetPack::Find(std::string_view name, uint64_t sourceStamp) const {
+	// a few dozen entries, a scan of the table is cheaper than building an index
+	for (const AssetPackEntry& entry : _entries) {
+		if (GetEntryName(entry) == name) {
+			if (sourceStamp && entry.sourceStamp && sourceStamp != entry.sourceStamp) {
+				std::cout << "Ignoring " << name << " in the asset pack, its sources changed since the bake" << std::endl;
+				return {};
+			}
+			return { _file.GetData() + entry.offset, (size_t)entry.size };
+		}
+	}
+	return {};
+}
+
+void AssetPackWriter::Add(std::string_view name, std::span<const uint8_t> data, uint64_t sourceStamp) {
+	if (name.size() >= AssetPackEntry::kNameLength) {
+		std::cerr << "Asset pack entry name " << name << " is too long" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	_blobs.push_back({ std::string(name), std::vector<uint8_t>(data.begin(), data.end()), sourceStamp });
+}
+
+bool AssetPackWriter::Write(const std::filesystem::path& path, uint32_t layoutStamp) const {
+	AssetPackHeader header{};
+	memcpy(header.magic, kAssetPackMagic, sizeof(header.magic));
+	header.version = kAssetPackVersion;
+	header.entryCount = (uint32_t)_blobs.size();
+	header.layoutStamp = layoutStamp;
+	std::vector<AssetPackEntry> entries(_blobs.size());
+	uint64_t offset = AlignUp(sizeof(header) + entries.size() * sizeof(AssetPackEntry));
+	for (size_t i = 0; i < _blobs.size(); i++) {
+		entries[i] = {};
+		_blobs[i].name.copy(entries[i].name, AssetPackEntry::kNameLength - 1);
+		entries[i].offset = offset;
+		entries[i].size = _blobs[i].data.size();
+		entries[i].sourceStamp = _blobs[i].sourceStamp;
+		offset = AlignUp(offset + entries[i].size);
+	}
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cerr << "Couldn't open " << path << " for writing" << std::endl;
+		return false;
+	}
+	const char padding[AssetPack::kAlignment]{};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(AssetPackEntry));
+	uint64_t position = sizeof(header) + entries.size() * sizeof(AssetPackEntry);
+	for (size_t i = 0; i < _blobs.size(); i++) {
+		file.write(padding, entries[i].offset - position);
+		file.write(reinterpret_cast<const char*>(_blobs[i].data.data()), _blobs[i].data.size());
+		position = entries[i].offset + entries[i].size;
+	}
+	return (bool)file;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util/util_mapped_file.h"
+
+constexpr char kAssetPackMagic[4] = { 'S', 'P', 'A', 'K' };
+constexpr uint32_t kAssetPackVersion = 2;
+
+struct AssetPackHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	// hash of the record layouts the pack was baked with, a pack from another build is ignored rather than misread
+	uint32_t layoutStamp;
+};
+
+struct AssetPackEntry {
+	static constexpr size_t kNameLength = 56;
+	char name[kNameLength];
+	uint64_t offset; // from the start of the file, a multiple of kAlignment
+	uint64_t size;
+	// GetSourceStamp of the files the entry was baked from, 0 when it is not checked
+	uint64_t sourceStamp;
+};
+
+// Hash of the size and modification time of every source, 0 if one is missing. A loose file edited after the bake
+// changes it, so the pack entry is skipped for the file.
+uint64_t GetSourceStamp(std::initializer_list<std::filesystem::path> sources);
+
+// Baked assets in one mapped file: a header, the entry table, then every blob aligned so records can be read in place
+// and copied straight into staging buffers. Lookups return views into the mapping, valid while the pack is open.
+class AssetPack {
+public:
+	static constexpr size_t kAlignment = 16;
+	AssetPack() = default;
+	AssetPack(const std::filesystem::path& path, uint32_t layoutStamp);
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+	// false, without a message, when there is no pack. A pack that is stale or damaged says why.
+	bool Open(const std::filesystem::path& path, uint32_t layoutStamp);
+	void Close();
+	bool IsOpen() const;
+	// empty if the pack is closed, has no such entry or the entry was baked from other sources than sourceStamp
+	// describes. A stamp of 0, as when the sources are not shipped, skips the check.
+	std::span<const uint8_t> Find(std::string_view name, uint64_t sourceStamp = 0) const;
+	template<typename T>
+	std::span<const T> FindArray(std::string_view name, uint64_t sourceStamp = 0) const;
+private:
+	MappedFile _file;
+	std::span<const AssetPackEntry> _entries;
+};
+
+template<typename T>
+std::span<const T> AssetPack::FindArray(std::string_view name, uint64_t sourceStamp) const {
+	static_assert(alignof(T) <= kAlignment);
+	const std::span<const uint8_t> bytes = Find(name, sourceStamp);
+	return { reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T) };
+}
+
+class AssetPackWriter {
+public:
+	void Add(std::string_view name, std::span<const uint8_t> data, uint64_t sourceStamp = 0);
+	template<typename T>
+	void AddArray(std::string_view name, std::span<const T> data, uint64_t sourceStamp = 0);
+	bool Write(const std::filesystem::path& path, uint32_t layoutStamp) const;
+private:
+	struct Blob {
+		std::string name;
+		std::vector<uint8_t> data;
+		uint64_t sourceStamp;
+	};
+	std::vector<Blob> _blobs;
+};
+
+template<typename T>
+void AssetPackWriter::AddArray(std::string_view name, std::span<const T> data, uint64_t sourceStamp) {
+	Add(name, { reinterpret_cast<const uint8_t*>(data.data()), data.size_bytes() }, sourceStamp);
+}
@@ -0,0 +1,116 @@
+#include "util_block_writer.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+BlockWriter::BlockWriter(const std::filesystem::path& path, size_t bufferSize) : _bufferSize((bufferSize + kAlignment - 1) & ~(kAlignment - 1)), _buffers{}, _fill(0), _fillSize(0), _bytesWritten(0), _pending(false), _pendingBuffer(0), _pendingSize(0), _closing(false), _failed(false) {
+#ifdef _WIN32
+	_file = _wfopen(path.c_str(), L"wb");
+#else
+	_file = std::fopen(path.c_str(), "wb");
+#endif
+	if (!_file) {
+		return;
+	}
+	std::setvbuf(_file, nullptr, _IONBF, 0);
+	for (uint8_t*& buffer : _buffers) {
+		buffer = static_cast<uint8_t*>(::operator new(_bufferSize, std::align_val_t(kAlignment)));
+	}
+	_thread = std::thread(&BlockWriter::WriterThread, this);
+}
+
+BlockWriter::~BlockWriter() {
+	Close();
+}
+
+bool BlockWriter::IsOpen() const {
+	return _file != nullptr;
+}
+
+size_t BlockWriter::GetBufferSize() const {
+	return _bufferSize;
+}
+
+uint8_t* BlockWriter::Reserve(size_t size) {
+	if (_fillSize + size > _bufferSize) {
+		Submit();
+	}
+	return _buffers[_fill] + _fillSize;
+}
+
+void BlockWriter::Commit(size_t size) {
+	_fillSize += size;
+	_bytesWritten += size;
+}
+
+void BlockWriter::Write(const void* data, size_t size) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	while (size > 0) {
+		if (_fillSize == _bufferSize) {
+			Submit();
+		}
+		const size_t chunk = std::min(size, _bufferSize - _fillSize);
+		std::memcpy(_buffers[_fill] + _fillSize, bytes, chunk);
+		Commit(chunk);
+		bytes += chunk;
+		size -= chunk;
+	}
+}
+
+void BlockWriter::Submit() {
+	if (_fillSize == 0) {
+		return;
+	}
+	std::unique_lock lock(_mutex);
+	// the other buffer is free once the thread has finished writing it
+	_condition.wait(lock, [&] { return !_pending; });
+	_pending = true;
+	_pendingBuffer = _fill;
+	_pendingSize = _fillSize;
+	lock.unlock();
+	_condition.notify_all();
+	_fill = 1 - _fill;
+	_fillSize = 0;
+}
+
+void BlockWriter::WriterThread() {
+	std::unique_lock lock(_mutex);
+	while (true) {
+		_condition.wait(lock, [&] { return _pending || _closing; });
+		if (!_pending) {
+			break;
+		}
+		const uint8_t* data = _buffers[_pendingBuffer];
+		const size_t size = _pendingSize;
+		lock.unlock();
+		const bool written = std::fwrite(data, 1, size, _file) == size;
+		lock.lock();
+		_failed |= !written;
+		_pending = false;
+		_condition.notify_all();
+	}
+}
+
+bool BlockWriter::Close() {
+	if (!_file) {
+		return false;
+	}
+	Submit();
+	{
+		std::lock_guard lock(_mutex);
+		_closing = true;
+	}
+	_condition.notify_all();
+	_thread.join();
+	_failed |= std::fclose(_file) != 0;
+	_file = nullptr;
+	for (uint8_t*& buffer : _buffers) {
+		::operator delete(buffer, std::align_val_t(kAlignment));
+		buffer = nullptr;
+	}
+	return !_failed;
+}
+
+uint64_t BlockWriter::GetBytesWritten() const {
+	return _bytesWritten;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+// Streams to a file through two large page aligned buffers. One is filled by the caller while a background thread
+// writes the other, so producing the data and writing it overlap. Stdio buffering is turned off so every write is a
+// whole buffer going straight to the OS.
+class BlockWriter {
+public:
+	static constexpr size_t kAlignment = 4096;
+	BlockWriter(const std::filesystem::path& path, size_t bufferSize = 4 << 20);
+	~BlockWriter();
+	BlockWriter(const BlockWriter&) = delete;
+	BlockWriter& operator=(const BlockWriter&) = delete;
+	bool IsOpen() const;
+	size_t GetBufferSize() const;
+	// contiguous space for up to size bytes (at most the buffer size), hands the current buffer over if it would not fit
+	uint8_t* Reserve(size_t size);
+	// how much of the last Reserve was used
+	void Commit(size_t size);
+	void Write(const void* data, size_t size);
+	// writes what is left and waits for the thread, false if any write failed
+	bool Close();
+	uint64_t GetBytesWritten() const;
+private:
+	void Submit();
+	void WriterThread();
+	std::FILE* _file;
+	size_t _bufferSize;
+	uint8_t* _buffers[2];
+	uint32_t _fill; // buffer the caller writes into
+	size_t _fillSize;
+	uint64_t _bytesWritten;
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	// guarded by _mutex
+	bool _pending;
+	uint32_t _pendingBuffer;
+	size_t _pendingSize;
+	bool _closing;
+	bool _failed;
+};
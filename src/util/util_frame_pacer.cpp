@@ -0,0 +1,73 @@
+#include "util_frame_pacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+	constexpr const char* kPresentModeNames[kPresentModeCount] = { "fifo", "mailbox", "immediate" };
+	// weight of the newest sleep, recent enough to follow a change in timer resolution
+	constexpr double kSleepWeight = 0.05;
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+}
+
+bool ParsePresentMode(std::string_view name, PresentMode& mode) {
+	for (uint32_t i = 0; i < kPresentModeCount; i++) {
+		if (name == kPresentModeNames[i]) {
+			mode = PresentMode(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* GetPresentModeName(PresentMode mode) {
+	return kPresentModeNames[uint32_t(mode)];
+}
+
+void FramePacer::SetFrameCap(double framesPerSecond) {
+	_frameCap = std::max(framesPerSecond, 0.0);
+	_period = _frameCap > 0.0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / _frameCap)) : Clock::duration{};
+	_deadline = {};
+}
+
+double FramePacer::GetFrameCap() const {
+	return _frameCap;
+}
+
+void FramePacer::WaitForNextFrame() {
+	if (_frameCap <= 0.0) {
+		return;
+	}
+	const Clock::time_point now = Clock::now();
+	// a frame that ran a whole period over restarts the schedule, rather than the following frames rushing to catch up
+	if (now > _deadline + _period) {
+		_deadline = now + _period;
+		return;
+	}
+	if (now < _deadline) {
+		SleepUntil(_deadline);
+	}
+	_deadline += _period;
+}
+
+void FramePacer::SleepUntil(Clock::time_point deadline) {
+	// sleep a millisecond at a time while a slow wake up would still land before the deadline
+	while (Milliseconds(deadline - Clock::now()).count() > _sleepMean + 2.0 * std::sqrt(_sleepVariance)) {
+		const Clock::time_point start = Clock::now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		const double slept = Milliseconds(Clock::now() - start).count();
+		const double delta = slept - _sleepMean;
+		_sleepMean += kSleepWeight * delta;
+		_sleepVariance = (1.0 - kSleepWeight) * (_sleepVariance + kSleepWeight * delta * delta);
+	}
+	while (Clock::now() < deadline) {
+	}
+}
+
+void FramePacer::MarkInputSampled() {
+	_inputSampled = Clock::now();
+}
+
+double FramePacer::MarkSubmitted() {
+	return Milliseconds(Clock::now() - _inputSampled).count();
+}
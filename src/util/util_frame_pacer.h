@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+enum class PresentMode : uint8_t {
+	Fifo, // waits for vertical blank, never tears
+	Mailbox, // waits for vertical blank, a newer frame replaces the queued one
+	Immediate, // presents straight away and may tear
+};
+constexpr uint32_t kPresentModeCount = 3;
+bool ParsePresentMode(std::string_view name, PresentMode& mode);
+const char* GetPresentModeName(PresentMode mode);
+
+// Holds the main loop to a frame rate cap and times each frame from its input sample to its submit. The cap sleeps
+// while the time left is longer than a sleep is likely to take, then spins the rest of the way to the deadline.
+class FramePacer {
+public:
+	using Clock = std::chrono::steady_clock;
+	// frames per second, 0 for no cap
+	void SetFrameCap(double framesPerSecond);
+	double GetFrameCap() const;
+	// returns once the next frame may start
+	void WaitForNextFrame();
+	void MarkInputSampled();
+	// milliseconds since the input was sampled
+	double MarkSubmitted();
+private:
+	void SleepUntil(Clock::time_point deadline);
+	double _frameCap = 0.0;
+	Clock::duration _period{};
+	Clock::time_point _deadline{};
+	Clock::time_point _inputSampled{};
+	// moving mean and variance of how long a 1 ms sleep really takes, in ms
+	double _sleepMean = 1.0;
+	double _sleepVariance = 0.25;
+};
@@ -0,0 +1,158 @@
+#include "util_frame_writer.h"
+#include <array>
+#include <cstdio>
+#include <string>
+#include <algorithm>
+
+namespace {
+	std::array<uint32_t, 256> MakeCrcTable() {
+		std::array<uint32_t, 256> table{};
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		return table;
+	}
+
+	uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		static const std::array<uint32_t, 256> table = MakeCrcTable();
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	void PutU32(std::vector<uint8_t>& out, uint32_t value) {
+		out.push_back(uint8_t(value >> 24));
+		out.push_back(uint8_t(value >> 16));
+		out.push_back(uint8_t(value >> 8));
+		out.push_back(uint8_t(value));
+	}
+
+	void PutChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+		PutU32(out, (uint32_t)size);
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		PutU32(out, Crc32(out.data() + start, size + 4));
+	}
+}
+
+FrameWriter::FrameWriter(const std::filesystem::path& path, FrameFormat format, uint32_t width, uint32_t height, uint32_t framesPerSecond)
+	: _path(path), _format(format), _width(width), _height(height), _open(false) {
+	std::error_code error;
+	if (_format == FrameFormat::Png) {
+		std::filesystem::create_directories(_path, error);
+		_open = std::filesystem::is_directory(_path);
+		return;
+	}
+	if (_path.has_parent_path()) {
+		std::filesystem::create_directories(_path.parent_path(), error);
+	}
+	_stream.open(_path, std::ios::binary | std::ios::trunc);
+	_open = _stream.is_open();
+	if (_open && _format == FrameFormat::Y4m) {
+		_stream << "YUV4MPEG2 W" << _width << " H" << _height << " F" << framesPerSecond << ":1 Ip A1:1 C444\n";
+	}
+}
+
+bool FrameWriter::IsOpen() const {
+	return _open;
+}
+
+bool FrameWriter::Write(const uint8_t* rgba, uint64_t frameIndex) {
+	if (!_open) {
+		return false;
+	}
+	switch (_format) {
+	case FrameFormat::Raw:
+		_stream.write((const char*)rgba, std::streamsize(_width) * _height * 4);
+		return _stream.good();
+	case FrameFormat::Png: {
+		char name[32];
+		std::snprintf(name, sizeof(name), "frame_%06llu.png", (unsigned long long)frameIndex);
+		return WritePng(rgba, _path / name);
+	}
+	case FrameFormat::Y4m:
+		return WriteY4m(rgba);
+	}
+	return false;
+}
+
+bool FrameWriter::WritePng(const uint8_t* rgba, const std::filesystem::path& path) {
+	// zlib stream of stored (uncompressed) deflate blocks: fast to write, the frames are meant for a video encoder anyway
+	const size_t rowSize = size_t(_width) * 3 + 1;
+	std::vector<uint8_t> raw(rowSize * _height);
+	for (uint32_t y = 0; y < _height; y++) {
+		uint8_t* row = raw.data() + y * rowSize;
+		row[0] = 0; // filter: none
+		const uint8_t* src = rgba + size_t(y) * _width * 4;
+		for (uint32_t x = 0; x < _width; x++) {
+			row[1 + x * 3 + 0] = src[x * 4 + 0];
+			row[1 + x * 3 + 1] = src[x * 4 + 1];
+			row[1 + x * 3 + 2] = src[x * 4 + 2];
+		}
+	}
+
+	std::vector<uint8_t>& idat = _scratch;
+	idat.clear();
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+	uint32_t adlerA = 1, adlerB = 0;
+	for (size_t offset = 0; ; ) {
+		const size_t blockSize = std::min<size_t>(raw.size() - offset, 65535);
+		const bool last = offset + blockSize == raw.size();
+		idat.push_back(last ? 1 : 0);
+		idat.push_back(uint8_t(blockSize));
+		idat.push_back(uint8_t(blockSize >> 8));
+		idat.push_back(uint8_t(~blockSize));
+		idat.push_back(uint8_t(~blockSize >> 8));
+		idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+		for (size_t i = offset; i < offset + blockSize; i++) {
+			adlerA = (adlerA + raw[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+		offset += blockSize;
+		if (last) {
+			break;
+		}
+	}
+	PutU32(idat, (adlerB << 16) | adlerA);
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	std::vector<uint8_t> header;
+	PutU32(header, _width);
+	PutU32(header, _height);
+	header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit, truecolour, deflate, no filter, no interlace
+	PutChunk(png, "IHDR", header.data(), header.size());
+	PutChunk(png, "IDAT", idat.data(), idat.size());
+	PutChunk(png, "IEND", nullptr, 0);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write((const char*)png.data(), png.size());
+	return file.good();
+}
+
+bool FrameWriter::WriteY4m(const uint8_t* rgba) {
+	// BT.601 studio range
+	const size_t pixelCount = size_t(_width) * _height;
+	_scratch.resize(pixelCount * 3);
+	uint8_t* yPlane = _scratch.data();
+	uint8_t* uPlane = yPlane + pixelCount;
+	uint8_t* vPlane = uPlane + pixelCount;
+	for (size_t i = 0; i < pixelCount; i++) {
+		const int r = rgba[i * 4 + 0];
+		const int g = rgba[i * 4 + 1];
+		const int b = rgba[i * 4 + 2];
+		yPlane[i] = uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		uPlane[i] = uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		vPlane[i] = uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+	}
+	_stream << "FRAME\n";
+	_stream.write((const char*)_scratch.data(), _scratch.size());
+	return _stream.good();
+}
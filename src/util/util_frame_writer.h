@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+enum class FrameFormat {
+	Raw, // every frame appended to one file as tightly packed RGBA8
+	Png, // one file per frame inside the output directory
+	Y4m, // one YUV4MPEG2 stream (4:4:4), playable by ffmpeg/mpv
+};
+
+// Writes RGBA8 frames read back from the GPU to disk
+class FrameWriter {
+public:
+	FrameWriter(const std::filesystem::path& path, FrameFormat format, uint32_t width, uint32_t height, uint32_t framesPerSecond = 30);
+	bool IsOpen() const;
+	bool Write(const uint8_t* rgba, uint64_t frameIndex);
+private:
+	bool WritePng(const uint8_t* rgba, const std::filesystem::path& path);
+	bool WriteY4m(const uint8_t* rgba);
+	std::filesystem::path _path;
+	FrameFormat _format;
+	uint32_t _width;
+	uint32_t _height;
+	std::ofstream _stream;
+	bool _open;
+	std::vector<uint8_t> _scratch;
+};
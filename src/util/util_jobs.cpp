@@ -0,0 +1,291 @@
+#include "util_jobs.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+	std::atomic<uint64_t> g_instances{ 0 };
+
+	struct ThreadState {
+		uint64_t instance = UINT64_MAX;
+		uint32_t index = 0;
+	};
+	thread_local ThreadState t_state;
+	// steal order for threads outside the system, which share one ThreadData and so cannot share its state unlocked
+	thread_local uint32_t t_outsideRandom = 2463534242u;
+
+	constexpr int kSpinsBeforeSleep = 64;
+}
+
+// seq_cst on top and bottom rather than standalone fences, which also keeps the deque visible to thread sanitizer
+bool JobDeque::Push(Job* job) {
+	const int64_t bottom = _bottom.load(std::memory_order_relaxed);
+	const int64_t top = _top.load(std::memory_order_acquire);
+	if (bottom - top >= kCapacity) {
+		return false;
+	}
+	_jobs[bottom & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+	_bottom.store(bottom + 1, std::memory_order_seq_cst);
+	return true;
+}
+
+Job* JobDeque::Pop() {
+	const int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+	_bottom.store(bottom, std::memory_order_seq_cst);
+	int64_t top = _top.load(std::memory_order_seq_cst);
+	if (top > bottom) {
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	Job* job = _jobs[bottom & (kCapacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom) {
+		// last job, race the thieves for it
+		if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* JobDeque::Steal() {
+	int64_t top = _top.load(std::memory_order_seq_cst);
+	const int64_t bottom = _bottom.load(std::memory_order_seq_cst);
+	if (top >= bottom) {
+		return nullptr;
+	}
+	Job* job = _jobs[top & (kCapacity - 1)].load(std::memory_order_relaxed);
+	if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return job;
+}
+
+JobSystem::JobSystem(uint32_t threadCount) : _instance(g_instances.fetch_add(1)), _running(true), _sleeping(0), _wakeups(0) {
+	_threadCount = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	_threads = std::make_unique<ThreadData[]>(_threadCount + 1);
+	for (uint32_t i = 0; i <= _threadCount; i++) {
+		_threads[i].jobs = std::make_unique<Job[]>(kJobsPerThread);
+		_threads[i].random = i * 2654435761u + 1;
+	}
+	_sharedJobs.reserve(256);
+	_mainJobs.reserve(256);
+	t_state = { _instance, 0 };
+	for (uint32_t i = 1; i < _threadCount; i++) {
+		_workers.emplace_back(&JobSystem::WorkerThread, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	_running.store(false);
+	_wakeups.fetch_add(1);
+	_wakeups.notify_all();
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+}
+
+uint32_t JobSystem::GetThreadCount() const {
+	return _threadCount;
+}
+
+bool JobSystem::IsMainThread() const {
+	return t_state.instance == _instance && t_state.index == 0;
+}
+
+uint32_t JobSystem::GetThreadIndex() const {
+	// threads the system did not start share the last slot
+	return t_state.instance == _instance ? t_state.index : _threadCount;
+}
+
+Job* JobSystem::Allocate(Job* parent) {
+	const uint32_t thread = GetThreadIndex();
+	ThreadData& data = _threads[thread];
+	std::unique_lock lock(_sharedMutex, std::defer_lock);
+	if (thread == _threadCount) {
+		lock.lock();
+	}
+	// a long lived job (a root still being waited on) is skipped when the ring wraps onto it
+	auto isFree = [](const Job* job) {
+		return job->unfinished.load(std::memory_order_acquire) == 0 && job->blockers.load(std::memory_order_acquire) == 0;
+	};
+	Job* job = &data.jobs[data.nextJob++ % kJobsPerThread];
+	for (uint32_t skipped = 1; !isFree(job); skipped++) {
+		if (skipped >= kJobsPerThread) {
+			// every job of this thread is in flight, help until one finishes
+			if (lock.owns_lock()) {
+				lock.unlock();
+			}
+			if (Job* other = FindJob(thread)) {
+				Execute(other);
+			} else {
+				std::this_thread::yield();
+			}
+			if (thread == _threadCount) {
+				lock.lock();
+			}
+		}
+		job = &data.jobs[data.nextJob++ % kJobsPerThread];
+	}
+	job->parent = parent;
+	job->unfinished.store(1, std::memory_order_relaxed);
+	job->blockers.store(1, std::memory_order_relaxed);
+	job->continuationCount = 0;
+	job->mainThread = false;
+	if (parent) {
+		parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+void JobSystem::AddDependency(Job* job, Job* dependency) {
+	if (dependency->continuationCount == Job::kMaxContinuations) {
+		std::cerr << "Job has more than " << Job::kMaxContinuations << " dependents\n";
+		std::exit(EXIT_FAILURE);
+	}
+	dependency->continuations[dependency->continuationCount++] = job;
+	job->blockers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JobSystem::Submit(Job* job) {
+	if (job->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		Enqueue(job);
+	}
+}
+
+void JobSystem::Enqueue(Job* job) {
+	if (job->mainThread) {
+		std::lock_guard lock(_mainMutex);
+		_mainJobs.push_back(job);
+		return;
+	}
+	const uint32_t thread = GetThreadIndex();
+	if (thread == _threadCount) {
+		std::lock_guard lock(_sharedMutex);
+		_sharedJobs.push_back(job);
+	} else if (!_threads[thread].deque.Push(job)) {
+		// deque full, running it here is always correct
+		Execute(job);
+		return;
+	}
+	// seq_cst against the worker's increment, so a worker about to sleep either sees the job or the wakeup
+	if (_sleeping.load(std::memory_order_seq_cst) > 0) {
+		_wakeups.fetch_add(1, std::memory_order_release);
+		_wakeups.notify_one();
+	}
+}
+
+Job* JobSystem::FindJob(uint32_t thread) {
+	if (thread < _threadCount) {
+		if (Job* job = _threads[thread].deque.Pop()) {
+			return job;
+		}
+	}
+	// random victim first so thieves spread out
+	uint32_t& random = thread < _threadCount ? _threads[thread].random : t_outsideRandom;
+	random ^= random << 13;
+	random ^= random >> 17;
+	random ^= random << 5;
+	const uint32_t start = random % _threadCount;
+	for (uint32_t i = 0; i < _threadCount; i++) {
+		const uint32_t victim = (start + i) % _threadCount;
+		if (victim != thread) {
+			if (Job* job = _threads[victim].deque.Steal()) {
+				return job;
+			}
+		}
+	}
+	std::lock_guard lock(_sharedMutex);
+	if (_sharedJobs.empty()) {
+		return nullptr;
+	}
+	Job* job = _sharedJobs.back();
+	_sharedJobs.pop_back();
+	return job;
+}
+
+void JobSystem::Execute(Job* job) {
+	job->invoke(*job);
+	job->destroy(*job);
+	Finish(job);
+}
+
+void JobSystem::Finish(Job* job) {
+	// once unfinished reaches 0 Allocate may hand the job out again, so everything needed after is read before
+	const uint32_t continuationCount = job->continuationCount;
+	const std::array<Job*, Job::kMaxContinuations> continuations = job->continuations;
+	Job* parent = job->parent;
+	if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+		return;
+	}
+	for (uint32_t i = 0; i < continuationCount; i++) {
+		Submit(continuations[i]);
+	}
+	if (parent) {
+		Finish(parent);
+	}
+}
+
+bool JobSystem::IsFinished(const Job* job) const {
+	return job->unfinished.load(std::memory_order_acquire) == 0;
+}
+
+void JobSystem::Wait(const Job* job) {
+	const uint32_t thread = GetThreadIndex();
+	const bool mainThread = IsMainThread();
+	while (!IsFinished(job)) {
+		if (mainThread) {
+			RunMainThreadJobs();
+		}
+		if (Job* other = FindJob(thread)) {
+			Execute(other);
+		} else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::RunMainThreadJobs() {
+	while (true) {
+		Job* job;
+		{
+			std::lock_guard lock(_mainMutex);
+			if (_mainHead == _mainJobs.size()) {
+				_mainJobs.clear();
+				_mainHead = 0;
+				return;
+			}
+			job = _mainJobs[_mainHead++];
+		}
+		Execute(job);
+	}
+}
+
+void JobSystem::WorkerThread(uint32_t thread) {
+	t_state = { _instance, thread };
+	int idle = 0;
+	while (_running.load(std::memory_order_relaxed)) {
+		if (Job* job = FindJob(thread)) {
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+		if (++idle < kSpinsBeforeSleep) {
+			std::this_thread::yield();
+			continue;
+		}
+		// announce the sleep, then look once more before blocking
+		const uint32_t wakeups = _wakeups.load(std::memory_order_acquire);
+		_sleeping.fetch_add(1, std::memory_order_seq_cst);
+		if (Job* job = FindJob(thread)) {
+			_sleeping.fetch_sub(1, std::memory_order_relaxed);
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+		if (_running.load(std::memory_order_relaxed)) {
+			_wakeups.wait(wakeups, std::memory_order_acquire);
+		}
+		_sleeping.fetch_sub(1, std::memory_order_relaxed);
+		idle = 0;
+	}
+}
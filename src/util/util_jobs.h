@@ -0,0 +1,172 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+
+// A unit of work with its callable stored inline. Created from the thread's own ring, so scheduling never allocates.
+struct Job {
+	static constexpr size_t kStorage = 64;
+	static constexpr uint32_t kMaxContinuations = 8;
+	void (*invoke)(Job& job) = nullptr;
+	void (*destroy)(Job& job) = nullptr;
+	Job* parent = nullptr;
+	// the job itself plus unfinished children, waiters spin on it
+	std::atomic<int32_t> unfinished{ 0 };
+	// dependencies still running plus one until Submit
+	std::atomic<int32_t> blockers{ 0 };
+	std::array<Job*, kMaxContinuations> continuations;
+	uint32_t continuationCount = 0;
+	bool mainThread = false;
+	alignas(16) std::array<std::byte, kStorage> storage;
+};
+
+// Chase-Lev work stealing deque of fixed capacity. The owner pushes and pops at the bottom, thieves take from the top.
+class JobDeque {
+public:
+	static constexpr int64_t kCapacity = 4096;
+	bool Push(Job* job);
+	Job* Pop();
+	Job* Steal();
+private:
+	alignas(64) std::atomic<int64_t> _top{ 0 };
+	alignas(64) std::atomic<int64_t> _bottom{ 0 };
+	std::array<std::atomic<Job*>, kCapacity> _jobs;
+};
+
+// Work stealing scheduler. The thread that creates it is the main thread and takes part in the work whenever it
+// waits. Jobs form graphs through parents (Wait on a parent covers its children) and dependencies (a job starts once
+// everything it depends on has finished). Main thread jobs only ever run on the main thread, for Vulkan queue and
+// window work.
+class JobSystem {
+public:
+	static constexpr uint32_t kJobsPerThread = 1024;
+	// threadCount includes the main thread, 0 for one per hardware thread
+	explicit JobSystem(uint32_t threadCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	uint32_t GetThreadCount() const;
+	bool IsMainThread() const;
+
+	// the job does not run until Submit, so dependencies can be added first
+	template<typename F>
+	Job* Create(F&& function, Job* parent = nullptr);
+	template<typename F>
+	Job* CreateOnMainThread(F&& function, Job* parent = nullptr);
+	// job starts after dependency finishes, both must not have been submitted yet
+	void AddDependency(Job* job, Job* dependency);
+	void Submit(Job* job);
+	template<typename F>
+	Job* Run(F&& function, Job* parent = nullptr);
+	template<typename F>
+	Job* RunOnMainThread(F&& function, Job* parent = nullptr);
+	bool IsFinished(const Job* job) const;
+	// runs other jobs until this one and its children have finished
+	void Wait(const Job* job);
+	// main thread only, runs the queued main thread jobs
+	void RunMainThreadJobs();
+
+	// function(first, last) over [begin, end) in chunks of at least grain, returns once every chunk has run
+	template<typename F>
+	void ParallelFor(size_t begin, size_t end, size_t grain, F&& function);
+private:
+	struct ThreadData {
+		JobDeque deque;
+		std::unique_ptr<Job[]> jobs;
+		uint32_t nextJob = 0;
+		uint32_t random; // unused in the outside thread slot
+	};
+	Job* Allocate(Job* parent);
+	void Enqueue(Job* job);
+	Job* FindJob(uint32_t thread);
+	void Execute(Job* job);
+	void Finish(Job* job);
+	void WorkerThread(uint32_t thread);
+	uint32_t GetThreadIndex() const;
+	template<typename F>
+	static void Store(Job* job, F&& function);
+	uint32_t _threadCount;
+	uint64_t _instance;
+	std::unique_ptr<ThreadData[]> _threads; // one more than the workers, the last serves outside threads
+	std::vector<std::thread> _workers;
+	std::atomic<bool> _running;
+	std::atomic<uint32_t> _sleeping;
+	std::atomic<uint32_t> _wakeups;
+	// jobs from threads outside the system, and main thread jobs, are queued under a lock
+	std::mutex _sharedMutex;
+	std::vector<Job*> _sharedJobs;
+	std::mutex _mainMutex;
+	std::vector<Job*> _mainJobs;
+	size_t _mainHead = 0; // run in order, a main thread job may itself wait and run the ones after it
+};
+
+template<typename F>
+void JobSystem::Store(Job* job, F&& function) {
+	using Function = std::decay_t<F>;
+	static_assert(sizeof(Function) <= Job::kStorage, "job captures too much, capture a pointer to the state instead");
+	static_assert(alignof(Function) <= 16);
+	new (job->storage.data()) Function(std::forward<F>(function));
+	job->invoke = [](Job& job) { (*std::launder(reinterpret_cast<Function*>(job.storage.data())))(); };
+	job->destroy = [](Job& job) { std::launder(reinterpret_cast<Function*>(job.storage.data()))->~Function(); };
+}
+
+template<typename F>
+Job* JobSystem::Create(F&& function, Job* parent) {
+	Job* job = Allocate(parent);
+	Store(job, std::forward<F>(function));
+	return job;
+}
+
+template<typename F>
+Job* JobSystem::CreateOnMainThread(F&& function, Job* parent) {
+	Job* job = Create(std::forward<F>(function), parent);
+	job->mainThread = true;
+	return job;
+}
+
+template<typename F>
+Job* JobSystem::Run(F&& function, Job* parent) {
+	Job* job = Create(std::forward<F>(function), parent);
+	Submit(job);
+	return job;
+}
+
+template<typename F>
+Job* JobSystem::RunOnMainThread(F&& function, Job* parent) {
+	Job* job = CreateOnMainThread(std::forward<F>(function), parent);
+	Submit(job);
+	return job;
+}
+
+template<typename F>
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, F&& function) {
+	grain = grain ? grain : 1;
+	if (end <= begin) {
+		return;
+	}
+	// a handful of chunks per thread evens out uneven work without flooding the deques
+	const size_t count = end - begin;
+	const size_t chunk = std::max(grain, count / (size_t(_threadCount) * 4) + 1);
+	if (_threadCount == 1 || count <= chunk) {
+		function(begin, end);
+		return;
+	}
+	Job* root = Create([] {});
+	for (size_t first = begin; first < end; first += chunk) {
+		const size_t last = std::min(end, first + chunk);
+		Run([&function, first, last] { function(first, last); }, root);
+	}
+	Submit(root);
+	Wait(root);
+}
@@ -0,0 +1,110 @@
+#include "util_mapped_file.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::filesystem::path& path) {
+	Close();
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	_file = file;
+	_mapping = mapping;
+	_data = static_cast<const uint8_t*>(view);
+	_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (_data) {
+		UnmapViewOfFile(_data);
+	}
+	if (_mapping) {
+		CloseHandle(_mapping);
+	}
+	if (_file) {
+		CloseHandle(_file);
+	}
+	_data = nullptr;
+	_size = 0;
+	_mapping = nullptr;
+	_file = nullptr;
+}
+#else
+bool MappedFile::Open(const std::filesystem::path& path) {
+	Close();
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		close(file);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED) {
+		close(file);
+		return false;
+	}
+	// callers mostly stream through the whole file once
+	madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+	_file = file;
+	_data = static_cast<const uint8_t*>(view);
+	_size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (_data) {
+		munmap(const_cast<uint8_t*>(_data), _size);
+	}
+	if (_file >= 0) {
+		close(_file);
+	}
+	_data = nullptr;
+	_size = 0;
+	_file = -1;
+}
+#endif
+
+bool MappedFile::IsOpen() const {
+	return _data != nullptr;
+}
+
+const uint8_t* MappedFile::GetData() const {
+	return _data;
+}
+
+size_t MappedFile::GetSize() const {
+	return _size;
+}
@@ -0,0 +1,262 @@
+#include "util_profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <imgui.h>
+
+namespace {
+	std::atomic<uint64_t> g_instances{ 0 };
+
+	struct ThreadState {
+		uint64_t instance = UINT64_MAX;
+		uint16_t thread = 0;
+		void* buffer = nullptr;
+		uint16_t depth = 0;
+	};
+	thread_local ThreadState t_state;
+
+	// stable colours per zone name, so a zone keeps its colour from frame to frame
+	ImU32 ZoneColor(const char* name) {
+		uint32_t hash = 2166136261u;
+		for (const char* c = name; *c; c++) {
+			hash = (hash ^ uint8_t(*c)) * 16777619u;
+		}
+		const float hue = (hash % 360) / 360.0f;
+		float r, g, b;
+		ImGui::ColorConvertHSVtoRGB(hue, 0.55f, 0.85f, r, g, b);
+		return ImGui::GetColorU32(ImVec4(r, g, b, 1.0f));
+	}
+
+	void WriteJsonString(std::ofstream& stream, const char* text) {
+		stream << '"';
+		for (const char* c = text; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				stream << '\\';
+			}
+			stream << *c;
+		}
+		stream << '"';
+	}
+}
+
+Profiler::Profiler() : _threads(std::make_unique<ThreadBuffer[]>(kMaxThreads)), _threadCount(0), _instance(g_instances.fetch_add(1)), _currentFrame(UINT64_MAX), _paused(false), _selectedFrame(UINT64_MAX) {
+	// sized up front so steady state frames never allocate
+	for (FrameRecord& record : _history) {
+		record.cpu.reserve(256);
+		record.gpu.reserve(64);
+	}
+}
+
+uint64_t Profiler::Now() {
+	static const auto origin = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void Profiler::BeginFrame(uint64_t frame) {
+	_currentFrame = frame;
+	if (_paused) {
+		return;
+	}
+	FrameRecord& record = _history[frame % kHistory];
+	record.frame = frame;
+	record.start = Now();
+	record.end = record.start;
+	record.submit = record.start;
+	record.cpu.clear();
+	record.gpu.clear();
+}
+
+void Profiler::EndFrame() {
+	FrameRecord* record = _paused ? nullptr : FindFrame(_currentFrame);
+	const uint32_t threadCount = std::min(_threadCount.load(std::memory_order_acquire), kMaxThreads);
+	for (uint32_t t = 0; t < threadCount; t++) {
+		ThreadBuffer& buffer = _threads[t];
+		const uint64_t head = buffer.head.load(std::memory_order_acquire);
+		// a thread that got more than a ring ahead has overwritten its oldest zones
+		buffer.tail = std::max(buffer.tail, head > ThreadBuffer::kCapacity ? head - ThreadBuffer::kCapacity : 0);
+		for (; record && buffer.tail < head; buffer.tail++) {
+			record->cpu.push_back(buffer.zones[buffer.tail % ThreadBuffer::kCapacity]);
+		}
+		buffer.tail = head;
+	}
+	if (record) {
+		record->end = Now();
+	}
+}
+
+void Profiler::MarkSubmit() {
+	if (FrameRecord* record = _paused ? nullptr : FindFrame(_currentFrame)) {
+		record->submit = Now();
+	}
+}
+
+void Profiler::AddGpuZones(uint64_t frame, const ProfileZone* zones, size_t count) {
+	FrameRecord* record = _paused ? nullptr : FindFrame(frame);
+	if (!record) {
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		ProfileZone zone = zones[i];
+		zone.start += record->submit;
+		zone.end += record->submit;
+		record->gpu.push_back(zone);
+	}
+}
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer(uint16_t& thread) {
+	if (t_state.instance != _instance) {
+		// threads past the limit drop their zones, sharing a ring would break the single producer rule
+		const uint32_t index = _threadCount.load(std::memory_order_relaxed) < kMaxThreads ? _threadCount.fetch_add(1, std::memory_order_acq_rel) : kMaxThreads;
+		t_state.instance = _instance;
+		t_state.thread = uint16_t(std::min(index, kMaxThreads));
+		t_state.buffer = index < kMaxThreads ? &_threads[index] : nullptr;
+	}
+	thread = t_state.thread;
+	return static_cast<ThreadBuffer*>(t_state.buffer);
+}
+
+void Profiler::RecordZone(const char* name, uint64_t start, uint64_t end, uint16_t depth) {
+	uint16_t thread;
+	ThreadBuffer* buffer = GetThreadBuffer(thread);
+	if (!buffer) {
+		return;
+	}
+	const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+	buffer->zones[head % ThreadBuffer::kCapacity] = { name, start, end, thread, depth };
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+uint16_t Profiler::PushDepth() {
+	return t_state.depth++;
+}
+
+void Profiler::PopDepth() {
+	t_state.depth--;
+}
+
+const char* Profiler::Intern(std::string_view name) {
+	for (const std::string& existing : _names) {
+		if (existing == name) {
+			return existing.c_str();
+		}
+	}
+	return _names.emplace(name).first->c_str();
+}
+
+Profiler::FrameRecord* Profiler::FindFrame(uint64_t frame) {
+	FrameRecord& record = _history[frame % kHistory];
+	return record.frame == frame ? &record : nullptr;
+}
+
+void Profiler::DrawOverlay(bool* open) {
+	if (!ImGui::Begin("Profiler", open)) {
+		ImGui::End();
+		return;
+	}
+	// the newest frame with GPU zones is a couple of frames behind
+	if (!_paused) {
+		_selectedFrame = UINT64_MAX;
+		for (uint64_t back = 1; back < kHistory && back <= _currentFrame; back++) {
+			const FrameRecord* record = FindFrame(_currentFrame - back);
+			if (record && (!record->gpu.empty() || back >= 4)) {
+				_selectedFrame = record->frame;
+				break;
+			}
+		}
+	}
+	std::array<float, kHistory> cpuMs{};
+	int samples = 0;
+	for (uint64_t back = kHistory; back-- > 1;) {
+		if (back <= _currentFrame) {
+			const FrameRecord* record = FindFrame(_currentFrame - back);
+			cpuMs[samples++] = record ? (record->end - record->start) / 1e6f : 0.0f;
+		}
+	}
+	ImGui::PlotLines("CPU ms", cpuMs.data(), samples, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+	ImGui::Checkbox("Pause", &_paused);
+	ImGui::SameLine();
+	if (ImGui::Button("Save trace")) {
+		SaveChromeTrace("steorra_trace.json");
+	}
+	const FrameRecord* record = _selectedFrame == UINT64_MAX ? nullptr : FindFrame(_selectedFrame);
+	if (!record) {
+		ImGui::End();
+		return;
+	}
+	if (_paused) {
+		int frame = int(record->frame);
+		if (ImGui::SliderInt("Frame", &frame, int(std::max<int64_t>(0, int64_t(_currentFrame) - kHistory + 1)), int(_currentFrame))) {
+			_selectedFrame = uint64_t(frame);
+		}
+	}
+	uint64_t end = record->end;
+	for (const ProfileZone& zone : record->gpu) {
+		end = std::max(end, zone.end);
+	}
+	ImGui::Text("Frame %llu  CPU %.3f ms", (unsigned long long)record->frame, (record->end - record->start) / 1e6);
+	// one row per thread and nesting depth, the GPU below
+	const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	const float width = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+	const double scale = width / double(std::max<uint64_t>(end - record->start, 1));
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	auto rowOf = [](const ProfileZone& zone) { return zone.thread * 8 + std::min<uint16_t>(zone.depth, 7); };
+	int rows = 0;
+	for (const ProfileZone& zone : record->cpu) {
+		rows = std::max(rows, rowOf(zone) + 1);
+	}
+	const int gpuRow = rows;
+	auto drawZone = [&](const ProfileZone& zone, int row) {
+		const ImVec2 min(origin.x + float((zone.start - record->start) * scale), origin.y + row * rowHeight);
+		const ImVec2 max(std::max(min.x + 1.0f, origin.x + float((zone.end - record->start) * scale)), min.y + rowHeight - 1.0f);
+		drawList->AddRectFilled(min, max, ZoneColor(zone.name));
+		drawList->PushClipRect(min, max, true);
+		drawList->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32_BLACK, zone.name);
+		drawList->PopClipRect();
+		if (ImGui::IsMouseHoveringRect(min, max)) {
+			ImGui::SetTooltip("%s %.3f ms", zone.name, (zone.end - zone.start) / 1e6);
+		}
+	};
+	for (const ProfileZone& zone : record->cpu) {
+		drawZone(zone, rowOf(zone));
+	}
+	for (const ProfileZone& zone : record->gpu) {
+		drawZone(zone, gpuRow + std::min<uint16_t>(zone.depth, 7));
+	}
+	ImGui::Dummy(ImVec2(width, (gpuRow + 2) * rowHeight));
+	ImGui::End();
+}
+
+bool Profiler::SaveChromeTrace(const std::filesystem::path& path) const {
+	std::ofstream stream(path, std::ios::trunc);
+	if (!stream.is_open()) {
+		return false;
+	}
+	// pid 1 is the CPU with a tid per thread, pid 2 the GPU queue, times are microseconds
+	stream << "{\"traceEvents\":[\n";
+	stream << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	stream << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}";
+	std::vector<const FrameRecord*> frames;
+	for (const FrameRecord& record : _history) {
+		if (record.frame != UINT64_MAX) {
+			frames.push_back(&record);
+		}
+	}
+	std::sort(frames.begin(), frames.end(), [](const FrameRecord* a, const FrameRecord* b) { return a->frame < b->frame; });
+	auto writeZone = [&](const ProfileZone& zone, int pid, int tid) {
+		stream << ",\n{\"name\":";
+		WriteJsonString(stream, zone.name);
+		stream << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"ts\":" << zone.start / 1e3 << ",\"dur\":" << (zone.end - zone.start) / 1e3 << "}";
+	};
+	for (const FrameRecord* record : frames) {
+		stream << ",\n{\"name\":\"Frame " << record->frame << "\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":" << record->start / 1e3 << ",\"dur\":" << (record->end - record->start) / 1e3 << "}";
+		for (const ProfileZone& zone : record->cpu) {
+			writeZone(zone, 1, zone.thread + 1);
+		}
+		for (const ProfileZone& zone : record->gpu) {
+			writeZone(zone, 2, 0);
+		}
+	}
+	stream << "\n]}\n";
+	return (bool)stream;
+}
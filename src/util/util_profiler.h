@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+struct ProfileZone {
+	const char* name; // static or interned, never freed while the profiler lives
+	uint64_t start; // nanoseconds since the profiler started
+	uint64_t end;
+	uint16_t thread; // CPU thread, zones on the GPU share one row
+	uint16_t depth;
+};
+
+// Frame profiler with scoped CPU zones and GPU zones resolved from timestamp queries.
+// Each thread writes finished zones into its own single producer ring, so recording is two clock reads and a store with
+// no locks. EndFrame drains the rings into a per frame record on the main thread. GPU zones arrive once their frame's
+// fence has signalled and are placed at the frame's submit time, as there is no shared CPU/GPU clock.
+class Profiler {
+public:
+	static constexpr uint32_t kMaxThreads = 32;
+	static constexpr uint32_t kHistory = 240;
+	Profiler();
+	static uint64_t Now();
+	// opens the record for a frame, EndFrame drains the thread rings into it
+	void BeginFrame(uint64_t frame);
+	void EndFrame();
+	void MarkSubmit(); // anchors this frame's GPU zones on the CPU timeline
+	void AddGpuZones(uint64_t frame, const ProfileZone* zones, size_t count);
+	void RecordZone(const char* name, uint64_t start, uint64_t end, uint16_t depth);
+	uint16_t PushDepth();
+	void PopDepth();
+	const char* Intern(std::string_view name);
+	void DrawOverlay(bool* open);
+	bool SaveChromeTrace(const std::filesystem::path& path) const;
+private:
+	struct ThreadBuffer {
+		static constexpr uint32_t kCapacity = 4096;
+		std::array<ProfileZone, kCapacity> zones;
+		std::atomic<uint64_t> head{ 0 }; // written by the owning thread
+		uint64_t tail = 0; // read by EndFrame
+	};
+	struct FrameRecord {
+		uint64_t frame = UINT64_MAX;
+		uint64_t start = 0;
+		uint64_t end = 0;
+		uint64_t submit = 0;
+		std::vector<ProfileZone> cpu;
+		std::vector<ProfileZone> gpu;
+	};
+	ThreadBuffer* GetThreadBuffer(uint16_t& thread);
+	FrameRecord* FindFrame(uint64_t frame);
+	std::unique_ptr<ThreadBuffer[]> _threads; // megabytes, kept off the stack
+	std::atomic<uint32_t> _threadCount;
+	uint64_t _instance; // tells thread locals of an earlier profiler apart
+	std::array<FrameRecord, kHistory> _history;
+	uint64_t _currentFrame;
+	bool _paused;
+	uint64_t _selectedFrame;
+	std::unordered_set<std::string> _names;
+};
+
+// Times its own lifetime as a CPU zone, nested scopes on one thread stack up in the overlay
+class ProfileScope {
+public:
+	ProfileScope(Profiler& profiler, const char* name) : _profiler(profiler), _name(name), _depth(profiler.PushDepth()), _start(Profiler::Now()) {}
+	~ProfileScope() {
+		_profiler.RecordZone(_name, _start, Profiler::Now(), _depth);
+		_profiler.PopDepth();
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+	Profiler& _profiler;
+	const char* _name;
+	uint16_t _depth;
+	uint64_t _start;
+};
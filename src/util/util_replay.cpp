@@ -0,0 +1,192 @@
+#include "util_replay.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+// file layout: magic, version, then per frame
+// f64 dt, f64 solarTime, i32 foldIndex, u16 eventCount, events
+// an event is a u8 type followed by u16 scancode (keys) or 2 x f32 (motion)
+namespace {
+	constexpr char kMagic[4] = { 'S', 'R', 'P', 'L' };
+	constexpr uint32_t kVersion = 1;
+
+	template<typename T>
+	void Put(std::ofstream& stream, T value) {
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool Get(std::ifstream& stream, T& value) {
+		return (bool)stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+	}
+
+	double Percentile(std::vector<double> values, double p) {
+		if (values.empty()) {
+			return 0.0;
+		}
+		size_t index = std::min(values.size() - 1, size_t(p * values.size()));
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+}
+
+ReplayRecorder::ReplayRecorder(const std::filesystem::path& path) : _frameCount(0) {
+	_stream.open(path, std::ios::binary | std::ios::trunc);
+	if (_stream.is_open()) {
+		_stream.write(kMagic, sizeof(kMagic));
+		Put(_stream, kVersion);
+	}
+}
+
+bool ReplayRecorder::IsOpen() const {
+	return _stream.is_open();
+}
+
+void ReplayRecorder::Write(const ReplayFrame& frame) {
+	Put(_stream, frame.dt);
+	Put(_stream, frame.solarTime);
+	Put(_stream, frame.foldIndex);
+	Put(_stream, (uint16_t)frame.events.size());
+	for (const ReplayEvent& event : frame.events) {
+		Put(_stream, event.type);
+		switch (event.type) {
+			case ReplayEventType::KeyDown:
+			case ReplayEventType::KeyUp:
+				Put(_stream, event.scancode);
+				break;
+			case ReplayEventType::MouseMotion:
+				Put(_stream, event.x);
+				Put(_stream, event.y);
+				break;
+			case ReplayEventType::Quit:
+				break;
+		}
+	}
+	_frameCount++;
+}
+
+uint64_t ReplayRecorder::GetFrameCount() const {
+	return _frameCount;
+}
+
+ReplayReader::ReplayReader(const std::filesystem::path& path) : _open(false), _frameCount(0) {
+	_stream.open(path, std::ios::binary);
+	if (!_stream.is_open()) {
+		return;
+	}
+	char magic[4];
+	uint32_t version;
+	if (!_stream.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, kMagic) || !Get(_stream, version)) {
+		std::cerr << "Not a replay file: " << path << "\n";
+		return;
+	}
+	if (version != kVersion) {
+		std::cerr << "Unsupported replay version " << version << "\n";
+		return;
+	}
+	_open = true;
+}
+
+bool ReplayReader::IsOpen() const {
+	return _open;
+}
+
+bool ReplayReader::Read(ReplayFrame& frame) {
+	if (!_open) {
+		return false;
+	}
+	uint16_t eventCount;
+	if (!Get(_stream, frame.dt) || !Get(_stream, frame.solarTime) || !Get(_stream, frame.foldIndex) || !Get(_stream, eventCount)) {
+		return false;
+	}
+	frame.events.resize(eventCount);
+	for (ReplayEvent& event : frame.events) {
+		event = {};
+		if (!Get(_stream, event.type)) {
+			return false;
+		}
+		switch (event.type) {
+			case ReplayEventType::KeyDown:
+			case ReplayEventType::KeyUp:
+				if (!Get(_stream, event.scancode)) {
+					return false;
+				}
+				break;
+			case ReplayEventType::MouseMotion:
+				if (!Get(_stream, event.x) || !Get(_stream, event.y)) {
+					return false;
+				}
+				break;
+			case ReplayEventType::Quit:
+				break;
+			default:
+				std::cerr << "Corrupt replay event at frame " << _frameCount << "\n";
+				return false;
+		}
+	}
+	_frameCount++;
+	return true;
+}
+
+uint64_t ReplayReader::GetFrameCount() const {
+	return _frameCount;
+}
+
+FrameTimingLog::Row& FrameTimingLog::GetRow(uint64_t frame) {
+	if (frame >= _rows.size()) {
+		_rows.resize(frame + 1);
+	}
+	return _rows[frame];
+}
+
+void FrameTimingLog::Reserve(uint64_t frames) {
+	_rows.reserve(frames);
+}
+
+void FrameTimingLog::RecordCpu(uint64_t frame, double ms) {
+	GetRow(frame).cpuMs = ms;
+}
+
+void FrameTimingLog::RecordGpu(uint64_t frame, double ms) {
+	GetRow(frame).gpuMs = ms;
+}
+
+void FrameTimingLog::RecordLatency(uint64_t frame, double ms) {
+	GetRow(frame).latencyMs = ms;
+}
+
+bool FrameTimingLog::Save(const std::filesystem::path& path) const {
+	std::ofstream stream(path, std::ios::trunc);
+	if (!stream.is_open()) {
+		return false;
+	}
+	stream << "frame,cpu_ms,gpu_ms,latency_ms\n" << std::fixed << std::setprecision(4);
+	for (size_t i = 0; i < _rows.size(); i++) {
+		stream << i << "," << _rows[i].cpuMs << "," << _rows[i].gpuMs << "," << _rows[i].latencyMs << "\n";
+	}
+	return (bool)stream;
+}
+
+void FrameTimingLog::PrintSummary() const {
+	std::vector<double> cpu, gpu, latency;
+	for (const Row& row : _rows) {
+		cpu.push_back(row.cpuMs);
+		// frames still in flight at exit never get a GPU time
+		if (row.gpuMs > 0.0) {
+			gpu.push_back(row.gpuMs);
+		}
+		// headless frames have no input
+		if (row.latencyMs > 0.0) {
+			latency.push_back(row.latencyMs);
+		}
+	}
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Frames " << _rows.size()
+		<< " cpu p50 " << Percentile(cpu, 0.5) << " ms p99 " << Percentile(cpu, 0.99) << " ms"
+		<< " gpu p50 " << Percentile(gpu, 0.5) << " ms p99 " << Percentile(gpu, 0.99) << " ms";
+	if (!latency.empty()) {
+		std::cout << " input to submit p50 " << Percentile(latency, 0.5) << " ms p99 " << Percentile(latency, 0.99) << " ms";
+	}
+	std::cout << std::endl;
+	std::cout << std::defaultfloat;
+}
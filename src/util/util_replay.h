@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+enum class ReplayEventType : uint8_t {
+	KeyDown,
+	KeyUp,
+	MouseMotion,
+	Quit,
+};
+
+struct ReplayEvent {
+	ReplayEventType type;
+	uint16_t scancode; // key events
+	float x, y; // relative mouse motion
+};
+
+// Everything that drives the simulation for one frame, so a run can be reproduced exactly
+struct ReplayFrame {
+	double dt;
+	double solarTime;
+	int32_t foldIndex;
+	std::vector<ReplayEvent> events;
+};
+
+// Appends frames to a compact binary capture
+class ReplayRecorder {
+public:
+	ReplayRecorder(const std::filesystem::path& path);
+	bool IsOpen() const;
+	void Write(const ReplayFrame& frame);
+	uint64_t GetFrameCount() const;
+private:
+	std::ofstream _stream;
+	uint64_t _frameCount;
+};
+
+// Reads a capture back one frame at a time
+class ReplayReader {
+public:
+	ReplayReader(const std::filesystem::path& path);
+	bool IsOpen() const;
+	bool Read(ReplayFrame& frame);
+	uint64_t GetFrameCount() const;
+private:
+	std::ifstream _stream;
+	bool _open;
+	uint64_t _frameCount;
+};
+
+// Per frame CPU and GPU times and input to submit latency, saved as CSV so runs over the same capture can be diffed
+class FrameTimingLog {
+public:
+	// rows for a known frame count up front, so recording does not allocate mid run
+	void Reserve(uint64_t frames);
+	void RecordCpu(uint64_t frame, double ms);
+	void RecordGpu(uint64_t frame, double ms);
+	void RecordLatency(uint64_t frame, double ms);
+	bool Save(const std::filesystem::path& path) const;
+	void PrintSummary() const;
+private:
+	struct Row {
+		double cpuMs = 0.0;
+		double gpuMs = 0.0;
+		double latencyMs = 0.0;
+	};
+	Row& GetRow(uint64_t frame);
+	std::vector<Row> _rows;
+};
@@ -18,10 +18,14 @@ void Spectator::Move(glm::dvec3 rel) {
 }
 
 glm::dmat4 Spectator::GetViewMatrix() const {
+	return glm::translate(GetRotationMatrix(), -position);
+}
+
+glm::dmat4 Spectator::GetRotationMatrix() const {
 	glm::dvec3 dir(1.0, 0.0, 0.0);
 	dir = glm::rotateY(dir, pitch);
 	dir = glm::rotateZ(dir, yaw);
-	return glm::lookAt(position, position + dir, glm::dvec3(0.0, 0.0, 1.0));
+	return glm::lookAt(glm::dvec3(0.0), dir, glm::dvec3(0.0, 0.0, 1.0));
 }
 
 glm::dvec3 Spectator::GetForwardVector() const {
@@ -7,6 +7,8 @@ public:
 	void Turn(glm::dvec2 rel);
 	void Move(glm::dvec3 rel);
 	glm::dmat4 GetViewMatrix() const;
+	// view matrix with the spectator at the origin, for camera-relative rendering
+	glm::dmat4 GetRotationMatrix() const;
 	glm::dvec3 GetForwardVector() const;
 	glm::dvec3 GetRightVector() const;
 	glm::dvec3 position;
@@ -0,0 +1,98 @@
+#include "util_startup.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "util/util_jobs.h"
+
+StartupGraph::StartupGraph(JobSystem& jobs, AllocationTag tag) : _jobs(jobs), _tag(tag) {}
+
+StartupGraph::Stage StartupGraph::Add(std::string_view name, std::function<void()> work, std::initializer_list<Stage> dependencies) {
+	return AddStage(name, std::move(work), dependencies, false);
+}
+
+StartupGraph::Stage StartupGraph::AddOnMainThread(std::string_view name, std::function<void()> work, std::initializer_list<Stage> dependencies) {
+	return AddStage(name, std::move(work), dependencies, true);
+}
+
+StartupGraph::Stage StartupGraph::AddStage(std::string_view name, std::function<void()>&& work, std::initializer_list<Stage> dependencies, bool mainThread) {
+	const Stage stage = (Stage)_stages.size();
+	for (Stage dependency : dependencies) {
+		if (dependency >= stage) {
+			std::cerr << "Startup stage " << name << " depends on a stage added after it\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	_stages.push_back({ std::string(name), std::move(work), dependencies, mainThread, 0.0, 0.0 });
+	return stage;
+}
+
+void StartupGraph::RunStage(Stage stage) {
+	AllocationScope allocationScope(_tag);
+	StageData& data = _stages[stage];
+	data.startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+	data.work();
+	data.endMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+}
+
+void StartupGraph::Run() {
+	_start = std::chrono::steady_clock::now();
+	// every job is created before any is submitted, so dependencies can be wired up front
+	Job* root = _jobs.Create([] {});
+	std::vector<Job*> jobs(_stages.size());
+	for (Stage stage = 0; stage < _stages.size(); stage++) {
+		auto run = [this, stage] { RunStage(stage); };
+		jobs[stage] = _stages[stage].mainThread ? _jobs.CreateOnMainThread(run, root) : _jobs.Create(run, root);
+		for (Stage dependency : _stages[stage].dependencies) {
+			_jobs.AddDependency(jobs[stage], jobs[dependency]);
+		}
+	}
+	for (Job* job : jobs) {
+		_jobs.Submit(job);
+	}
+	_jobs.Submit(root);
+	_jobs.Wait(root);
+	_totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+}
+
+void StartupGraph::Print(std::ostream& stream) const {
+	std::vector<Stage> order(_stages.size());
+	for (Stage stage = 0; stage < order.size(); stage++) {
+		order[stage] = stage;
+	}
+	std::sort(order.begin(), order.end(), [&](Stage a, Stage b) { return _stages[a].startMs < _stages[b].startMs; });
+	size_t width = 0;
+	for (const StageData& data : _stages) {
+		width = std::max(width, data.name.size());
+	}
+	// fixed precision for the table only, the caller's format is put back on the way out
+	std::ios format(nullptr);
+	format.copyfmt(stream);
+	stream << "Startup took " << std::fixed << std::setprecision(1) << _totalMs << " ms on " << _jobs.GetThreadCount() << " threads\n";
+	for (Stage stage : order) {
+		const StageData& data = _stages[stage];
+		stream << "  " << std::left << std::setw(width) << data.name << std::right
+			<< std::setw(9) << data.startMs << " to " << std::setw(7) << data.endMs << " ms (" << data.endMs - data.startMs << " ms)"
+			<< (data.mainThread ? " main thread" : "") << "\n";
+	}
+	if (_stages.empty()) {
+		stream.copyfmt(format);
+		return;
+	}
+	// walk back from the last stage to finish through whichever dependency held it up
+	std::vector<Stage> path;
+	Stage stage = *std::max_element(order.begin(), order.end(), [&](Stage a, Stage b) { return _stages[a].endMs < _stages[b].endMs; });
+	while (true) {
+		path.push_back(stage);
+		const std::vector<Stage>& dependencies = _stages[stage].dependencies;
+		if (dependencies.empty()) {
+			break;
+		}
+		stage = *std::max_element(dependencies.begin(), dependencies.end(), [&](Stage a, Stage b) { return _stages[a].endMs < _stages[b].endMs; });
+	}
+	stream << "  critical path:";
+	for (auto it = path.rbegin(); it != path.rend(); it++) {
+		stream << (it == path.rbegin() ? " " : " > ") << _stages[*it].name;
+	}
+	stream << std::endl;
+	stream.copyfmt(format);
+}
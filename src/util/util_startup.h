@@ -0,0 +1,45 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util/util_allocations.h"
+
+class JobSystem;
+
+// Startup as named stages on the job system, a stage starts once every stage it depends on has finished. Each stage
+// is timed, so the log shows what overlapped and which chain of stages set the total.
+class StartupGraph {
+public:
+	using Stage = uint32_t;
+	// stages allocate under the tag unless they open their own scope
+	StartupGraph(JobSystem& jobs, AllocationTag tag);
+	// dependencies must have been added before the stage
+	Stage Add(std::string_view name, std::function<void()> work, std::initializer_list<Stage> dependencies = {});
+	// for SDL and anything else tied to the main thread
+	Stage AddOnMainThread(std::string_view name, std::function<void()> work, std::initializer_list<Stage> dependencies = {});
+	// main thread only, returns once every stage has run
+	void Run();
+	// every stage in start order, then the critical path
+	void Print(std::ostream& stream) const;
+private:
+	struct StageData {
+		std::string name;
+		std::function<void()> work;
+		std::vector<Stage> dependencies;
+		bool mainThread;
+		double startMs;
+		double endMs;
+	};
+	Stage AddStage(std::string_view name, std::function<void()>&& work, std::initializer_list<Stage> dependencies, bool mainThread);
+	void RunStage(Stage stage);
+	JobSystem& _jobs;
+	AllocationTag _tag;
+	std::vector<StageData> _stages;
+	std::chrono::steady_clock::time_point _start;
+	double _totalMs = 0.0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+
+// tests are plain executables, a failed check reports where and the test exits non-zero at the end
+inline int g_failures = 0;
+
+#define CHECK(condition)\
+	do {\
+		if (!(condition)) {\
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n";\
+			g_failures++;\
+		}\
+	} while (0)
+
+inline int TestResult() {
+	if (g_failures) {
+		std::cerr << g_failures << " checks failed\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include "shared/shared_state.h"
+#include "test_check.h"
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+int main() {
+	const std::string name = "steorra_test_" + std::to_string(getpid());
+	const std::vector<SharedBodyInfo> bodies = {
+		{ "Sun", -1, 6.957e8 },
+		{ "Earth", 0, 6.371e6 },
+		{ "A name longer than the thirty one characters a slot holds", 1, 1.0 },
+	};
+
+	{
+		SharedStatePublisher publisher;
+		CHECK(publisher.Open(name, bodies));
+		// the body table is there as soon as a reader can attach
+		SharedStateReader reader;
+		CHECK(reader.Open(name));
+		CHECK(reader.IsPublisherAlive());
+		CHECK(reader.GetBodyCount() == 3);
+		CHECK(reader.GetBodyName(0) == "Sun");
+		CHECK(reader.GetBodyName(1) == "Earth");
+		CHECK(reader.GetBodyName(2) == bodies[2].name.substr(0, shared::kNameLength - 1));
+		CHECK(reader.GetBodyParent(0) == -1);
+		CHECK(reader.GetBodyParent(2) == 1);
+		CHECK(reader.GetBodyRadius(1) == 6.371e6);
+		CHECK(reader.GetBodyName(3).empty());
+
+		// a second publisher must not take over a live segment
+		SharedStatePublisher other;
+		CHECK(!other.Open(name, bodies));
+
+		for (uint64_t frame = 1; frame <= 3; frame++) {
+			publisher.Publish(frame, 2451545.0 + frame, [&](double* x, double* y, double* z) {
+				for (uint32_t i = 0; i < 3; i++) {
+					x[i] = double(frame * 10 + i);
+					y[i] = -x[i];
+					z[i] = 0.5 * x[i];
+				}
+			});
+			SharedStateView view;
+			double x[3], y[3], z[3];
+			do {
+				view = reader.Begin();
+				std::memcpy(x, view.x, sizeof(x));
+				std::memcpy(y, view.y, sizeof(y));
+				std::memcpy(z, view.z, sizeof(z));
+			} while (!reader.Validate(view));
+			CHECK(view.frame == frame);
+			CHECK(view.solarTime == 2451545.0 + frame);
+			CHECK(view.bodyCount == 3);
+			for (uint32_t i = 0; i < 3; i++) {
+				CHECK(x[i] == double(frame * 10 + i) && y[i] == -x[i] && z[i] == 0.5 * x[i]);
+			}
+		}
+		publisher.Close();
+		CHECK(!reader.IsPublisherAlive());
+	}
+
+#ifndef _WIN32
+	// a segment left by a crash still says alive, but names no live process, and is replaced
+	{
+		SharedSegment crashed;
+		CHECK(crashed.Create(name, shared::GetSegmentSize(1)));
+		auto* header = reinterpret_cast<shared::SegmentHeader*>(crashed.GetData());
+		header->publisherAlive.store(1);
+		header->publisherProcess = 0;
+		std::memcpy(header->magic, "STEORRA", 8);
+		SharedStatePublisher publisher;
+		CHECK(publisher.Open(name, bodies));
+		SharedStateReader reader;
+		CHECK(reader.Open(name));
+		CHECK(reader.GetBodyCount() == 3);
+		publisher.Close();
+	}
+	// a segment that is not ours is left alone
+	{
+		SharedSegment foreign;
+		CHECK(foreign.Create(name, 4096));
+		SharedStatePublisher publisher;
+		CHECK(!publisher.Open(name, bodies));
+	}
+#endif
+	return TestResult();
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <iostream>
+#include <vector>
+#include <glm/geometric.hpp>
+#include "dynamics/dynamics_orbits.h"
+#include "dynamics/dynamics_universal.h"
+#include "test_check.h"
+
+// The universal driver across e = 1 against the classical closed forms, with the orbit in the ecliptic plane and
+// periapsis on +x so the perifocal position is the ecliptic position.
+namespace {
+	constexpr double kSunGm = 1.32712440018e20;
+	constexpr double kMetresPerAu = 1.495978707e11;
+	constexpr double kSecondsPerDay = 86400.0;
+	constexpr double kPeriapsisTime = 2451545.0;
+
+	// bisection then Newton, safe for any mean anomaly at high eccentricity
+	double SolveElliptic(double e, double meanAnomaly) {
+		double low = meanAnomaly - e, high = meanAnomaly + e;
+		double E = meanAnomaly;
+		for (int i = 0; i < 200; i++) {
+			const double f = E - e * std::sin(E) - meanAnomaly;
+			f < 0.0 ? low = E : high = E;
+			double next = E - f / (1.0 - e * std::cos(E));
+			if (!(next > low && next < high)) {
+				next = 0.5 * (low + high);
+			}
+			if (std::abs(next - E) < 1e-15 * std::max(1.0, std::abs(E))) {
+				return next;
+			}
+			E = next;
+		}
+		return E;
+	}
+
+	double SolveHyperbolic(double e, double meanAnomaly) {
+		double H = std::asinh(meanAnomaly / e);
+		for (int i = 0; i < 200; i++) {
+			const double next = H - (e * std::sinh(H) - H - meanAnomaly) / (e * std::cosh(H) - 1.0);
+			if (std::abs(next - H) < 1e-15 * std::max(1.0, std::abs(H))) {
+				return next;
+			}
+			H = next;
+		}
+		return H;
+	}
+
+	glm::dvec3 ClosedForm(double q, double e, double dt) {
+		if (e < 1.0) {
+			const double a = q / (1.0 - e);
+			const double E = SolveElliptic(e, std::sqrt(kSunGm / (a * a * a)) * dt);
+			return { a * (std::cos(E) - e), a * std::sqrt(1.0 - e * e) * std::sin(E), 0.0 };
+		}
+		if (e > 1.0) {
+			const double a = q / (e - 1.0);
+			const double H = SolveHyperbolic(e, std::sqrt(kSunGm / (a * a * a)) * dt);
+			return { a * (e - std::cosh(H)), a * std::sqrt(e * e - 1.0) * std::sinh(H), 0.0 };
+		}
+		// Barker's equation D + D^3 / 3 = sqrt(mu / 2q^3) dt with D = tan(nu / 2), solved by Cardano
+		const double b = 1.5 * std::sqrt(kSunGm / (2.0 * q * q * q)) * dt;
+		const double y = std::cbrt(b + std::sqrt(b * b + 1.0));
+		const double D = y - 1.0 / y;
+		return { q * (1.0 - D * D), 2.0 * q * D, 0.0 };
+	}
+}
+
+int main() {
+	SolarBody sun("Sun", 6.957e8, nullptr, kSunGm);
+	const double q = kMetresPerAu;
+	double worst = 0.0;
+	for (double e : { 0.999, 1.0, 1.001 }) {
+		UniversalOrbit orbit(&sun, { q, e, 0.0, 0.0, 0.0, kPeriapsisTime });
+		for (double days : { 0.0, 1e-6, 0.5, -0.5, 10.0, -10.0, 100.0, -100.0, 1000.0, -1000.0, 5000.0, -5000.0 }) {
+			const glm::dvec3 expected = ClosedForm(q, e, days * kSecondsPerDay);
+			const glm::dvec3 actual = orbit.GetRelativePositionAtTime(kPeriapsisTime + days);
+			const double error = glm::length(actual - expected) / glm::length(expected);
+			worst = std::max(worst, error);
+			if (!(error < 1e-9)) {
+				std::cerr << "e " << e << " dt " << days << " days relative error " << error << "\n";
+			}
+			CHECK(error < 1e-9);
+		}
+	}
+	// either side of e = 1 the position closes in on the parabola
+	for (double days : { 1.0, -30.0, 400.0 }) {
+		const glm::dvec3 parabola = ClosedForm(q, 1.0, days * kSecondsPerDay);
+		for (double e : { 1.0 - 1e-9, 1.0 + 1e-9 }) {
+			UniversalOrbit orbit(&sun, { q, e, 0.0, 0.0, 0.0, kPeriapsisTime });
+			const double error = glm::length(orbit.GetRelativePositionAtTime(kPeriapsisTime + days) - parabola) / glm::length(parabola);
+			CHECK(error < 1e-6);
+		}
+	}
+	// the batch against the scalar driver on tilted orbits either side of e = 1, seven of them so the last block of lanes
+	// is padded
+	UniversalOrbitBatch batch(kSunGm);
+	std::vector<UniversalOrbit> orbits;
+	for (double e : { 0.3, 0.999, 1.0 - 1e-9, 1.0, 1.0 + 1e-9, 1.001, 2.5 }) {
+		const UniversalElements elements{ q * (0.5 + e), e, 1.1 * e, 0.4, 2.0 - e, kPeriapsisTime + 3.0 * e };
+		batch.Add(elements);
+		orbits.emplace_back(&sun, elements);
+	}
+	CHECK(batch.GetCount() == orbits.size());
+	std::vector<glm::dvec3> positions(batch.GetCount());
+	double worstBatch = 0.0;
+	for (double days : { 0.0, 1e-6, 0.5, -0.5, 10.0, -10.0, 100.0, -100.0, 1000.0, -1000.0, 5000.0, -5000.0 }) {
+		batch.Evaluate(kPeriapsisTime + days, positions.data());
+		for (size_t i = 0; i < orbits.size(); i++) {
+			const glm::dvec3 expected = orbits[i].GetRelativePositionAtTime(kPeriapsisTime + days);
+			const double error = glm::length(positions[i] - expected) / glm::length(expected);
+			worstBatch = std::max(worstBatch, error);
+			if (!(error < 1e-9)) {
+				std::cerr << "batch e " << orbits[i].elements.e << " dt " << days << " days relative error " << error << "\n";
+			}
+			CHECK(error < 1e-9);
+		}
+	}
+	// only the bound orbit has an apoapsis
+	CHECK(std::isfinite(UniversalOrbit(&sun, { q, 0.999, 0.0, 0.0, 0.0, kPeriapsisTime }).GetMaxDistance()));
+	CHECK(std::isinf(UniversalOrbit(&sun, { q, 1.0, 0.0, 0.0, 0.0, kPeriapsisTime }).GetMaxDistance()));
+	CHECK(std::isinf(UniversalOrbit(&sun, { q, 1.001, 0.0, 0.0, 0.0, kPeriapsisTime }).GetMaxDistance()));
+	std::cout << "worst relative error " << worst << ", batch " << worstBatch << std::endl;
+	return TestResult();
+}